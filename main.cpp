@@ -1,10 +1,91 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
 #include "struct_parser.h"
+#include "struct_optimize.h"
 
 using namespace std;
 
-int main()
+static void printFootprint(const char* title, const LayoutFootprint& footprint, bool withProfile)
 {
+  cout << title << ": " << footprint.size << " bytes, " << footprint.padding << " padding, "
+       << footprint.cacheLines << " cache lines";
+  if (withProfile) cout << ", " << footprint.hotCacheLines << " hot";
+  cout << endl;
+}
+
+// myproject optimize <struct file> [--packed] [--profile <file>]
+// Файл профиля: строки "<поле> <число обращений>", строки с '#' пропускаются
+static int optimize(int argc, char* argv[])
+{
+  const char* structPath = nullptr;
+  const char* profilePath = nullptr;
+  LayoutAbi abi = NaturalAbi;
+  for (int i = 2; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--packed") == 0) abi = PackedAbi;
+    else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) profilePath = argv[++i];
+    else structPath = argv[i];
+  }
+  if (!structPath)
+  {
+    cerr << "Usage: myproject optimize <struct file> [--packed] [--profile <file>]" << endl;
+    return 2;
+  }
+
+  try
+  {
+    ifstream structFile(structPath);
+    if (!structFile)
+    {
+      cerr << "Unable to open " << structPath << endl;
+      return 1;
+    }
+    stringstream text;
+    text << structFile.rdbuf();
+    StructLayout layout(text.str());
+    LayoutOptimizer optimizer(layout, abi);
+
+    if (profilePath)
+    {
+      ifstream profileFile(profilePath);
+      if (!profileFile)
+      {
+        cerr << "Unable to open " << profilePath << endl;
+        return 1;
+      }
+      map<string, uint64_t> counts;
+      string line;
+      while (getline(profileFile, line))
+      {
+        istringstream fields(line);
+        string name;
+        uint64_t count = 0;
+        if (fields >> name >> count && name[0] != '#') counts[name] += count;
+      }
+      optimizer.setProfile(counts);
+    }
+
+    printFootprint("Before", optimizer.current(), profilePath != nullptr);
+    printFootprint("After", optimizer.proposed(), profilePath != nullptr);
+    cout << optimizer.proposedText();
+  }
+  catch (const exception& e)
+  {
+    cerr << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && strcmp(argv[1], "optimize") == 0)
+  {
+    return optimize(argc, argv);
+  }
+
   float a, b;
   cout << "Input first number: ";
   cin >> a;
@@ -0,0 +1,436 @@
+#ifndef STRUCTAGGREGATE_H
+#define STRUCTAGGREGATE_H
+
+#include "struct_columns.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <limits>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+// Перемешивание 64-битного значения (финализатор splitmix64)
+inline uint64_t MixBits(uint64_t value)
+{
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+// Оценка числа различных значений (HyperLogLog, 2^12 регистров, погрешность ~1.6%)
+class HyperLogLog
+{
+public:
+    enum { Precision = 12, Registers = 1 << Precision };
+
+    HyperLogLog() : m_registers(Registers, 0) {}
+
+    void add(uint64_t value)
+    {
+        uint64_t hash = MixBits(value);
+        size_t index = static_cast<size_t>(hash >> (64 - Precision));
+        uint64_t rest = (hash << Precision) | (1ULL << (Precision - 1));
+        uint8_t rank = 1;
+        while (!(rest & (1ULL << 63)))
+        {
+            rest <<= 1;
+            ++rank;
+        }
+        if (rank > m_registers[index]) m_registers[index] = rank;
+    }
+
+    void merge(const HyperLogLog& other)
+    {
+        for (size_t i = 0; i < Registers; ++i)
+        {
+            m_registers[i] = std::max(m_registers[i], other.m_registers[i]);
+        }
+    }
+
+    double estimate() const
+    {
+        double sum = 0;
+        size_t zeros = 0;
+        for (uint8_t r : m_registers)
+        {
+            sum += std::ldexp(1.0, -r);
+            if (r == 0) ++zeros;
+        }
+        double m = Registers;
+        double raw = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+        // На малых количествах точнее линейный подсчет по пустым регистрам
+        if (raw <= 2.5 * m && zeros)
+        {
+            return m * std::log(m / zeros);
+        }
+        return raw;
+    }
+
+private:
+    std::vector<uint8_t> m_registers;
+};
+
+// Итог агрегации одного поля
+struct FieldAggregate
+{
+    // Поля шириной до DenseBits бит считаются точной таблицей частот,
+    // более широкие - через HyperLogLog
+    enum { DenseBits = 16 };
+
+    std::string name;
+    size_t fieldIndex;
+    bool isReal;
+    bool isSigned;
+    int bitWidth;
+    uint64_t count;
+    int64_t intSum;         // у целых полей (uint64_t значения выше INT64_MAX заворачиваются)
+    int64_t intMin;         // у знаковых целых полей
+    int64_t intMax;
+    uint64_t uintMin;       // у беззнаковых целых полей
+    uint64_t uintMax;
+    double realSum;         // у float/double полей
+    double realMin;
+    double realMax;
+
+    std::vector<uint64_t> valueCounts;  // плотная таблица: индекс - биты значения поля
+    HyperLogLog distinctSketch;
+
+    // Гистограмма по равным интервалам [low, high), задается через Aggregation::setHistogram
+    double histogramLow;
+    double histogramHigh;
+    std::vector<uint64_t> histogram;
+    uint64_t underflow;
+    uint64_t overflow;
+
+    bool isDense() const { return !valueCounts.empty(); }
+
+    double sum() const { return isReal ? realSum : static_cast<double>(intSum); }
+    double min() const { return isReal ? realMin : isSigned ? static_cast<double>(intMin) : static_cast<double>(uintMin); }
+    double max() const { return isReal ? realMax : isSigned ? static_cast<double>(intMax) : static_cast<double>(uintMax); }
+    double mean() const { return count ? sum() / count : 0.0; }
+
+    // Число различных значений: точное для плотной таблицы, иначе оценка
+    uint64_t distinct() const
+    {
+        if (isDense())
+        {
+            return static_cast<uint64_t>(std::count_if(valueCounts.begin(), valueCounts.end(),
+                                                       [](uint64_t c) { return c != 0; }));
+        }
+        return static_cast<uint64_t>(std::llround(distinctSketch.estimate()));
+    }
+
+    // Значение поля, соответствующее индексу плотной таблицы
+    int64_t denseValue(size_t index) const
+    {
+        return isSigned ? StructLayout::signExtend(index, bitWidth) : static_cast<int64_t>(index);
+    }
+
+    uint64_t valueCount(int64_t value) const
+    {
+        size_t index = static_cast<size_t>(static_cast<uint64_t>(value) & StructLayout::maskOf(bitWidth));
+        return index < valueCounts.size() && denseValue(index) == value ? valueCounts[index] : 0;
+    }
+
+    // Сброс накопленных значений (настройки поля и гистограммы сохраняются)
+    void clear()
+    {
+        count = 0;
+        intSum = 0;
+        intMin = std::numeric_limits<int64_t>::max();
+        intMax = std::numeric_limits<int64_t>::min();
+        uintMin = std::numeric_limits<uint64_t>::max();
+        uintMax = 0;
+        realSum = 0;
+        realMin = std::numeric_limits<double>::infinity();
+        realMax = -std::numeric_limits<double>::infinity();
+        std::fill(valueCounts.begin(), valueCounts.end(), 0);
+        distinctSketch = HyperLogLog();
+        std::fill(histogram.begin(), histogram.end(), 0);
+        underflow = overflow = 0;
+    }
+
+    void merge(const FieldAggregate& other)
+    {
+        if (!other.count) return;
+        if (!count)
+        {
+            intMin = other.intMin; intMax = other.intMax;
+            uintMin = other.uintMin; uintMax = other.uintMax;
+            realMin = other.realMin; realMax = other.realMax;
+        }
+        count += other.count;
+        intSum = static_cast<int64_t>(static_cast<uint64_t>(intSum) + static_cast<uint64_t>(other.intSum));
+        intMin = std::min(intMin, other.intMin);
+        intMax = std::max(intMax, other.intMax);
+        uintMin = std::min(uintMin, other.uintMin);
+        uintMax = std::max(uintMax, other.uintMax);
+        realSum += other.realSum;
+        realMin = std::min(realMin, other.realMin);
+        realMax = std::max(realMax, other.realMax);
+        for (size_t i = 0; i < valueCounts.size(); ++i) valueCounts[i] += other.valueCounts[i];
+        distinctSketch.merge(other.distinctSketch);
+        for (size_t i = 0; i < histogram.size(); ++i) histogram[i] += other.histogram[i];
+        underflow += other.underflow;
+        overflow += other.overflow;
+    }
+};
+
+// Однопроходная агрегация полей по буферу записей или файлу:
+// sum/min/max/mean/count, число различных значений и гистограммы.
+// Записи делятся между потоками, у каждого потока свои частичные итоги,
+// которые сливаются в конце вызова add()
+class Aggregation
+{
+public:
+    // threads = 0 - по числу ядер
+    Aggregation(const StructLayout& layout, const std::vector<std::string>& fieldNames, unsigned threads = 0)
+        : m_layout(layout), m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+    {
+        for (const auto& name : fieldNames)
+        {
+            size_t index = layout.fieldIndex(name);
+            const StructLayout::Field& field = layout.field(index);
+            FieldAggregate result;
+            result.name = name;
+            result.fieldIndex = index;
+            result.isReal = field.kind == StructLayout::FloatValue || field.kind == StructLayout::DoubleValue;
+            result.isSigned = field.kind == StructLayout::SignedValue;
+            result.bitWidth = field.bitWidth;
+            result.histogramLow = 0;
+            result.histogramHigh = 0;
+            if (!result.isReal && field.bitWidth <= FieldAggregate::DenseBits)
+            {
+                result.valueCounts.assign(static_cast<size_t>(1) << field.bitWidth, 0);
+            }
+            m_fields.push_back(index);
+            m_results.push_back(result);
+        }
+        reset();
+    }
+
+    // Гистограмма значений поля по buckets равным интервалам на [low, high)
+    void setHistogram(const std::string& fieldName, double low, double high, size_t buckets)
+    {
+        if (!(high > low) || buckets == 0)
+        {
+            throw std::invalid_argument("Invalid histogram range for field " + fieldName);
+        }
+        FieldAggregate& result = find(fieldName);
+        result.histogramLow = low;
+        result.histogramHigh = high;
+        result.histogram.assign(buckets, 0);
+        result.underflow = result.overflow = 0;
+    }
+
+    void reset()
+    {
+        for (auto& result : m_results)
+        {
+            result.clear();
+        }
+    }
+
+    void add(const char* records, size_t count)
+    {
+        size_t threads = std::min<size_t>(m_threads, (count + MinRecordsPerThread - 1) / MinRecordsPerThread);
+        if (threads <= 1)
+        {
+            accumulate(records, count, m_results);
+            return;
+        }
+
+        std::vector<std::vector<FieldAggregate> > partials(threads, emptyResults());
+        std::vector<std::thread> workers;
+        size_t chunk = (count + threads - 1) / threads;
+        for (size_t t = 0; t < threads; ++t)
+        {
+            size_t start = t * chunk;
+            size_t n = std::min(chunk, count - start);
+            workers.emplace_back([this, records, start, n, &partials, t]()
+            {
+                accumulate(records + start * m_layout.size(), n, partials[t]);
+            });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        for (const auto& partial : partials)
+        {
+            for (size_t i = 0; i < m_results.size(); ++i)
+            {
+                m_results[i].merge(partial[i]);
+            }
+        }
+    }
+
+    // Агрегация файла записей, читаемого кусками по recordsPerChunk
+    void addFile(std::FILE* file, size_t recordsPerChunk = 1 << 16)
+    {
+        std::vector<char> buffer(recordsPerChunk * m_layout.size());
+        size_t count;
+        while ((count = std::fread(buffer.data(), m_layout.size(), recordsPerChunk, file)) > 0)
+        {
+            add(buffer.data(), count);
+        }
+    }
+
+    const std::vector<FieldAggregate>& results() const { return m_results; }
+
+    const FieldAggregate& result(const std::string& fieldName) const
+    {
+        return const_cast<Aggregation*>(this)->find(fieldName);
+    }
+
+private:
+    enum { BlockRecords = 4096, MinRecordsPerThread = 1 << 16 };
+
+    FieldAggregate& find(const std::string& fieldName)
+    {
+        for (auto& result : m_results)
+        {
+            if (result.name == fieldName) return result;
+        }
+        throw std::invalid_argument("Field not found: " + fieldName);
+    }
+
+    std::vector<FieldAggregate> emptyResults() const
+    {
+        std::vector<FieldAggregate> results = m_results;
+        for (auto& result : results)
+        {
+            result.clear();
+        }
+        return results;
+    }
+
+    // Свертка пакета значений в естественном типе поля: простые циклы
+    // без ветвлений, которые компилятор разворачивает в SIMD
+    template<typename T>
+    static void reduce(const T* values, size_t n, FieldAggregate& result)
+    {
+        T lo = values[0], hi = values[0];
+        for (size_t i = 1; i < n; ++i)
+        {
+            lo = values[i] < lo ? values[i] : lo;
+            hi = values[i] > hi ? values[i] : hi;
+        }
+        if (result.isReal)
+        {
+            double sum = 0;
+            for (size_t i = 0; i < n; ++i) sum += values[i];
+            result.realSum += sum;
+            result.realMin = std::min(result.realMin, static_cast<double>(lo));
+            result.realMax = std::max(result.realMax, static_cast<double>(hi));
+        }
+        else
+        {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < n; ++i) sum += static_cast<uint64_t>(static_cast<int64_t>(values[i]));
+            result.intSum = static_cast<int64_t>(static_cast<uint64_t>(result.intSum) + sum);
+            // lo/hi найдены в типе поля, поэтому uint64_t выше INT64_MAX сравниваются как беззнаковые
+            if (result.isSigned)
+            {
+                result.intMin = std::min(result.intMin, static_cast<int64_t>(lo));
+                result.intMax = std::max(result.intMax, static_cast<int64_t>(hi));
+            }
+            else
+            {
+                result.uintMin = std::min(result.uintMin, static_cast<uint64_t>(lo));
+                result.uintMax = std::max(result.uintMax, static_cast<uint64_t>(hi));
+            }
+        }
+        result.count += n;
+
+        if (result.isDense())
+        {
+            uint64_t mask = StructLayout::maskOf(result.bitWidth);
+            uint64_t* counts = result.valueCounts.data();
+            for (size_t i = 0; i < n; ++i) ++counts[static_cast<uint64_t>(values[i]) & mask];
+        }
+        else
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                uint64_t bits = 0;
+                std::memcpy(&bits, &values[i], sizeof(T));
+                result.distinctSketch.add(bits);
+            }
+        }
+
+        if (!result.histogram.empty())
+        {
+            double scale = result.histogram.size() / (result.histogramHigh - result.histogramLow);
+            for (size_t i = 0; i < n; ++i)
+            {
+                double v = static_cast<double>(values[i]);
+                if (v < result.histogramLow) ++result.underflow;
+                else if (v >= result.histogramHigh) ++result.overflow;
+                else
+                {
+                    size_t bucket = static_cast<size_t>((v - result.histogramLow) * scale);
+                    ++result.histogram[std::min(bucket, result.histogram.size() - 1)];
+                }
+            }
+        }
+    }
+
+    static void reduceColumn(const Column& column, size_t n, FieldAggregate& result)
+    {
+        const char* bytes = column.bytes.data();
+        switch (column.kind)
+        {
+        case StructLayout::FloatValue: reduce(reinterpret_cast<const float*>(bytes), n, result); break;
+        case StructLayout::DoubleValue: reduce(reinterpret_cast<const double*>(bytes), n, result); break;
+        case StructLayout::SignedValue:
+            switch (column.elementSize)
+            {
+            case 1: reduce(reinterpret_cast<const int8_t*>(bytes), n, result); break;
+            case 2: reduce(reinterpret_cast<const int16_t*>(bytes), n, result); break;
+            case 4: reduce(reinterpret_cast<const int32_t*>(bytes), n, result); break;
+            default: reduce(reinterpret_cast<const int64_t*>(bytes), n, result); break;
+            }
+            break;
+        default:
+            switch (column.elementSize)
+            {
+            case 1: reduce(reinterpret_cast<const uint8_t*>(bytes), n, result); break;
+            case 2: reduce(reinterpret_cast<const uint16_t*>(bytes), n, result); break;
+            case 4: reduce(reinterpret_cast<const uint32_t*>(bytes), n, result); break;
+            default: reduce(reinterpret_cast<const uint64_t*>(bytes), n, result); break;
+            }
+            break;
+        }
+    }
+
+    void accumulate(const char* records, size_t count, std::vector<FieldAggregate>& results) const
+    {
+        ColumnSet block;
+        for (size_t start = 0; start < count; start += BlockRecords)
+        {
+            size_t n = std::min<size_t>(BlockRecords, count - start);
+            block.reset(m_layout, m_fields, n);
+            for (size_t c = 0; c < m_fields.size(); ++c)
+            {
+                ExtractField(m_layout.field(m_fields[c]), records + start * m_layout.size(), m_layout.size(), n,
+                             block.column(c).bytes.data());
+                reduceColumn(block.column(c), n, results[c]);
+            }
+        }
+    }
+
+    const StructLayout& m_layout;
+    unsigned m_threads;
+    std::vector<size_t> m_fields;
+    std::vector<FieldAggregate> m_results;
+};
+
+#endif // STRUCTAGGREGATE_H
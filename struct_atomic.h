@@ -0,0 +1,207 @@
+#ifndef STRUCTATOMIC_H
+#define STRUCTATOMIC_H
+
+#include "struct_layout.h"
+
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+
+#if !defined(__GNUC__) && !defined(__clang__)
+#error "struct_atomic.h requires GCC-compatible __atomic builtins"
+#endif
+
+// Атомарные операции над полем записи в разделяемой памяти.
+// Работа идет со словом, выровненным по своему размеру: сам контейнер, если он
+// выровнен, иначе объемлющее выровненное 8-байтовое слово. Изменение поля - цикл CAS
+// по этому слову, поэтому одновременные записи в разные поля одного слова не теряются.
+// Контейнер, пересекающий границу 8-байтового слова, атомарно изменить нельзя
+class AtomicField
+{
+public:
+    AtomicField(const StructLayout& layout, size_t index) : m_field(layout.field(index))
+    {
+    }
+
+    AtomicField(const StructLayout& layout, const std::string& fieldName)
+        : m_field(layout.field(layout.fieldIndex(fieldName)))
+    {
+    }
+
+    // Сырые биты поля
+    uint64_t load(const char* record) const
+    {
+        Word w = word(const_cast<char*>(record));
+        return (loadWord(w) >> w.shift) & m_field.mask;
+    }
+
+    int64_t loadInt(const char* record) const
+    {
+        uint64_t bits = load(record);
+        return m_field.kind == StructLayout::SignedValue ? StructLayout::signExtend(bits, m_field.bitWidth)
+                                                         : static_cast<int64_t>(bits);
+    }
+
+    void store(char* record, uint64_t value) const
+    {
+        update(record, Assign, value);
+    }
+
+    // Замена значения, только если текущее равно expected; иначе в expected - текущее
+    bool compareExchange(char* record, uint64_t& expected, uint64_t desired) const
+    {
+        Word w = word(record);
+        uint64_t mask = m_field.mask << w.shift;
+        uint64_t current = loadWord(w);
+        while (true)
+        {
+            uint64_t value = (current >> w.shift) & m_field.mask;
+            if (value != (expected & m_field.mask))
+            {
+                expected = value;
+                return false;
+            }
+            uint64_t next = (current & ~mask) | ((desired & m_field.mask) << w.shift);
+            if (casWord(w, current, next)) return true;
+        }
+    }
+
+    // Операции возвращают предыдущее значение поля.
+    // OR и AND не задевают соседние поля и выполняются одной атомарной инструкцией
+    uint64_t fetchOr(char* record, uint64_t bits) const
+    {
+        Word w = word(record);
+        uint64_t old = fetchWord(w, Or, (bits & m_field.mask) << w.shift);
+        return (old >> w.shift) & m_field.mask;
+    }
+
+    uint64_t fetchAnd(char* record, uint64_t bits) const
+    {
+        Word w = word(record);
+        uint64_t old = fetchWord(w, And, ((bits & m_field.mask) << w.shift) | ~(m_field.mask << w.shift));
+        return (old >> w.shift) & m_field.mask;
+    }
+
+    // Сложение по модулю 2^bitWidth: перенос не выходит за пределы поля
+    uint64_t fetchAdd(char* record, int64_t delta) const { return update(record, Add, static_cast<uint64_t>(delta)); }
+
+private:
+    enum Operation
+    {
+        Assign,
+        Or,
+        And,
+        Add
+    };
+
+    struct Word
+    {
+        char* address;
+        size_t size;
+        int shift;      // сдвиг значения поля внутри слова
+    };
+
+    Word word(char* record) const
+    {
+        char* container = record + m_field.byteOffset;
+        uintptr_t address = reinterpret_cast<uintptr_t>(container);
+        Word w;
+        if (address % m_field.size == 0)
+        {
+            w.address = container;
+            w.size = m_field.size;
+            w.shift = 0;
+        }
+        else
+        {
+            uintptr_t base = address & ~static_cast<uintptr_t>(7);
+            if (address + m_field.size > base + 8)
+            {
+                throw std::invalid_argument("Field " + m_field.name + " crosses an 8-byte boundary and cannot be updated atomically");
+            }
+            w.address = reinterpret_cast<char*>(base);
+            w.size = 8;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            w.shift = static_cast<int>((base + 8 - address - m_field.size) * 8);
+#else
+            w.shift = static_cast<int>((address - base) * 8);
+#endif
+        }
+        if (m_field.isBitField) w.shift += m_field.bitOffset;
+        return w;
+    }
+
+    static uint64_t loadWord(const Word& w)
+    {
+        switch (w.size)
+        {
+        case 1: return __atomic_load_n(reinterpret_cast<uint8_t*>(w.address), __ATOMIC_ACQUIRE);
+        case 2: return __atomic_load_n(reinterpret_cast<uint16_t*>(w.address), __ATOMIC_ACQUIRE);
+        case 4: return __atomic_load_n(reinterpret_cast<uint32_t*>(w.address), __ATOMIC_ACQUIRE);
+        default: return __atomic_load_n(reinterpret_cast<uint64_t*>(w.address), __ATOMIC_ACQUIRE);
+        }
+    }
+
+    // При неудаче expected получает текущее значение слова
+    static bool casWord(const Word& w, uint64_t& expected, uint64_t desired)
+    {
+        switch (w.size)
+        {
+        case 1: return cas(reinterpret_cast<uint8_t*>(w.address), expected, desired);
+        case 2: return cas(reinterpret_cast<uint16_t*>(w.address), expected, desired);
+        case 4: return cas(reinterpret_cast<uint32_t*>(w.address), expected, desired);
+        default: return cas(reinterpret_cast<uint64_t*>(w.address), expected, desired);
+        }
+    }
+
+    static uint64_t fetchWord(const Word& w, Operation operation, uint64_t operand)
+    {
+        switch (w.size)
+        {
+        case 1: return fetch(reinterpret_cast<uint8_t*>(w.address), operation, operand);
+        case 2: return fetch(reinterpret_cast<uint16_t*>(w.address), operation, operand);
+        case 4: return fetch(reinterpret_cast<uint32_t*>(w.address), operation, operand);
+        default: return fetch(reinterpret_cast<uint64_t*>(w.address), operation, operand);
+        }
+    }
+
+    template<typename T>
+    static uint64_t fetch(T* p, Operation operation, uint64_t operand)
+    {
+        return operation == Or ? __atomic_fetch_or(p, static_cast<T>(operand), __ATOMIC_ACQ_REL)
+                               : __atomic_fetch_and(p, static_cast<T>(operand), __ATOMIC_ACQ_REL);
+    }
+
+    template<typename T>
+    static bool cas(T* p, uint64_t& expected, uint64_t desired)
+    {
+        T current = static_cast<T>(expected);
+        bool done = __atomic_compare_exchange_n(p, &current, static_cast<T>(desired), false,
+                                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        expected = current;
+        return done;
+    }
+
+    uint64_t update(char* record, Operation operation, uint64_t operand) const
+    {
+        Word w = word(record);
+        uint64_t mask = m_field.mask << w.shift;
+        uint64_t current = loadWord(w);
+        while (true)
+        {
+            uint64_t value = (current >> w.shift) & m_field.mask;
+            uint64_t next;
+            switch (operation)
+            {
+            case Add: next = value + operand; break;
+            default: next = operand; break;
+            }
+            uint64_t desired = (current & ~mask) | ((next & m_field.mask) << w.shift);
+            if (casWord(w, current, desired)) return value;
+        }
+    }
+
+    StructLayout::Field m_field;
+};
+
+#endif // STRUCTATOMIC_H
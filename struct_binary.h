@@ -0,0 +1,208 @@
+#ifndef STRUCTBINARY_H
+#define STRUCTBINARY_H
+
+#include "struct_layout.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// CRC-32 (полином 0xEDB88320, как в zlib)
+inline uint32_t Crc32(const void* data, size_t size, uint32_t crc = 0)
+{
+    static const std::vector<uint32_t> table = []()
+    {
+        std::vector<uint32_t> result(256);
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            result[i] = c;
+        }
+        return result;
+    }();
+
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Запись двоичных данных в little-endian независимо от платформы
+class BinaryWriter
+{
+public:
+    explicit BinaryWriter(std::string& out) : m_out(out) {}
+
+    void u8(uint8_t value) { m_out.push_back(static_cast<char>(value)); }
+
+    void u16(uint16_t value)
+    {
+        for (int i = 0; i < 2; ++i) u8(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void u32(uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i) u8(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void u64(uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i) u8(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    // 7 бит на байт, старший бит - признак продолжения
+    void varint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            u8(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        u8(static_cast<uint8_t>(value));
+    }
+
+    void bytes(const void* data, size_t size) { m_out.append(static_cast<const char*>(data), size); }
+
+    void str(const std::string& value)
+    {
+        u32(static_cast<uint32_t>(value.size()));
+        bytes(value.data(), value.size());
+    }
+
+private:
+    std::string& m_out;
+};
+
+// Чтение того, что записал BinaryWriter; выход за границу буфера - исключение
+class BinaryReader
+{
+public:
+    BinaryReader(const char* data, size_t size) : m_data(data), m_size(size), m_pos(0) {}
+
+    size_t position() const { return m_pos; }
+    size_t remaining() const { return m_size - m_pos; }
+
+    uint8_t u8()
+    {
+        need(1);
+        return static_cast<uint8_t>(m_data[m_pos++]);
+    }
+
+    uint16_t u16() { return static_cast<uint16_t>(little(2)); }
+    uint32_t u32() { return static_cast<uint32_t>(little(4)); }
+    uint64_t u64() { return little(8); }
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte = u8();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw std::runtime_error("Malformed varint in binary data");
+    }
+
+    const char* bytes(size_t size)
+    {
+        need(size);
+        const char* result = m_data + m_pos;
+        m_pos += size;
+        return result;
+    }
+
+    std::string str()
+    {
+        uint32_t size = u32();
+        return std::string(bytes(size), size);
+    }
+
+private:
+    void need(size_t size) const
+    {
+        if (size > m_size - m_pos)
+        {
+            throw std::runtime_error("Unexpected end of binary data");
+        }
+    }
+
+    uint64_t little(size_t size)
+    {
+        need(size);
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; ++i)
+        {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(m_data[m_pos + i])) << (8 * i);
+        }
+        m_pos += size;
+        return value;
+    }
+
+    const char* m_data;
+    size_t m_size;
+    size_t m_pos;
+};
+
+// Сериализация скомпилированного layout: имя, размер и таблица полей
+inline void SerializeLayout(const StructLayout& layout, std::string& out)
+{
+    BinaryWriter writer(out);
+    writer.str(layout.name());
+    writer.u64(layout.size());
+    writer.u32(static_cast<uint32_t>(layout.fieldCount()));
+    for (const auto& field : layout.fields())
+    {
+        writer.str(field.type);
+        writer.str(field.name);
+        writer.u32(static_cast<uint32_t>(field.byteOffset));
+        writer.u8(static_cast<uint8_t>(field.bitOffset));
+        writer.u8(static_cast<uint8_t>(field.bitWidth));
+        writer.u8(static_cast<uint8_t>(field.size));
+        writer.u8(static_cast<uint8_t>((field.isBitField ? 1 : 0) | (field.kind << 1)));
+    }
+}
+
+inline StructLayout DeserializeLayout(BinaryReader& reader)
+{
+    std::string name = reader.str();
+    size_t size = static_cast<size_t>(reader.u64());
+    uint32_t count = reader.u32();
+    if (count > reader.remaining())
+    {
+        throw std::runtime_error("Corrupted layout field table");
+    }
+    std::vector<StructLayout::Field> fields(count);
+    for (auto& field : fields)
+    {
+        field.type = reader.str();
+        field.name = reader.str();
+        field.byteOffset = static_cast<int>(reader.u32());
+        field.bitOffset = reader.u8();
+        field.bitWidth = reader.u8();
+        field.size = reader.u8();
+        uint8_t flags = reader.u8();
+        field.isBitField = (flags & 1) != 0;
+        field.kind = static_cast<StructLayout::ValueKind>((flags >> 1) & 3);
+        field.mask = StructLayout::maskOf(field.bitWidth);
+        bool validSize = field.size == 1 || field.size == 2 || field.size == 4 || field.size == 8;
+        if (!validSize || (flags >> 3) != 0 || field.bitWidth < 1 ||
+            field.bitOffset + field.bitWidth > static_cast<int>(field.size * 8) ||
+            static_cast<size_t>(field.byteOffset) + field.size > size)
+        {
+            throw std::runtime_error("Corrupted layout field: " + field.name);
+        }
+    }
+    return StructLayout(name, size, fields);
+}
+
+#endif // STRUCTBINARY_H
@@ -0,0 +1,231 @@
+#ifndef STRUCTBUILDER_H
+#define STRUCTBUILDER_H
+
+#include "struct_layout.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// Заполнение записи за один проход: значения полей сначала накапливаются,
+// затем при build()/apply() каждый контейнер (обычное поле или общий контейнер
+// битовых полей) собирается в регистре и записывается в память один раз.
+// Поля, чьи байты пересекаются, но контейнеры различаются (uint8_t a:3 и
+// uint32_t b:4 по одному смещению), попадают в одну группу и пишутся
+// по очереди чтением-изменением-записью, как struct_write
+class RecordBuilder
+{
+public:
+    explicit RecordBuilder(const StructLayout& layout)
+        : m_layout(layout), m_values(layout.fieldCount(), 0), m_staged(layout.fieldCount(), 0),
+          m_unitOf(layout.fieldCount())
+    {
+        for (size_t i = 0; i < layout.fieldCount(); ++i)
+        {
+            const StructLayout::Field& field = layout.field(i);
+            size_t end = field.byteOffset + field.size;
+            // Группы, с которыми пересекаются байты поля, сливаются в первую из них
+            size_t target = m_units.size();
+            for (size_t u = m_units.size(); u-- > 0;)
+            {
+                Unit& unit = m_units[u];
+                if (unit.byteOffset >= static_cast<int>(end) ||
+                    field.byteOffset >= unit.byteOffset + static_cast<int>(unit.size))
+                {
+                    continue;
+                }
+                if (target < m_units.size()) merge(target, u);
+                target = u;
+            }
+            if (target == m_units.size())
+            {
+                Unit created = { field.byteOffset, field.size, 0, false, std::vector<size_t>() };
+                m_units.push_back(created);
+            }
+            else
+            {
+                Unit& unit = m_units[target];
+                bool sameContainer = field.isBitField && !unit.mixed && unit.byteOffset == field.byteOffset &&
+                                     unit.size == field.size && m_layout.field(unit.fields[0]).isBitField;
+                if (!sameContainer) extend(unit, field.byteOffset, field.size);
+            }
+            m_units[target].fields.push_back(i);
+        }
+        for (size_t u = 0; u < m_units.size(); ++u)
+        {
+            std::sort(m_units[u].fields.begin(), m_units[u].fields.end());
+            for (size_t index : m_units[u].fields) m_unitOf[index] = u;
+        }
+    }
+
+    const StructLayout& layout() const { return m_layout; }
+
+    RecordBuilder& set(size_t index, int64_t value)
+    {
+        const StructLayout::Field& f = m_layout.field(index);
+        if (f.kind == StructLayout::FloatValue || f.kind == StructLayout::DoubleValue)
+        {
+            return setDouble(index, static_cast<double>(value));
+        }
+        return stage(index, static_cast<uint64_t>(value));
+    }
+
+    RecordBuilder& setUnsigned(size_t index, uint64_t value)
+    {
+        const StructLayout::Field& f = m_layout.field(index);
+        if (f.kind == StructLayout::FloatValue || f.kind == StructLayout::DoubleValue)
+        {
+            return setDouble(index, static_cast<double>(value));
+        }
+        return stage(index, value);
+    }
+
+    RecordBuilder& setDouble(size_t index, double value)
+    {
+        const StructLayout::Field& f = m_layout.field(index);
+        switch (f.kind)
+        {
+        case StructLayout::FloatValue:
+        {
+            float narrow = static_cast<float>(value);
+            uint32_t bits;
+            std::memcpy(&bits, &narrow, sizeof(bits));
+            return stage(index, bits);
+        }
+        case StructLayout::DoubleValue:
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return stage(index, bits);
+        }
+        default:
+            return stage(index, static_cast<uint64_t>(static_cast<int64_t>(value)));
+        }
+    }
+
+    RecordBuilder& set(const std::string& fieldName, int64_t value) { return set(m_layout.fieldIndex(fieldName), value); }
+
+    RecordBuilder& setDouble(const std::string& fieldName, double value)
+    {
+        return setDouble(m_layout.fieldIndex(fieldName), value);
+    }
+
+    // Новая запись: все, что не задано (включая выравнивание), обнуляется
+    void build(char* record) const
+    {
+        std::memset(record, 0, m_layout.size());
+        for (size_t unit : m_touched)
+        {
+            if (m_units[unit].mixed)
+            {
+                writeFields(unit, record);
+                continue;
+            }
+            StructLayout::storeUnit(record + m_units[unit].byteOffset, m_units[unit].size, compose(unit));
+        }
+    }
+
+    // Изменение существующей записи: меняются только заданные поля, контейнер
+    // читается, только если заданы не все его биты
+    void apply(char* record) const
+    {
+        for (size_t unit : m_touched)
+        {
+            const Unit& u = m_units[unit];
+            if (u.mixed)
+            {
+                writeFields(unit, record);
+                continue;
+            }
+            char* p = record + u.byteOffset;
+            uint64_t value = compose(unit);
+            if (u.stagedMask != StructLayout::maskOf(static_cast<int>(u.size * 8)))
+            {
+                value |= StructLayout::loadUnit(p, u.size) & ~u.stagedMask;
+            }
+            StructLayout::storeUnit(p, u.size, value);
+        }
+    }
+
+    // Сброс накопленных значений для следующей записи
+    void reset()
+    {
+        for (size_t unit : m_touched)
+        {
+            m_units[unit].stagedMask = 0;
+            for (size_t index : m_units[unit].fields) m_staged[index] = 0;
+        }
+        m_touched.clear();
+    }
+
+private:
+    // Поля одного контейнера
+    struct Unit
+    {
+        int byteOffset;
+        size_t size;
+        uint64_t stagedMask;    // биты заданных полей
+        bool mixed;             // пересекающиеся контейнеры разных размеров или смещений
+        std::vector<size_t> fields;
+    };
+
+    // Группа from вливается в into и удаляется
+    void merge(size_t from, size_t into)
+    {
+        Unit& target = m_units[into];
+        extend(target, m_units[from].byteOffset, m_units[from].size);
+        target.fields.insert(target.fields.end(), m_units[from].fields.begin(), m_units[from].fields.end());
+        m_units.erase(m_units.begin() + from);
+    }
+
+    static void extend(Unit& unit, int byteOffset, size_t size)
+    {
+        int end = std::max(unit.byteOffset + static_cast<int>(unit.size), byteOffset + static_cast<int>(size));
+        unit.byteOffset = std::min(unit.byteOffset, byteOffset);
+        unit.size = static_cast<size_t>(end - unit.byteOffset);
+        unit.mixed = true;
+    }
+
+    // Заданные поля группы по одному, в порядке объявления
+    void writeFields(size_t unit, char* record) const
+    {
+        for (size_t index : m_units[unit].fields)
+        {
+            if (m_staged[index]) m_layout.writeBits(index, m_values[index], record);
+        }
+    }
+
+    RecordBuilder& stage(size_t index, uint64_t value)
+    {
+        const StructLayout::Field& f = m_layout.field(index);
+        Unit& unit = m_units[m_unitOf[index]];
+        if (unit.stagedMask == 0) m_touched.push_back(m_unitOf[index]);
+        m_values[index] = value & f.mask;
+        m_staged[index] = 1;
+        unit.stagedMask |= f.isBitField ? f.mask << f.bitOffset : StructLayout::maskOf(f.bitWidth);
+        return *this;
+    }
+
+    uint64_t compose(size_t unit) const
+    {
+        uint64_t value = 0;
+        for (size_t index : m_units[unit].fields)
+        {
+            if (!m_staged[index]) continue;
+            const StructLayout::Field& f = m_layout.field(index);
+            value |= f.isBitField ? m_values[index] << f.bitOffset : m_values[index];
+        }
+        return value;
+    }
+
+    const StructLayout& m_layout;
+    std::vector<uint64_t> m_values;
+    std::vector<char> m_staged;
+    std::vector<size_t> m_unitOf;
+    std::vector<Unit> m_units;
+    std::vector<size_t> m_touched;
+};
+
+#endif // STRUCTBUILDER_H
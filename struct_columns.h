@@ -0,0 +1,284 @@
+#ifndef STRUCTCOLUMNS_H
+#define STRUCTCOLUMNS_H
+
+#include "struct_layout.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// Одна колонка: значения поля всех записей подряд в естественном типе поля
+// (битовые поля расширяются до типа контейнера, знаковые - с расширением знака)
+struct Column
+{
+    std::string name;
+    size_t fieldIndex;                  // индекс поля в StructLayout
+    StructLayout::ValueKind kind;
+    size_t elementSize;
+    std::vector<char> bytes;
+
+    size_t count() const { return elementSize ? bytes.size() / elementSize : 0; }
+
+    template<typename T>
+    const T* data() const
+    {
+        checkType(sizeof(T));
+        return reinterpret_cast<const T*>(bytes.data());
+    }
+
+    template<typename T>
+    T* data()
+    {
+        checkType(sizeof(T));
+        return reinterpret_cast<T*>(bytes.data());
+    }
+
+    // Значение, приведенное к int64_t/double независимо от типа колонки
+    int64_t intAt(size_t row) const
+    {
+        const char* p = bytes.data() + row * elementSize;
+        switch (kind)
+        {
+        case StructLayout::FloatValue: { float v; std::memcpy(&v, p, sizeof(v)); return static_cast<int64_t>(v); }
+        case StructLayout::DoubleValue: { double v; std::memcpy(&v, p, sizeof(v)); return static_cast<int64_t>(v); }
+        case StructLayout::SignedValue:
+            return StructLayout::signExtend(StructLayout::loadUnit(p, elementSize), static_cast<int>(elementSize * 8));
+        default:
+            return static_cast<int64_t>(StructLayout::loadUnit(p, elementSize));
+        }
+    }
+
+    double doubleAt(size_t row) const
+    {
+        const char* p = bytes.data() + row * elementSize;
+        switch (kind)
+        {
+        case StructLayout::FloatValue: { float v; std::memcpy(&v, p, sizeof(v)); return v; }
+        case StructLayout::DoubleValue: { double v; std::memcpy(&v, p, sizeof(v)); return v; }
+        default:
+            return static_cast<double>(intAt(row));
+        }
+    }
+
+private:
+    void checkType(size_t size) const
+    {
+        if (size != elementSize)
+        {
+            throw std::invalid_argument("Size mismatch for column " + name);
+        }
+    }
+};
+
+// Набор колонок, полученный транспонированием буфера записей
+class ColumnSet
+{
+public:
+    ColumnSet() : m_count(0) {}
+
+    size_t count() const { return m_count; }
+    size_t columnCount() const { return m_columns.size(); }
+    const std::vector<Column>& columns() const { return m_columns; }
+    Column& column(size_t index) { return m_columns[index]; }
+    const Column& column(size_t index) const { return m_columns[index]; }
+
+    // Колонка по имени поля или nullptr
+    const Column* find(const std::string& fieldName) const
+    {
+        for (const auto& column : m_columns)
+        {
+            if (column.name == fieldName) return &column;
+        }
+        return nullptr;
+    }
+
+    const Column& column(const std::string& fieldName) const
+    {
+        const Column* result = find(fieldName);
+        if (!result)
+        {
+            throw std::invalid_argument("Field not found: " + fieldName);
+        }
+        return *result;
+    }
+
+    // Пустые колонки под count значений для выбранных полей layout
+    void reset(const StructLayout& layout, const std::vector<size_t>& fieldIndices, size_t count)
+    {
+        m_columns.resize(fieldIndices.size());
+        for (size_t i = 0; i < fieldIndices.size(); ++i)
+        {
+            const StructLayout::Field& field = layout.field(fieldIndices[i]);
+            Column& column = m_columns[i];
+            column.name = field.name;
+            column.fieldIndex = fieldIndices[i];
+            column.kind = field.kind;
+            column.elementSize = field.size;
+            column.bytes.resize(count * field.size);
+        }
+        m_count = count;
+    }
+
+private:
+    std::vector<Column> m_columns;
+    size_t m_count;
+};
+
+template<typename T, typename D>
+inline void ConvertColumnValues(const char* bytes, size_t n, D* out)
+{
+    const T* values = reinterpret_cast<const T*>(bytes);
+    for (size_t i = 0; i < n; ++i) out[i] = static_cast<D>(values[i]);
+}
+
+// Пакет значений колонки [start, start + n) с приведением к D (int64_t или double)
+template<typename D>
+inline void LoadColumn(const Column& column, size_t start, size_t n, D* out)
+{
+    const char* bytes = column.bytes.data() + start * column.elementSize;
+    switch (column.kind)
+    {
+    case StructLayout::FloatValue: ConvertColumnValues<float>(bytes, n, out); break;
+    case StructLayout::DoubleValue: ConvertColumnValues<double>(bytes, n, out); break;
+    case StructLayout::SignedValue:
+        switch (column.elementSize)
+        {
+        case 1: ConvertColumnValues<int8_t>(bytes, n, out); break;
+        case 2: ConvertColumnValues<int16_t>(bytes, n, out); break;
+        case 4: ConvertColumnValues<int32_t>(bytes, n, out); break;
+        default: ConvertColumnValues<int64_t>(bytes, n, out); break;
+        }
+        break;
+    default:
+        switch (column.elementSize)
+        {
+        case 1: ConvertColumnValues<uint8_t>(bytes, n, out); break;
+        case 2: ConvertColumnValues<uint16_t>(bytes, n, out); break;
+        case 4: ConvertColumnValues<uint32_t>(bytes, n, out); break;
+        default: ConvertColumnValues<uint64_t>(bytes, n, out); break;
+        }
+        break;
+    }
+}
+
+// Число записей в одном блоке: блок записей и соответствующие куски колонок
+// должны помещаться в L1, тогда каждая запись читается из памяти один раз
+inline size_t ColumnBlockRecords(size_t recordSize)
+{
+    size_t records = 16384 / (recordSize ? recordSize : 1);
+    return records < 16 ? 16 : records;
+}
+
+// Извлечение одного поля из блока записей в колонку
+inline void ExtractField(const StructLayout::Field& field, const char* records, size_t recordSize,
+                         size_t count, char* out)
+{
+    const char* src = records + field.byteOffset;
+    if (!field.isBitField)
+    {
+        switch (field.size)
+        {
+        case 1: for (size_t i = 0; i < count; ++i) std::memcpy(out + i, src + i * recordSize, 1); break;
+        case 2: for (size_t i = 0; i < count; ++i) std::memcpy(out + i * 2, src + i * recordSize, 2); break;
+        case 4: for (size_t i = 0; i < count; ++i) std::memcpy(out + i * 4, src + i * recordSize, 4); break;
+        default: for (size_t i = 0; i < count; ++i) std::memcpy(out + i * 8, src + i * recordSize, 8); break;
+        }
+        return;
+    }
+
+    bool isSigned = field.kind == StructLayout::SignedValue;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t value = (StructLayout::loadUnit(src + i * recordSize, field.size) >> field.bitOffset) & field.mask;
+        if (isSigned)
+        {
+            value = static_cast<uint64_t>(StructLayout::signExtend(value, field.bitWidth));
+        }
+        StructLayout::storeUnit(out + i * field.size, field.size, value);
+    }
+}
+
+// Запись одного поля из колонки в блок записей (битовые поля добавляются к контейнеру)
+inline void InsertField(const StructLayout::Field& field, const char* in, size_t count,
+                        char* records, size_t recordSize)
+{
+    char* dst = records + field.byteOffset;
+    if (!field.isBitField)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::memcpy(dst + i * recordSize, in + i * field.size, field.size);
+        }
+        return;
+    }
+
+    uint64_t clearMask = ~(field.mask << field.bitOffset);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t value = StructLayout::loadUnit(in + i * field.size, field.size) & field.mask;
+        char* container = dst + i * recordSize;
+        uint64_t current = StructLayout::loadUnit(container, field.size) & clearMask;
+        StructLayout::storeUnit(container, field.size, current | (value << field.bitOffset));
+    }
+}
+
+// AoS -> SoA для выбранных полей за один проход по буферу записей
+inline void transpose(const StructLayout& layout, const char* records, size_t count,
+                      const std::vector<size_t>& fieldIndices, ColumnSet& result)
+{
+    result.reset(layout, fieldIndices, count);
+    size_t recordSize = layout.size();
+    size_t block = ColumnBlockRecords(recordSize);
+    for (size_t start = 0; start < count; start += block)
+    {
+        size_t n = count - start < block ? count - start : block;
+        const char* src = records + start * recordSize;
+        for (size_t c = 0; c < fieldIndices.size(); ++c)
+        {
+            Column& column = result.column(c);
+            ExtractField(layout.field(fieldIndices[c]), src, recordSize, n,
+                         column.bytes.data() + start * column.elementSize);
+        }
+    }
+}
+
+// AoS -> SoA для всех полей
+inline ColumnSet transpose(const StructLayout& layout, const char* records, size_t count)
+{
+    std::vector<size_t> all(layout.fieldCount());
+    for (size_t i = 0; i < all.size(); ++i) all[i] = i;
+    ColumnSet result;
+    transpose(layout, records, count, all, result);
+    return result;
+}
+
+// SoA -> AoS: записи обнуляются целиком, поэтому выравнивание и поля,
+// которых нет в наборе колонок, всегда получаются нулевыми
+inline void pack(const StructLayout& layout, const ColumnSet& columns, char* records)
+{
+    size_t recordSize = layout.size();
+    size_t count = columns.count();
+    std::memset(records, 0, recordSize * count);
+    size_t block = ColumnBlockRecords(recordSize);
+    for (size_t start = 0; start < count; start += block)
+    {
+        size_t n = count - start < block ? count - start : block;
+        char* dst = records + start * recordSize;
+        for (const auto& column : columns.columns())
+        {
+            InsertField(layout.field(column.fieldIndex), column.bytes.data() + start * column.elementSize,
+                        n, dst, recordSize);
+        }
+    }
+}
+
+inline std::vector<char> pack(const StructLayout& layout, const ColumnSet& columns)
+{
+    std::vector<char> records(layout.size() * columns.count());
+    pack(layout, columns, records.data());
+    return records;
+}
+
+#endif // STRUCTCOLUMNS_H
@@ -0,0 +1,486 @@
+#ifndef STRUCTCOMPRESS_H
+#define STRUCTCOMPRESS_H
+
+#include "struct_columns.h"
+#include "struct_binary.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+// Легковесное поколоночное сжатие блока записей.
+//
+// Каждое поле блока кодируется отдельно одним из способов:
+//   Plain       - значения колонки как есть;
+//   BitPack     - frame of reference: минимум + упакованные (значение - минимум);
+//   Delta       - первое значение + упакованные разности соседних значений;
+//   RunLength   - упакованные значения серий и их длины;
+//   Dictionary  - упакованный словарь различных значений + упакованные номера.
+// Способ выбирается по статистике выборки из колонки. Значения упаковываются
+// плотно по bits бит в 64-битные слова; распаковка - цикл без ветвлений.
+//
+// Формат блока: u32 число записей | u32 число полей |
+//               (u8 способ | u32 размер | данные)* в порядке полей layout.
+// Биты записи, не принадлежащие ни одному полю, не сохраняются (восстанавливаются нулями).
+enum ColumnEncoding
+{
+    PlainEncoding,
+    BitPackEncoding,
+    DeltaEncoding,
+    RunLengthEncoding,
+    DictionaryEncoding
+};
+
+// Число бит, нужное для значений 0..range
+inline int BitsFor(uint64_t range)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return range ? 64 - __builtin_clzll(range) : 0;
+#else
+    int bits = 0;
+    while (range)
+    {
+        ++bits;
+        range >>= 1;
+    }
+    return bits;
+#endif
+}
+
+// Значение колонки как uint64_t с сохранением порядка для знаковых типов
+// (расширение знака и инверсия старшего бита); float/double - сырые биты
+inline uint64_t ColumnCode(const Column& column, size_t row)
+{
+    uint64_t raw = StructLayout::loadUnit(column.bytes.data() + row * column.elementSize, column.elementSize);
+    if (column.kind == StructLayout::SignedValue)
+    {
+        raw = static_cast<uint64_t>(StructLayout::signExtend(raw, static_cast<int>(column.elementSize * 8)));
+        raw ^= 1ULL << 63;
+    }
+    return raw;
+}
+
+inline void StoreColumnCodes(const uint64_t* codes, size_t count, Column& column)
+{
+    uint64_t flip = column.kind == StructLayout::SignedValue ? 1ULL << 63 : 0;
+    char* out = column.bytes.data();
+    switch (column.elementSize)
+    {
+    case 1: for (size_t i = 0; i < count; ++i) out[i] = static_cast<char>(codes[i] ^ flip); break;
+    case 2:
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint16_t v = static_cast<uint16_t>(codes[i] ^ flip);
+            std::memcpy(out + i * 2, &v, 2);
+        }
+        break;
+    case 4:
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t v = static_cast<uint32_t>(codes[i] ^ flip);
+            std::memcpy(out + i * 4, &v, 4);
+        }
+        break;
+    default:
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64_t v = codes[i] ^ flip;
+            std::memcpy(out + i * 8, &v, 8);
+        }
+        break;
+    }
+}
+
+// Упаковка: u64 минимум | u8 bits | слова (на одно больше, чем нужно, чтобы
+// распаковка могла всегда читать пару соседних слов)
+inline void PackValues(const uint64_t* values, size_t count, std::string& out)
+{
+    BinaryWriter writer(out);
+    uint64_t low = count ? values[0] : 0, high = low;
+    for (size_t i = 1; i < count; ++i)
+    {
+        low = std::min(low, values[i]);
+        high = std::max(high, values[i]);
+    }
+    int bits = BitsFor(high - low);
+    writer.u64(low);
+    writer.u8(static_cast<uint8_t>(bits));
+    if (bits == 0) return;
+
+    std::vector<uint64_t> words((count * bits + 63) / 64 + 1, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t value = values[i] - low;
+        size_t bit = i * bits;
+        size_t k = bit >> 6;
+        unsigned shift = bit & 63;
+        words[k] |= value << shift;
+        if (shift + bits > 64) words[k + 1] |= value >> (64 - shift);
+    }
+    for (uint64_t word : words) writer.u64(word);
+}
+
+inline void UnpackValues(BinaryReader& reader, size_t count, uint64_t* out)
+{
+    uint64_t low = reader.u64();
+    int bits = reader.u8();
+    if (bits > 64)
+    {
+        throw std::runtime_error("Corrupted compressed column");
+    }
+    if (bits == 0)
+    {
+        std::fill(out, out + count, low);
+        return;
+    }
+
+    size_t wordCount = (count * bits + 63) / 64 + 1;
+    const char* bytes = reader.bytes(wordCount * 8);
+    std::vector<uint64_t> words(wordCount);
+    std::memcpy(words.data(), bytes, wordCount * 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (auto& word : words) word = __builtin_bswap64(word);
+#endif
+
+    const uint64_t* w = words.data();
+    uint64_t mask = StructLayout::maskOf(bits);
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t bit = i * bits;
+        size_t k = bit >> 6;
+        unsigned shift = bit & 63;
+        uint64_t value = (w[k] >> shift) | ((w[k + 1] << 1) << (63 - shift));
+        out[i] = low + (value & mask);
+    }
+}
+
+// Выбор способа кодирования по выборке: несколько непрерывных кусков колонки
+// (непрерывных, чтобы оценить серии и разности)
+inline ColumnEncoding ChooseColumnEncoding(const uint64_t* codes, size_t count, size_t elementSize)
+{
+    if (count < 2) return PlainEncoding;
+    const size_t Chunk = 128, Chunks = 8, MaxDictionary = 1024;
+    size_t stride = count <= Chunk * Chunks ? Chunk : count / Chunks;
+
+    uint64_t low = codes[0], high = codes[0];
+    int64_t deltaLow = 0, deltaHigh = 0;
+    bool haveDelta = false;
+    size_t sampled = 0, runs = 0;
+    std::vector<uint64_t> distinct;
+    for (size_t start = 0; start < count; start += stride)
+    {
+        size_t end = std::min(count, start + Chunk);
+        for (size_t i = start; i < end; ++i)
+        {
+            uint64_t v = codes[i];
+            low = std::min(low, v);
+            high = std::max(high, v);
+            if (i == start || v != codes[i - 1]) ++runs;
+            if (i > start)
+            {
+                int64_t delta = static_cast<int64_t>(v - codes[i - 1]);
+                deltaLow = haveDelta ? std::min(deltaLow, delta) : delta;
+                deltaHigh = haveDelta ? std::max(deltaHigh, delta) : delta;
+                haveDelta = true;
+            }
+            if (distinct.size() <= MaxDictionary &&
+                std::find(distinct.begin(), distinct.end(), v) == distinct.end())
+            {
+                distinct.push_back(v);
+            }
+            ++sampled;
+        }
+    }
+
+    // Оценка размера в битах на значение
+    double plain = static_cast<double>(elementSize * 8);
+    int forBits = BitsFor(high - low);
+    double bitPack = forBits;
+    double delta = haveDelta ? BitsFor(static_cast<uint64_t>(deltaHigh) - static_cast<uint64_t>(deltaLow)) : plain;
+    // Разности внутри кусков могут быть нулевыми, а между кусками - нет:
+    // если значения различаются, на разность нужен хотя бы бит
+    if (forBits > 0) delta = std::max(delta, 1.0);
+    double runLength = static_cast<double>(runs) / sampled * (forBits + BitsFor(sampled / runs) + 1);
+    double dictionary = distinct.size() > MaxDictionary ? plain
+        : BitsFor(distinct.size() - 1) + static_cast<double>(distinct.size()) * forBits / count;
+
+    ColumnEncoding best = PlainEncoding;
+    double bestBits = plain;
+    const ColumnEncoding candidates[] = { BitPackEncoding, DeltaEncoding, RunLengthEncoding, DictionaryEncoding };
+    const double estimates[] = { bitPack, delta, runLength, dictionary };
+    for (int c = 0; c < 4; ++c)
+    {
+        if (estimates[c] < bestBits)
+        {
+            best = candidates[c];
+            bestBits = estimates[c];
+        }
+    }
+    return best;
+}
+
+// Кодирование колонки выбранным способом; false - способ не подходит для этих данных
+inline bool EncodeColumnAs(ColumnEncoding encoding, const std::vector<uint64_t>& codes, std::string& out)
+{
+    size_t count = codes.size();
+    BinaryWriter writer(out);
+    switch (encoding)
+    {
+    case BitPackEncoding:
+        PackValues(codes.data(), count, out);
+        return true;
+    case DeltaEncoding:
+    {
+        // Разности хранятся как знаковые с инвертированным старшим битом
+        std::vector<uint64_t> deltas(count ? count - 1 : 0);
+        for (size_t i = 1; i < count; ++i)
+        {
+            deltas[i - 1] = (codes[i] - codes[i - 1]) ^ (1ULL << 63);
+        }
+        writer.u64(count ? codes[0] : 0);
+        PackValues(deltas.data(), deltas.size(), out);
+        return true;
+    }
+    case RunLengthEncoding:
+    {
+        std::vector<uint64_t> values, lengths;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (i == 0 || codes[i] != codes[i - 1])
+            {
+                values.push_back(codes[i]);
+                lengths.push_back(0);
+            }
+            ++lengths.back();
+        }
+        writer.u32(static_cast<uint32_t>(values.size()));
+        PackValues(values.data(), values.size(), out);
+        PackValues(lengths.data(), lengths.size(), out);
+        return true;
+    }
+    case DictionaryEncoding:
+    {
+        std::vector<uint64_t> dictionary(codes);
+        std::sort(dictionary.begin(), dictionary.end());
+        dictionary.erase(std::unique(dictionary.begin(), dictionary.end()), dictionary.end());
+        // Выборка могла недооценить число различных значений
+        if (dictionary.size() > 65536) return false;
+        std::vector<uint64_t> indices(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            indices[i] = std::lower_bound(dictionary.begin(), dictionary.end(), codes[i]) - dictionary.begin();
+        }
+        writer.u32(static_cast<uint32_t>(dictionary.size()));
+        PackValues(dictionary.data(), dictionary.size(), out);
+        PackValues(indices.data(), count, out);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+inline void EncodeColumn(const Column& column, std::string& out)
+{
+    size_t count = column.count();
+    std::vector<uint64_t> codes(count);
+    for (size_t i = 0; i < count; ++i) codes[i] = ColumnCode(column, i);
+
+    ColumnEncoding encoding = ChooseColumnEncoding(codes.data(), count, column.elementSize);
+    std::string body;
+    if (encoding != PlainEncoding &&
+        (!EncodeColumnAs(encoding, codes, body) || body.size() >= column.bytes.size()))
+    {
+        body.clear();
+        encoding = PlainEncoding;
+    }
+    if (encoding == PlainEncoding)
+    {
+        // Байты колонки в порядке хоста переводятся в little-endian
+        BinaryWriter writer(body);
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64_t raw = StructLayout::loadUnit(column.bytes.data() + i * column.elementSize, column.elementSize);
+            for (size_t b = 0; b < column.elementSize; ++b) writer.u8(static_cast<uint8_t>(raw >> (8 * b)));
+        }
+    }
+
+    BinaryWriter writer(out);
+    writer.u8(static_cast<uint8_t>(encoding));
+    writer.u32(static_cast<uint32_t>(body.size()));
+    writer.bytes(body.data(), body.size());
+}
+
+inline void DecodeColumn(ColumnEncoding encoding, const char* data, size_t size, Column& column)
+{
+    size_t count = column.count();
+    BinaryReader reader(data, size);
+    std::vector<uint64_t> codes(count);
+    switch (encoding)
+    {
+    case PlainEncoding:
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(reader.bytes(count * column.elementSize));
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64_t raw = 0;
+            for (size_t b = 0; b < column.elementSize; ++b)
+            {
+                raw |= static_cast<uint64_t>(bytes[i * column.elementSize + b]) << (8 * b);
+            }
+            StructLayout::storeUnit(column.bytes.data() + i * column.elementSize, column.elementSize, raw);
+        }
+        return;
+    }
+    case BitPackEncoding:
+        UnpackValues(reader, count, codes.data());
+        break;
+    case DeltaEncoding:
+    {
+        uint64_t value = reader.u64();
+        if (count)
+        {
+            UnpackValues(reader, count - 1, codes.data() + 1);
+            codes[0] = value;
+            for (size_t i = 1; i < count; ++i)
+            {
+                value += codes[i] ^ (1ULL << 63);
+                codes[i] = value;
+            }
+        }
+        break;
+    }
+    case RunLengthEncoding:
+    {
+        uint32_t runs = reader.u32();
+        if (runs > count)
+        {
+            throw std::runtime_error("Corrupted compressed column");
+        }
+        std::vector<uint64_t> values(runs), lengths(runs);
+        UnpackValues(reader, runs, values.data());
+        UnpackValues(reader, runs, lengths.data());
+        size_t position = 0;
+        for (uint32_t r = 0; r < runs; ++r)
+        {
+            if (lengths[r] > count - position)
+            {
+                throw std::runtime_error("Corrupted compressed column");
+            }
+            std::fill(codes.begin() + position, codes.begin() + position + lengths[r], values[r]);
+            position += lengths[r];
+        }
+        if (position != count)
+        {
+            throw std::runtime_error("Corrupted compressed column");
+        }
+        break;
+    }
+    case DictionaryEncoding:
+    {
+        uint32_t entries = reader.u32();
+        if (entries == 0 || entries > 65536)
+        {
+            throw std::runtime_error("Corrupted compressed column");
+        }
+        std::vector<uint64_t> dictionary(entries);
+        UnpackValues(reader, entries, dictionary.data());
+        UnpackValues(reader, count, codes.data());
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (codes[i] >= entries)
+            {
+                throw std::runtime_error("Corrupted compressed column");
+            }
+            codes[i] = dictionary[codes[i]];
+        }
+        break;
+    }
+    default:
+        throw std::runtime_error("Unknown column encoding");
+    }
+    StoreColumnCodes(codes.data(), count, column);
+}
+
+// Сжатие блока записей
+inline void CompressBlock(const StructLayout& layout, const char* records, size_t count, std::string& out)
+{
+    ColumnSet columns = transpose(layout, records, count);
+    BinaryWriter writer(out);
+    writer.u32(static_cast<uint32_t>(count));
+    writer.u32(static_cast<uint32_t>(columns.columnCount()));
+    for (const auto& column : columns.columns())
+    {
+        EncodeColumn(column, out);
+    }
+}
+
+// Сжатый блок: разбирается только оглавление, поля распаковываются по запросу
+class CompressedBlock
+{
+public:
+    CompressedBlock(const StructLayout& layout, const char* data, size_t size) : m_layout(layout)
+    {
+        BinaryReader reader(data, size);
+        m_count = reader.u32();
+        uint32_t fields = reader.u32();
+        if (fields != layout.fieldCount())
+        {
+            throw std::runtime_error("Compressed block does not match layout");
+        }
+        m_entries.resize(fields);
+        for (auto& entry : m_entries)
+        {
+            uint8_t encoding = reader.u8();
+            if (encoding > DictionaryEncoding)
+            {
+                throw std::runtime_error("Unknown column encoding");
+            }
+            entry.encoding = static_cast<ColumnEncoding>(encoding);
+            entry.size = reader.u32();
+            entry.data = reader.bytes(entry.size);
+        }
+    }
+
+    size_t count() const { return m_count; }
+    ColumnEncoding encoding(size_t fieldIndex) const { return m_entries[fieldIndex].encoding; }
+    size_t encodedSize(size_t fieldIndex) const { return m_entries[fieldIndex].size; }
+
+    // Распаковка только выбранных полей
+    void decode(const std::vector<size_t>& fieldIndices, ColumnSet& columns) const
+    {
+        columns.reset(m_layout, fieldIndices, m_count);
+        for (size_t c = 0; c < fieldIndices.size(); ++c)
+        {
+            const Entry& entry = m_entries[fieldIndices[c]];
+            DecodeColumn(entry.encoding, entry.data, entry.size, columns.column(c));
+        }
+    }
+
+    // Распаковка в записи целиком
+    void decodeRecords(char* records) const
+    {
+        std::vector<size_t> all(m_layout.fieldCount());
+        for (size_t i = 0; i < all.size(); ++i) all[i] = i;
+        ColumnSet columns;
+        decode(all, columns);
+        pack(m_layout, columns, records);
+    }
+
+private:
+    struct Entry
+    {
+        ColumnEncoding encoding;
+        size_t size;
+        const char* data;
+    };
+
+    const StructLayout& m_layout;
+    size_t m_count;
+    std::vector<Entry> m_entries;
+};
+
+#endif // STRUCTCOMPRESS_H
@@ -0,0 +1,361 @@
+#ifndef STRUCTCONVERT_H
+#define STRUCTCONVERT_H
+
+#include "struct_layout.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <stdexcept>
+#include <algorithm>
+
+// Перевод записей из одной версии структуры в другую. Поля сопоставляются по имени
+// один раз в конструкторе, дальше работает готовый план:
+//  - контейнеры, разложенные одинаково, копируются memcpy (соседние - одним куском);
+//  - остальные поля расширяются/сужаются по правилам C и собираются в контейнер
+//    целевой записи в регистре, с одной записью в память на контейнер; вещественные
+//    значения в целые поля переводятся с насыщением (NaN - 0);
+//  - новые поля получают значения по умолчанию (0 или заданные setDefault).
+class Converter
+{
+public:
+    Converter(const StructLayout& from, const StructLayout& to)
+        : m_from(from), m_to(to), m_template(to.size(), 0), m_fullCopy(false)
+    {
+        std::vector<Unit> targetUnits = unitsOf(to);
+        std::vector<Unit> sourceUnits = unitsOf(from);
+        std::map<std::pair<int, size_t>, size_t> sourceUnitAt;
+        for (size_t u = 0; u < sourceUnits.size(); ++u)
+        {
+            sourceUnitAt[std::make_pair(sourceUnits[u].byteOffset, sourceUnits[u].size)] = u;
+        }
+
+        std::vector<Run> runs;
+        for (const Unit& unit : targetUnits)
+        {
+            int sourceOffset = copySource(unit, sourceUnits, sourceUnitAt);
+            if (sourceOffset >= 0)
+            {
+                Run run = { static_cast<size_t>(sourceOffset), static_cast<size_t>(unit.byteOffset), unit.size };
+                runs.push_back(run);
+                continue;
+            }
+            Target target;
+            target.byteOffset = unit.byteOffset;
+            target.size = unit.size;
+            target.firstStep = m_steps.size();
+            uint64_t written = 0;
+            for (size_t index : unit.fields)
+            {
+                const StructLayout::Field& field = to.field(index);
+                int source = from.indexOf(field.name);
+                if (source < 0)
+                {
+                    m_defaulted.push_back(index);
+                    continue;
+                }
+                m_steps.push_back(stepFor(from.field(static_cast<size_t>(source)), field));
+                written |= field.isBitField ? field.mask << field.bitOffset : StructLayout::maskOf(field.bitWidth);
+            }
+            target.stepCount = m_steps.size() - target.firstStep;
+            target.keep = ~written & StructLayout::maskOf(static_cast<int>(unit.size * 8));
+            if (target.stepCount) m_targets.push_back(target);
+        }
+
+        // Соседние куски, идущие подряд и в источнике, и в цели, сливаются
+        std::sort(runs.begin(), runs.end(), [](const Run& a, const Run& b) { return a.to < b.to; });
+        size_t covered = 0;
+        for (const Run& run : runs)
+        {
+            covered += run.length;
+            if (!m_runs.empty() && m_runs.back().to + m_runs.back().length == run.to &&
+                m_runs.back().from + m_runs.back().length == run.from)
+            {
+                m_runs.back().length += run.length;
+                continue;
+            }
+            m_runs.push_back(run);
+        }
+        // Если куски покрывают всю целевую запись, заготовка не нужна
+        m_fullCopy = m_targets.empty() && covered == to.size() && m_runs.size() == 1;
+    }
+
+    const StructLayout& from() const { return m_from; }
+    const StructLayout& to() const { return m_to; }
+
+    // Значение нового поля (которого нет в исходной структуре)
+    Converter& setDefault(const std::string& fieldName, int64_t value)
+    {
+        m_to.writeInt(defaultedField(fieldName), value, m_template.data());
+        return *this;
+    }
+
+    Converter& setDefaultDouble(const std::string& fieldName, double value)
+    {
+        m_to.writeDouble(defaultedField(fieldName), value, m_template.data());
+        return *this;
+    }
+
+    // Поля цели без пары в источнике
+    std::vector<std::string> defaultedFields() const
+    {
+        std::vector<std::string> names;
+        for (size_t index : m_defaulted) names.push_back(m_to.field(index).name);
+        return names;
+    }
+
+    // Байты, копируемые memcpy, и поля, требующие преобразования
+    size_t copiedBytes() const
+    {
+        size_t bytes = 0;
+        for (const Run& run : m_runs) bytes += run.length;
+        return bytes;
+    }
+
+    size_t convertedFields() const { return m_steps.size(); }
+
+    void convert(const char* source, char* target) const { convert(source, 1, target); }
+
+    // count записей подряд; буферы не должны перекрываться
+    void convert(const char* sources, size_t count, char* targets) const
+    {
+        size_t sourceSize = m_from.size();
+        size_t targetSize = m_to.size();
+        const Run* runs = m_runs.data();
+        size_t runCount = m_runs.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const char* source = sources + i * sourceSize;
+            char* target = targets + i * targetSize;
+            if (m_fullCopy)
+            {
+                std::memcpy(target, source + runs[0].from, targetSize);
+                continue;
+            }
+            std::memcpy(target, m_template.data(), targetSize);
+            for (size_t r = 0; r < runCount; ++r)
+            {
+                std::memcpy(target + runs[r].to, source + runs[r].from, runs[r].length);
+            }
+            for (const Target& t : m_targets)
+            {
+                char* p = target + t.byteOffset;
+                uint64_t value = t.keep ? StructLayout::loadUnit(p, t.size) & t.keep : 0;
+                const Step* step = &m_steps[t.firstStep];
+                for (size_t s = 0; s < t.stepCount; ++s)
+                {
+                    value |= convertValue(step[s], source) << step[s].toShift;
+                }
+                StructLayout::storeUnit(p, t.size, value);
+            }
+        }
+    }
+
+    std::vector<char> convertAll(const char* sources, size_t count) const
+    {
+        std::vector<char> targets(count * m_to.size());
+        convert(sources, count, targets.data());
+        return targets;
+    }
+
+private:
+    // Контейнер: обычное поле или общий контейнер битовых полей
+    struct Unit
+    {
+        int byteOffset;
+        size_t size;
+        std::vector<size_t> fields;
+    };
+
+    struct Run
+    {
+        size_t from;
+        size_t to;
+        size_t length;
+    };
+
+    // Преобразование одного поля; смещения и маски скопированы из layout
+    struct Step
+    {
+        int fromOffset;
+        size_t fromSize;
+        int fromShift;
+        int fromWidth;
+        uint64_t fromMask;
+        StructLayout::ValueKind fromKind;
+        int toShift;
+        int toWidth;
+        uint64_t toMask;
+        StructLayout::ValueKind toKind;
+    };
+
+    // Целевой контейнер, собираемый из нескольких шагов
+    struct Target
+    {
+        int byteOffset;
+        size_t size;
+        uint64_t keep;      // биты, которые берутся из заготовки
+        size_t firstStep;
+        size_t stepCount;
+    };
+
+    static std::vector<Unit> unitsOf(const StructLayout& layout)
+    {
+        std::vector<Unit> units;
+        std::map<std::pair<int, size_t>, size_t> containers;
+        for (size_t i = 0; i < layout.fieldCount(); ++i)
+        {
+            const StructLayout::Field& field = layout.field(i);
+            auto key = std::make_pair(field.byteOffset, field.size);
+            auto it = field.isBitField ? containers.find(key) : containers.end();
+            if (it != containers.end())
+            {
+                units[it->second].fields.push_back(i);
+                continue;
+            }
+            if (field.isBitField) containers[key] = units.size();
+            Unit unit = { field.byteOffset, field.size, std::vector<size_t>(1, i) };
+            units.push_back(unit);
+        }
+        return units;
+    }
+
+    static bool sameBits(const StructLayout::Field& a, const StructLayout::Field& b)
+    {
+        return a.size == b.size && a.isBitField == b.isBitField && a.bitOffset == b.bitOffset &&
+               a.bitWidth == b.bitWidth && a.kind == b.kind;
+    }
+
+    // Смещение исходного контейнера, который можно скопировать в unit байт в байт, или -1:
+    // тот же набор полей с теми же битами, без лишних полей в источнике
+    int copySource(const Unit& unit, const std::vector<Unit>& sourceUnits,
+                   const std::map<std::pair<int, size_t>, size_t>& sourceUnitAt) const
+    {
+        int sourceOffset = -1;
+        for (size_t index : unit.fields)
+        {
+            const StructLayout::Field& field = m_to.field(index);
+            int source = m_from.indexOf(field.name);
+            if (source < 0) return -1;
+            const StructLayout::Field& from = m_from.field(static_cast<size_t>(source));
+            if (!sameBits(from, field)) return -1;
+            if (sourceOffset >= 0 && sourceOffset != from.byteOffset) return -1;
+            sourceOffset = from.byteOffset;
+        }
+        if (unit.fields.size() > 1 || m_to.field(unit.fields[0]).isBitField)
+        {
+            auto it = sourceUnitAt.find(std::make_pair(sourceOffset, unit.size));
+            if (it == sourceUnitAt.end() || sourceUnits[it->second].fields.size() != unit.fields.size()) return -1;
+        }
+        return sourceOffset;
+    }
+
+    static Step stepFor(const StructLayout::Field& from, const StructLayout::Field& to)
+    {
+        Step step;
+        step.fromOffset = from.byteOffset;
+        step.fromSize = from.size;
+        step.fromShift = from.isBitField ? from.bitOffset : 0;
+        step.fromWidth = from.bitWidth;
+        step.fromMask = from.mask;
+        step.fromKind = from.kind;
+        step.toShift = to.isBitField ? to.bitOffset : 0;
+        step.toWidth = to.bitWidth;
+        step.toMask = to.mask;
+        step.toKind = to.kind;
+        return step;
+    }
+
+    // Биты целевого поля (до сдвига) по значению исходного
+    static uint64_t convertValue(const Step& step, const char* source)
+    {
+        uint64_t bits = (StructLayout::loadUnit(source + step.fromOffset, step.fromSize) >> step.fromShift) & step.fromMask;
+        bool realSource = step.fromKind == StructLayout::FloatValue || step.fromKind == StructLayout::DoubleValue;
+        bool realTarget = step.toKind == StructLayout::FloatValue || step.toKind == StructLayout::DoubleValue;
+        if (!realSource && !realTarget)
+        {
+            if (step.fromKind == StructLayout::SignedValue)
+            {
+                bits = static_cast<uint64_t>(StructLayout::signExtend(bits, step.fromWidth));
+            }
+            return bits & step.toMask;
+        }
+
+        double value;
+        if (step.fromKind == StructLayout::FloatValue)
+        {
+            float narrow;
+            uint32_t raw = static_cast<uint32_t>(bits);
+            std::memcpy(&narrow, &raw, sizeof(narrow));
+            value = narrow;
+        }
+        else if (step.fromKind == StructLayout::DoubleValue)
+        {
+            std::memcpy(&value, &bits, sizeof(value));
+        }
+        else if (step.fromKind == StructLayout::SignedValue)
+        {
+            value = static_cast<double>(StructLayout::signExtend(bits, step.fromWidth));
+        }
+        else
+        {
+            value = static_cast<double>(bits);
+        }
+
+        if (step.toKind == StructLayout::FloatValue)
+        {
+            float narrow = static_cast<float>(value);
+            uint32_t raw;
+            std::memcpy(&raw, &narrow, sizeof(raw));
+            return raw;
+        }
+        if (step.toKind == StructLayout::DoubleValue)
+        {
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+        return saturate(step, value);
+    }
+
+    // Вещественное значение в целом поле шириной toWidth: дробная часть отбрасывается,
+    // NaN дает 0, значения вне диапазона поля (и бесконечности) - его минимум или максимум
+    static uint64_t saturate(const Step& step, double value)
+    {
+        if (value != value) return 0;
+        if (step.toKind == StructLayout::SignedValue)
+        {
+            double limit = std::ldexp(1.0, step.toWidth - 1);
+            if (value >= limit) return step.toMask >> 1;
+            if (value <= -limit) return (step.toMask >> 1) + 1;
+            return static_cast<uint64_t>(static_cast<int64_t>(value)) & step.toMask;
+        }
+        if (value <= 0) return 0;
+        if (value >= std::ldexp(1.0, step.toWidth)) return step.toMask;
+        return static_cast<uint64_t>(value);
+    }
+
+    size_t defaultedField(const std::string& fieldName) const
+    {
+        size_t index = m_to.fieldIndex(fieldName);
+        if (std::find(m_defaulted.begin(), m_defaulted.end(), index) == m_defaulted.end())
+        {
+            throw std::invalid_argument("Field " + fieldName + " is converted from the source layout");
+        }
+        return index;
+    }
+
+    const StructLayout& m_from;
+    const StructLayout& m_to;
+    std::vector<char> m_template;      // заготовка целевой записи: нули и значения по умолчанию
+    std::vector<Run> m_runs;
+    std::vector<Step> m_steps;
+    std::vector<Target> m_targets;
+    std::vector<size_t> m_defaulted;
+    bool m_fullCopy;
+};
+
+#endif // STRUCTCONVERT_H
@@ -0,0 +1,191 @@
+#ifndef STRUCTDIFF_H
+#define STRUCTDIFF_H
+
+#include "struct_binary.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// Сравнение снимков таблицы записей и передача только изменений.
+// Записи сравниваются 8-байтовыми словами под маской значимых бит (valueMask), поэтому
+// мусор в выравнивании и в свободных битах контейнеров не считается изменением.
+// Для отличающихся записей строится битовый набор измененных полей.
+//
+// Формат дельты: "SPRD" | u32 размер записи | u32 число полей | u32 CRC layout |
+// u64 число записей после | u64 число измененных записей |
+// (varint пропуск от предыдущей измененной | набор полей, (n + 7) / 8 байт |
+//  значения измененных полей, (bitWidth + 7) / 8 байт little-endian)*.
+// Новые записи (за концом старого снимка) сравниваются с нулевой записью.
+class RecordDiff
+{
+public:
+    explicit RecordDiff(const StructLayout& layout)
+        : m_layout(layout), m_words((layout.size() + 7) / 8), m_mask(m_words, 0), m_zero(layout.size(), 0)
+    {
+        std::vector<unsigned char> bytes = layout.valueMask();
+        bytes.resize(m_words * 8, 0);
+        std::memcpy(m_mask.data(), bytes.data(), bytes.size());
+
+        std::string blob;
+        SerializeLayout(layout, blob);
+        m_layoutCrc = Crc32(blob.data(), blob.size());
+    }
+
+    const StructLayout& layout() const { return m_layout; }
+
+    // Размер набора измененных полей одной записи в словах uint64_t
+    size_t wordsPerRecord() const { return (m_layout.fieldCount() + 63) / 64; }
+
+    bool equal(const char* a, const char* b) const
+    {
+        size_t full = m_layout.size() / 8;
+        uint64_t difference = 0;
+        for (size_t w = 0; w < full; ++w)
+        {
+            uint64_t x, y;
+            std::memcpy(&x, a + w * 8, 8);
+            std::memcpy(&y, b + w * 8, 8);
+            difference |= (x ^ y) & m_mask[w];
+        }
+        size_t tail = m_layout.size() - full * 8;
+        if (tail)
+        {
+            uint64_t x = 0, y = 0;
+            std::memcpy(&x, a + full * 8, tail);
+            std::memcpy(&y, b + full * 8, tail);
+            difference |= (x ^ y) & m_mask[full];
+        }
+        return difference == 0;
+    }
+
+    // Набор измененных полей (wordsPerRecord() слов) и их число
+    size_t changedFields(const char* a, const char* b, uint64_t* bits) const
+    {
+        size_t words = wordsPerRecord();
+        std::memset(bits, 0, words * sizeof(uint64_t));
+        if (equal(a, b)) return 0;
+        size_t changed = 0;
+        for (size_t i = 0; i < m_layout.fieldCount(); ++i)
+        {
+            if (m_layout.readBits(i, a) != m_layout.readBits(i, b))
+            {
+                bits[i / 64] |= 1ULL << (i % 64);
+                ++changed;
+            }
+        }
+        return changed;
+    }
+
+    // Наборы измененных полей для count пар записей; возвращает число измененных записей
+    size_t compare(const char* before, const char* after, size_t count, std::vector<uint64_t>& bits) const
+    {
+        size_t words = wordsPerRecord();
+        size_t recordSize = m_layout.size();
+        bits.assign(count * words, 0);
+        size_t changed = 0;
+        for (size_t r = 0; r < count; ++r)
+        {
+            if (changedFields(before + r * recordSize, after + r * recordSize, bits.data() + r * words)) ++changed;
+        }
+        return changed;
+    }
+
+    void encode(const char* before, size_t beforeCount, const char* after, size_t afterCount, std::string& delta) const
+    {
+        size_t recordSize = m_layout.size();
+        size_t fieldCount = m_layout.fieldCount();
+        BinaryWriter writer(delta);
+        writer.bytes("SPRD", 4);
+        writer.u32(static_cast<uint32_t>(recordSize));
+        writer.u32(static_cast<uint32_t>(fieldCount));
+        writer.u32(m_layoutCrc);
+        writer.u64(afterCount);
+        size_t countPosition = delta.size();
+        writer.u64(0);
+
+        std::vector<uint64_t> bits(wordsPerRecord());
+        std::string set((fieldCount + 7) / 8, '\0');
+        uint64_t changed = 0;
+        size_t previous = 0;
+        for (size_t r = 0; r < afterCount; ++r)
+        {
+            const char* old = r < beforeCount ? before + r * recordSize : m_zero.data();
+            const char* now = after + r * recordSize;
+            if (!changedFields(old, now, bits.data())) continue;
+
+            writer.varint(r - previous);
+            previous = r + 1;
+            for (size_t b = 0; b < set.size(); ++b) set[b] = static_cast<char>(bits[b / 8] >> (8 * (b % 8)));
+            writer.bytes(set.data(), set.size());
+            for (size_t i = 0; i < fieldCount; ++i)
+            {
+                if (!(bits[i / 64] >> (i % 64) & 1)) continue;
+                uint64_t value = m_layout.readBits(i, now);
+                for (int k = 0; k < (m_layout.field(i).bitWidth + 7) / 8; ++k)
+                {
+                    writer.u8(static_cast<uint8_t>(value >> (8 * k)));
+                }
+            }
+            ++changed;
+        }
+        for (int k = 0; k < 8; ++k) delta[countPosition + k] = static_cast<char>(changed >> (8 * k));
+    }
+
+    // Применение дельты к старому снимку: буфер приводится к новому числу записей
+    void apply(const char* delta, size_t size, std::vector<char>& records) const
+    {
+        BinaryReader reader(delta, size);
+        size_t recordSize = m_layout.size();
+        size_t fieldCount = m_layout.fieldCount();
+        if (std::memcmp(reader.bytes(4), "SPRD", 4) != 0)
+        {
+            throw std::runtime_error("Not a record delta");
+        }
+        if (reader.u32() != recordSize || reader.u32() != fieldCount || reader.u32() != m_layoutCrc)
+        {
+            throw std::runtime_error("Record delta was built for a different layout");
+        }
+        uint64_t afterCount = reader.u64();
+        uint64_t changed = reader.u64();
+        if (changed > afterCount || changed > reader.remaining())
+        {
+            throw std::runtime_error("Corrupted record delta");
+        }
+        records.resize(static_cast<size_t>(afterCount) * recordSize, 0);
+
+        size_t setBytes = (fieldCount + 7) / 8;
+        uint64_t next = 0;
+        for (uint64_t e = 0; e < changed; ++e)
+        {
+            uint64_t r = next + reader.varint();
+            if (r < next || r >= afterCount)
+            {
+                throw std::runtime_error("Corrupted record delta");
+            }
+            next = r + 1;
+            const char* set = reader.bytes(setBytes);
+            char* record = records.data() + r * recordSize;
+            for (size_t i = 0; i < fieldCount; ++i)
+            {
+                if (!(static_cast<unsigned char>(set[i / 8]) >> (i % 8) & 1)) continue;
+                int width = (m_layout.field(i).bitWidth + 7) / 8;
+                const char* p = reader.bytes(width);
+                uint64_t value = 0;
+                for (int k = 0; k < width; ++k) value |= static_cast<uint64_t>(static_cast<unsigned char>(p[k])) << (8 * k);
+                m_layout.writeBits(i, value, record);
+            }
+        }
+    }
+
+private:
+    const StructLayout& m_layout;
+    size_t m_words;
+    std::vector<uint64_t> m_mask;   // valueMask по словам, хвост дополнен нулями
+    std::vector<char> m_zero;
+    uint32_t m_layoutCrc;
+};
+
+#endif // STRUCTDIFF_H
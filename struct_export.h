@@ -0,0 +1,344 @@
+#ifndef STRUCTEXPORT_H
+#define STRUCTEXPORT_H
+
+#include "struct_layout.h"
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+// Растущий буфер текста; память переиспользуется между вызовами clear()
+class TextBuffer
+{
+public:
+    TextBuffer() : m_size(0) {}
+
+    const char* data() const { return m_data.data(); }
+    size_t size() const { return m_size; }
+    void clear() { m_size = 0; }
+    std::string str() const { return std::string(m_data.data(), m_size); }
+
+    // Место под n символов; вызывающий пишет в него и сдвигает размер через advance()
+    char* reserve(size_t n)
+    {
+        if (m_size + n > m_data.size())
+        {
+            m_data.resize(std::max(m_data.size() * 2, m_size + n));
+        }
+        return m_data.data() + m_size;
+    }
+
+    void advance(size_t n) { m_size += n; }
+
+    void put(char c)
+    {
+        *reserve(1) = c;
+        ++m_size;
+    }
+
+    void append(const char* text, size_t length)
+    {
+        std::memcpy(reserve(length), text, length);
+        m_size += length;
+    }
+
+    void append(const std::string& text) { append(text.data(), text.size()); }
+
+    void appendUnsigned(uint64_t value)
+    {
+        char text[20];
+        char* end = text + sizeof(text);
+        char* p = formatUnsigned(value, end);
+        append(p, end - p);
+    }
+
+    void appendSigned(int64_t value)
+    {
+        if (value < 0)
+        {
+            put('-');
+            appendUnsigned(0 - static_cast<uint64_t>(value));
+            return;
+        }
+        appendUnsigned(static_cast<uint64_t>(value));
+    }
+
+    // Кратчайшая запись, которая читается обратно в то же значение
+    void appendDouble(double value)
+    {
+        if (appendFixed(value, false)) return;
+        char* p = reserve(32);
+        int length = 0;
+        for (int precision = 15; precision <= 17; ++precision)
+        {
+            length = std::snprintf(p, 32, "%.*g", precision, value);
+            if (std::strtod(p, nullptr) == value) break;
+        }
+        m_size += length;
+    }
+
+    void appendFloat(float value)
+    {
+        if (appendFixed(value, true)) return;
+        char* p = reserve(32);
+        int length = 0;
+        for (int precision = 6; precision <= 9; ++precision)
+        {
+            length = std::snprintf(p, 32, "%.*g", precision, static_cast<double>(value));
+            if (std::strtof(p, nullptr) == value) break;
+        }
+        m_size += length;
+    }
+
+private:
+    static char* formatUnsigned(uint64_t value, char* end)
+    {
+        static const char digits[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+        char* p = end;
+        while (value >= 100)
+        {
+            unsigned pair = static_cast<unsigned>(value % 100) * 2;
+            value /= 100;
+            *--p = digits[pair + 1];
+            *--p = digits[pair];
+        }
+        if (value >= 10)
+        {
+            unsigned pair = static_cast<unsigned>(value) * 2;
+            *--p = digits[pair + 1];
+            *--p = digits[pair];
+        }
+        else
+        {
+            *--p = static_cast<char>('0' + value);
+        }
+        return p;
+    }
+
+    // Быстрый путь без snprintf: ищется наименьшее k, при котором m = value * 10^k
+    // целое (не больше 17 значащих цифр) и m / 10^k дает то же значение.
+    // При m < 2^53 проверка в double точна: m и 10^k представимы точно, а деление
+    // округляется так же, как strtod("m e-k"); для float двойное округление деления
+    // безвредно (53 >= 2 * 24 + 2). Более длинные m считаются в long double
+    // и проверяются strtod/strtof
+    bool appendFixed(double value, bool isFloat)
+    {
+        static const long double powers[] = { 1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L,
+                                              1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L,
+                                              1e18L, 1e19L, 1e20L, 1e21L, 1e22L };
+        double magnitude = std::fabs(value);
+        if (value == 0)
+        {
+            if (std::signbit(value)) put('-');
+            put('0');
+            return true;
+        }
+        if (!(magnitude >= 1e-5 && magnitude < 1e15)) return false;
+
+        for (int k = 0; k < 23; ++k)
+        {
+            long double scaled = magnitude * powers[k];
+            if (scaled >= 1e17L) return false;
+            long double m = std::floor(scaled + 0.5L);
+            bool exact = m < 9007199254740992.0L;
+            double back = exact ? static_cast<double>(m) / static_cast<double>(powers[k])
+                                : static_cast<double>(m / powers[k]);
+            if (isFloat ? static_cast<float>(back) != static_cast<float>(magnitude) : back != magnitude) continue;
+
+            char text[48];
+            char* end = text + sizeof(text);
+            char* p = formatUnsigned(static_cast<uint64_t>(m), end);
+            if (k > 0)
+            {
+                while (end - p <= k) *--p = '0';
+                std::memmove(p - 1, p, (end - p) - k);
+                --p;
+                end[-k - 1] = '.';
+            }
+            if (value < 0) *--p = '-';
+            if (!exact)
+            {
+                char check[48];
+                std::memcpy(check, p, end - p);
+                check[end - p] = '\0';
+                bool same = isFloat ? std::strtof(check, nullptr) == static_cast<float>(value)
+                                    : std::strtod(check, nullptr) == value;
+                if (!same) continue;
+            }
+            append(p, end - p);
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<char> m_data;
+    size_t m_size;
+};
+
+// Выгрузка записей в текст: CSV (строка заголовка + строка на запись) или NDJSON
+// (объект на строку). Поля форматируются прямо в буфер без промежуточных строк
+class RecordExporter
+{
+public:
+    enum Format
+    {
+        Csv,
+        NdJson
+    };
+
+    RecordExporter(const StructLayout& layout, Format format) : m_layout(layout), m_format(format)
+    {
+        std::vector<std::string> names;
+        for (const auto& field : layout.fields()) names.push_back(field.name);
+        init(names);
+    }
+
+    // Только выбранные поля, в указанном порядке
+    RecordExporter(const StructLayout& layout, Format format, const std::vector<std::string>& fieldNames)
+        : m_layout(layout), m_format(format)
+    {
+        init(fieldNames);
+    }
+
+    // Строка заголовка CSV (для NDJSON ничего не пишется)
+    void header(TextBuffer& out) const
+    {
+        if (m_format != Csv) return;
+        for (size_t c = 0; c < m_fields.size(); ++c)
+        {
+            if (c) out.put(',');
+            out.append(m_layout.field(m_fields[c]).name);
+        }
+        out.put('\n');
+    }
+
+    void append(const char* records, size_t count, TextBuffer& out) const
+    {
+        size_t recordSize = m_layout.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const char* record = records + i * recordSize;
+            if (m_format == NdJson) out.put('{');
+            for (size_t c = 0; c < m_fields.size(); ++c)
+            {
+                if (m_format == NdJson)
+                {
+                    out.append(m_keys[c]);
+                }
+                else if (c)
+                {
+                    out.put(',');
+                }
+                appendValue(m_fields[c], record, out);
+            }
+            if (m_format == NdJson) out.put('}');
+            out.put('\n');
+        }
+    }
+
+    // Выгрузка в файл кусками: буфер сбрасывается, когда набирает flushBytes
+    void write(const char* records, size_t count, std::FILE* file, bool withHeader = true,
+               size_t flushBytes = 1u << 20) const
+    {
+        TextBuffer buffer;
+        if (withHeader) header(buffer);
+        size_t recordSize = m_layout.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            append(records + i * recordSize, 1, buffer);
+            if (buffer.size() >= flushBytes) flush(buffer, file);
+        }
+        flush(buffer, file);
+    }
+
+private:
+    void init(const std::vector<std::string>& fieldNames)
+    {
+        for (const auto& name : fieldNames)
+        {
+            m_fields.push_back(m_layout.fieldIndex(name));
+            // Имена полей - идентификаторы C, экранирование не требуется
+            m_keys.push_back(std::string(m_keys.empty() ? "\"" : ",\"") + name + "\":");
+        }
+    }
+
+    void appendValue(size_t index, const char* record, TextBuffer& out) const
+    {
+        const StructLayout::Field& field = m_layout.field(index);
+        switch (field.kind)
+        {
+        case StructLayout::FloatValue:
+        {
+            float value;
+            std::memcpy(&value, record + field.byteOffset, sizeof(value));
+            if (!std::isfinite(value))
+            {
+                appendNonFinite(value, out);
+                return;
+            }
+            out.appendFloat(value);
+            return;
+        }
+        case StructLayout::DoubleValue:
+        {
+            double value;
+            std::memcpy(&value, record + field.byteOffset, sizeof(value));
+            if (!std::isfinite(value))
+            {
+                appendNonFinite(value, out);
+                return;
+            }
+            out.appendDouble(value);
+            return;
+        }
+        case StructLayout::SignedValue:
+            out.appendSigned(m_layout.readInt(index, record));
+            return;
+        default:
+            out.appendUnsigned(m_layout.readBits(index, record));
+            return;
+        }
+    }
+
+    // В JSON нет NaN и бесконечностей - пишется null
+    void appendNonFinite(double value, TextBuffer& out) const
+    {
+        if (m_format == NdJson)
+        {
+            out.append("null", 4);
+        }
+        else if (std::isnan(value))
+        {
+            out.append("nan", 3);
+        }
+        else
+        {
+            out.append(value < 0 ? "-inf" : "inf", value < 0 ? 4 : 3);
+        }
+    }
+
+    static void flush(TextBuffer& buffer, std::FILE* file)
+    {
+        if (buffer.size() && std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+        {
+            throw std::runtime_error("Unable to write exported records");
+        }
+        buffer.clear();
+    }
+
+    const StructLayout& m_layout;
+    Format m_format;
+    std::vector<size_t> m_fields;
+    std::vector<std::string> m_keys;
+};
+
+#endif // STRUCTEXPORT_H
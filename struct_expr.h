@@ -0,0 +1,479 @@
+#ifndef STRUCTEXPR_H
+#define STRUCTEXPR_H
+
+#include "struct_columns.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+
+// Вычисляемое поле: выражение над полями layout, например
+// "total = len * 4 + payload_off" или "(flags >> 2) & 3".
+// Поддерживаются + - * / % << >> & | ^ ~, унарный минус, скобки, целые и
+// дробные константы. Вычисления идут в int64_t, а если в выражении есть
+// float/double поле или дробная константа - в double (битовые операции тогда запрещены).
+// Текст компилируется один раз в стековый байткод; каждая инструкция
+// обрабатывает сразу пакет значений, поэтому внутренние циклы векторизуются.
+class Expression
+{
+public:
+    Expression(const StructLayout& layout, const std::string& text)
+        : m_layout(layout), m_text(text), m_pos(0), m_depth(0), m_maxDepth(0)
+    {
+        // Необязательное имя результата: "name = выражение"
+        size_t eq = m_text.find('=');
+        if (eq != std::string::npos)
+        {
+            std::string name = trimmed(m_text.substr(0, eq));
+            bool isName = !name.empty() && !std::isdigit(static_cast<unsigned char>(name[0]));
+            for (char c : name)
+            {
+                isName = isName && (std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.');
+            }
+            if (!isName)
+            {
+                throw std::invalid_argument("Invalid expression name: " + name);
+            }
+            m_name = name;
+            m_pos = eq + 1;
+        }
+        m_isReal = parseOr();
+        skipSpaces();
+        if (m_pos != m_text.size())
+        {
+            throw std::invalid_argument("Unexpected text in expression: " + m_text.substr(m_pos));
+        }
+    }
+
+    const std::string& name() const { return m_name; }
+    bool isReal() const { return m_isReal; }
+
+    // Поля layout, которые читает выражение
+    const std::vector<size_t>& fieldIndices() const { return m_fields; }
+
+    // Вычисление по колонкам (в наборе должны быть все поля из fieldIndices)
+    void evaluate(const ColumnSet& columns, std::vector<int64_t>& out) const
+    {
+        requireInteger();
+        out.resize(columns.count());
+        std::vector<Slot> stack = makeStack();
+        run(bind(columns), columns.count(), out.data(), nullptr, stack);
+    }
+
+    void evaluate(const ColumnSet& columns, std::vector<double>& out) const
+    {
+        out.resize(columns.count());
+        std::vector<Slot> stack = makeStack();
+        run(bind(columns), columns.count(), nullptr, out.data(), stack);
+    }
+
+    // Вычисление прямо по буферу записей: нужные поля транспонируются пакетами
+    void evaluate(const char* records, size_t count, std::vector<int64_t>& out) const
+    {
+        requireInteger();
+        out.resize(count);
+        runRecords(records, count, out.data(), nullptr);
+    }
+
+    void evaluate(const char* records, size_t count, std::vector<double>& out) const
+    {
+        out.resize(count);
+        runRecords(records, count, nullptr, out.data());
+    }
+
+private:
+    enum { BatchSize = 1024 };
+
+    enum OpCode
+    {
+        LoadField, LoadConst, ToReal,
+        Add, Sub, Mul, Div, Mod, Shl, Shr, BitAnd, BitOr, BitXor,
+        Neg, BitNot
+    };
+
+    struct Instruction
+    {
+        OpCode code;
+        bool isReal;        // операция над double
+        size_t operand;     // LoadField: номер в m_fields; ToReal: 1 - вершина стека, 2 - под ней
+        int64_t intValue;
+        double realValue;
+    };
+
+    struct Slot
+    {
+        std::vector<int64_t> ints;
+        std::vector<double> reals;
+    };
+
+    // Стек вычисления выделяется один раз на вызов evaluate и переиспользуется всеми пакетами
+    std::vector<Slot> makeStack() const
+    {
+        std::vector<Slot> stack(m_maxDepth);
+        for (auto& slot : stack)
+        {
+            slot.ints.resize(BatchSize);
+            slot.reals.resize(BatchSize);
+        }
+        return stack;
+    }
+
+    void requireInteger() const
+    {
+        if (m_isReal)
+        {
+            throw std::invalid_argument("Expression has floating point result: " + m_text);
+        }
+    }
+
+    std::vector<const Column*> bind(const ColumnSet& columns) const
+    {
+        std::vector<const Column*> bound;
+        for (size_t index : m_fields)
+        {
+            bound.push_back(&columns.column(m_layout.field(index).name));
+        }
+        return bound;
+    }
+
+    void runRecords(const char* records, size_t count, int64_t* ints, double* reals) const
+    {
+        ColumnSet batch;
+        std::vector<const Column*> bound;
+        std::vector<Slot> stack = makeStack();
+        for (size_t start = 0; start < count; start += BatchSize)
+        {
+            size_t n = count - start < BatchSize ? count - start : static_cast<size_t>(BatchSize);
+            batch.reset(m_layout, m_fields, n);
+            bound.clear();
+            for (size_t c = 0; c < m_fields.size(); ++c)
+            {
+                ExtractField(m_layout.field(m_fields[c]), records + start * m_layout.size(), m_layout.size(), n,
+                             batch.column(c).bytes.data());
+                bound.push_back(&batch.column(c));
+            }
+            run(bound, n, ints ? ints + start : nullptr, reals ? reals + start : nullptr, stack);
+        }
+    }
+
+    static void integerOp(OpCode code, int64_t* a, const int64_t* b, size_t n)
+    {
+        switch (code)
+        {
+        case Add: for (size_t i = 0; i < n; ++i) a[i] = static_cast<int64_t>(static_cast<uint64_t>(a[i]) + static_cast<uint64_t>(b[i])); break;
+        case Sub: for (size_t i = 0; i < n; ++i) a[i] = static_cast<int64_t>(static_cast<uint64_t>(a[i]) - static_cast<uint64_t>(b[i])); break;
+        case Mul: for (size_t i = 0; i < n; ++i) a[i] = static_cast<int64_t>(static_cast<uint64_t>(a[i]) * static_cast<uint64_t>(b[i])); break;
+        // Деление на ноль дает 0, а не аварийное завершение на середине пакета
+        case Div: for (size_t i = 0; i < n; ++i) a[i] = b[i] == 0 ? 0 : b[i] == -1 ? static_cast<int64_t>(0 - static_cast<uint64_t>(a[i])) : a[i] / b[i]; break;
+        case Mod: for (size_t i = 0; i < n; ++i) a[i] = b[i] == 0 || b[i] == -1 ? 0 : a[i] % b[i]; break;
+        case Shl: for (size_t i = 0; i < n; ++i) a[i] = static_cast<int64_t>(static_cast<uint64_t>(a[i]) << (b[i] & 63)); break;
+        case Shr: for (size_t i = 0; i < n; ++i) a[i] = a[i] >> (b[i] & 63); break;
+        case BitAnd: for (size_t i = 0; i < n; ++i) a[i] &= b[i]; break;
+        case BitOr: for (size_t i = 0; i < n; ++i) a[i] |= b[i]; break;
+        case BitXor: for (size_t i = 0; i < n; ++i) a[i] ^= b[i]; break;
+        default: break;
+        }
+    }
+
+    static void realOp(OpCode code, double* a, const double* b, size_t n)
+    {
+        switch (code)
+        {
+        case Add: for (size_t i = 0; i < n; ++i) a[i] += b[i]; break;
+        case Sub: for (size_t i = 0; i < n; ++i) a[i] -= b[i]; break;
+        case Mul: for (size_t i = 0; i < n; ++i) a[i] *= b[i]; break;
+        case Div: for (size_t i = 0; i < n; ++i) a[i] /= b[i]; break;
+        case Mod: for (size_t i = 0; i < n; ++i) a[i] = std::fmod(a[i], b[i]); break;
+        default: break;
+        }
+    }
+
+    void run(const std::vector<const Column*>& columns, size_t count, int64_t* ints, double* reals,
+             std::vector<Slot>& stack) const
+    {
+        for (size_t start = 0; start < count; start += BatchSize)
+        {
+            size_t n = count - start < BatchSize ? count - start : static_cast<size_t>(BatchSize);
+            size_t depth = 0;
+            for (const auto& ins : m_code)
+            {
+                switch (ins.code)
+                {
+                case LoadField:
+                    if (ins.isReal) LoadColumn(*columns[ins.operand], start, n, stack[depth].reals.data());
+                    else LoadColumn(*columns[ins.operand], start, n, stack[depth].ints.data());
+                    ++depth;
+                    break;
+                case LoadConst:
+                    if (ins.isReal) std::fill(stack[depth].reals.begin(), stack[depth].reals.begin() + n, ins.realValue);
+                    else std::fill(stack[depth].ints.begin(), stack[depth].ints.begin() + n, ins.intValue);
+                    ++depth;
+                    break;
+                case ToReal:
+                {
+                    Slot& slot = stack[depth - ins.operand];
+                    for (size_t i = 0; i < n; ++i) slot.reals[i] = static_cast<double>(slot.ints[i]);
+                    break;
+                }
+                case Neg:
+                    if (ins.isReal) for (size_t i = 0; i < n; ++i) stack[depth - 1].reals[i] = -stack[depth - 1].reals[i];
+                    else for (size_t i = 0; i < n; ++i) stack[depth - 1].ints[i] = static_cast<int64_t>(0 - static_cast<uint64_t>(stack[depth - 1].ints[i]));
+                    break;
+                case BitNot:
+                    for (size_t i = 0; i < n; ++i) stack[depth - 1].ints[i] = ~stack[depth - 1].ints[i];
+                    break;
+                default:
+                    if (ins.isReal) realOp(ins.code, stack[depth - 2].reals.data(), stack[depth - 1].reals.data(), n);
+                    else integerOp(ins.code, stack[depth - 2].ints.data(), stack[depth - 1].ints.data(), n);
+                    --depth;
+                    break;
+                }
+            }
+
+            const Slot& result = stack[0];
+            if (ints)
+            {
+                std::copy(result.ints.begin(), result.ints.begin() + n, ints + start);
+            }
+            else if (m_isReal)
+            {
+                std::copy(result.reals.begin(), result.reals.begin() + n, reals + start);
+            }
+            else
+            {
+                for (size_t i = 0; i < n; ++i) reals[start + i] = static_cast<double>(result.ints[i]);
+            }
+        }
+    }
+
+    // --- Разбор выражения ---
+
+    static std::string trimmed(const std::string& text)
+    {
+        size_t start = text.find_first_not_of(" \t\n\r");
+        size_t end = text.find_last_not_of(" \t\n\r");
+        return start == std::string::npos ? std::string() : text.substr(start, end - start + 1);
+    }
+
+    void skipSpaces()
+    {
+        while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos]))) ++m_pos;
+    }
+
+    bool accept(const char* token)
+    {
+        skipSpaces();
+        size_t length = std::strlen(token);
+        if (m_text.compare(m_pos, length, token) == 0)
+        {
+            m_pos += length;
+            return true;
+        }
+        return false;
+    }
+
+    void emit(OpCode code, bool isReal, size_t operand = 0, int64_t intValue = 0, double realValue = 0)
+    {
+        Instruction ins = { code, isReal, operand, intValue, realValue };
+        m_code.push_back(ins);
+        if (code == LoadField || code == LoadConst)
+        {
+            if (++m_depth > m_maxDepth) m_maxDepth = m_depth;
+        }
+        else if (code != ToReal && code != Neg && code != BitNot)
+        {
+            --m_depth;
+        }
+    }
+
+    // Бинарная операция: целый операнд рядом с дробным приводится к double
+    bool emitBinary(OpCode code, bool leftReal, bool rightReal)
+    {
+        bool isReal = leftReal || rightReal;
+        if (isReal && code >= Shl)
+        {
+            throw std::invalid_argument("Bitwise operation on floating point value in expression: " + m_text);
+        }
+        if (isReal && !leftReal) emit(ToReal, true, 2);
+        if (isReal && !rightReal) emit(ToReal, true, 1);
+        emit(code, isReal);
+        return isReal;
+    }
+
+    bool parseOr()
+    {
+        bool type = parseXor();
+        while (accept("|"))
+        {
+            type = emitBinary(BitOr, type, parseXor());
+        }
+        return type;
+    }
+
+    bool parseXor()
+    {
+        bool type = parseAnd();
+        while (accept("^"))
+        {
+            type = emitBinary(BitXor, type, parseAnd());
+        }
+        return type;
+    }
+
+    bool parseAnd()
+    {
+        bool type = parseShift();
+        while (accept("&"))
+        {
+            type = emitBinary(BitAnd, type, parseShift());
+        }
+        return type;
+    }
+
+    bool parseShift()
+    {
+        bool type = parseSum();
+        for (;;)
+        {
+            if (accept("<<")) type = emitBinary(Shl, type, parseSum());
+            else if (accept(">>")) type = emitBinary(Shr, type, parseSum());
+            else return type;
+        }
+    }
+
+    bool parseSum()
+    {
+        bool type = parseProduct();
+        for (;;)
+        {
+            if (accept("+")) type = emitBinary(Add, type, parseProduct());
+            else if (accept("-")) type = emitBinary(Sub, type, parseProduct());
+            else return type;
+        }
+    }
+
+    bool parseProduct()
+    {
+        bool type = parseUnary();
+        for (;;)
+        {
+            if (accept("*")) type = emitBinary(Mul, type, parseUnary());
+            else if (accept("/")) type = emitBinary(Div, type, parseUnary());
+            else if (accept("%")) type = emitBinary(Mod, type, parseUnary());
+            else return type;
+        }
+    }
+
+    bool parseUnary()
+    {
+        if (accept("-"))
+        {
+            bool type = parseUnary();
+            emit(Neg, type);
+            return type;
+        }
+        if (accept("~"))
+        {
+            if (parseUnary())
+            {
+                throw std::invalid_argument("Bitwise operation on floating point value in expression: " + m_text);
+            }
+            emit(BitNot, false);
+            return false;
+        }
+        if (accept("+"))
+        {
+            return parseUnary();
+        }
+        return parsePrimary();
+    }
+
+    bool parsePrimary()
+    {
+        if (accept("("))
+        {
+            bool type = parseOr();
+            if (!accept(")"))
+            {
+                throw std::invalid_argument("Expected ')' in expression at position " + std::to_string(m_pos));
+            }
+            return type;
+        }
+
+        skipSpaces();
+        size_t start = m_pos;
+        while (m_pos < m_text.size() &&
+               (std::isalnum(static_cast<unsigned char>(m_text[m_pos])) || m_text[m_pos] == '_' || m_text[m_pos] == '.'))
+        {
+            ++m_pos;
+            // Знак порядка в дробной константе вида 1e-3
+            bool isDecimal = std::isdigit(static_cast<unsigned char>(m_text[start])) && m_text.compare(start, 2, "0x") != 0;
+            if (isDecimal && m_pos + 1 < m_text.size() && (m_text[m_pos - 1] == 'e' || m_text[m_pos - 1] == 'E') &&
+                (m_text[m_pos] == '-' || m_text[m_pos] == '+'))
+            {
+                ++m_pos;
+            }
+        }
+        std::string token = m_text.substr(start, m_pos - start);
+        if (token.empty())
+        {
+            throw std::invalid_argument("Expected operand in expression at position " + std::to_string(m_pos));
+        }
+
+        if (std::isdigit(static_cast<unsigned char>(token[0])) || token[0] == '.')
+        {
+            char* end = nullptr;
+            bool isHex = token.size() > 1 && (token[1] == 'x' || token[1] == 'X');
+            if (!isHex && token.find_first_of(".eE") != std::string::npos)
+            {
+                double value = std::strtod(token.c_str(), &end);
+                if (*end) throw std::invalid_argument("Invalid number in expression: " + token);
+                emit(LoadConst, true, 0, 0, value);
+                return true;
+            }
+            // Десятичная константа или шестнадцатеричная с префиксом 0x ("010" - это 10)
+            int64_t value = static_cast<int64_t>(std::strtoull(token.c_str(), &end, isHex ? 16 : 10));
+            if (*end) throw std::invalid_argument("Invalid number in expression: " + token);
+            emit(LoadConst, false, 0, value);
+            return false;
+        }
+
+        int index = m_layout.indexOf(token);
+        size_t dot = token.rfind('.');
+        if (index < 0 && dot != std::string::npos)
+        {
+            index = m_layout.indexOf(token.substr(dot + 1));
+        }
+        if (index < 0)
+        {
+            throw std::invalid_argument("Field not found: " + token);
+        }
+        size_t slot = std::find(m_fields.begin(), m_fields.end(), static_cast<size_t>(index)) - m_fields.begin();
+        if (slot == m_fields.size())
+        {
+            m_fields.push_back(static_cast<size_t>(index));
+        }
+        StructLayout::ValueKind kind = m_layout.field(index).kind;
+        bool isReal = kind == StructLayout::FloatValue || kind == StructLayout::DoubleValue;
+        emit(LoadField, isReal, slot);
+        return isReal;
+    }
+
+    const StructLayout& m_layout;
+    std::string m_text;
+    std::string m_name;
+    size_t m_pos;
+    size_t m_depth;
+    size_t m_maxDepth;
+    bool m_isReal;
+    std::vector<size_t> m_fields;
+    std::vector<Instruction> m_code;
+};
+
+#endif // STRUCTEXPR_H
@@ -0,0 +1,542 @@
+#ifndef STRUCTFILTER_H
+#define STRUCTFILTER_H
+
+#include "struct_layout.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <stdexcept>
+
+inline int BitCount(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(word);
+#else
+    int count = 0;
+    for (; word; word &= word - 1) ++count;
+    return count;
+#endif
+}
+
+inline int LowestBit(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    int index = 0;
+    while (!(word & 1)) { word >>= 1; ++index; }
+    return index;
+#endif
+}
+
+// Перевод битовой карты в вектор индексов выбранных записей
+inline void BitmapToIndices(const uint64_t* bitmap, size_t count, std::vector<size_t>& indices)
+{
+    indices.clear();
+    size_t words = (count + 63) / 64;
+    for (size_t w = 0; w < words; ++w)
+    {
+        for (uint64_t word = bitmap[w]; word; word &= word - 1)
+        {
+            indices.push_back(w * 64 + LowestBit(word));
+        }
+    }
+}
+
+// Фильтр записей по выражению над полями layout, например "urgent == 1 && len > 512".
+// Поддерживаются ==, !=, <, <=, >, >=, &&, ||, ! и скобки; в сравнении слева поле, справа
+// константа (или наоборот). Имя вида "flags.urgent" ищется целиком, затем по последней части.
+// Выражение компилируется один раз в постфиксную программу, которая выполняется
+// пакетами: каждое сравнение дает битовую карту пакета, логические операции
+// работают над словами карт по 64 записи сразу.
+class RecordFilter
+{
+public:
+    RecordFilter(const StructLayout& layout, const std::string& expression)
+        : m_layout(layout), m_text(expression), m_pos(0), m_depth(0), m_maxDepth(0)
+    {
+        parseOr();
+        skipSpaces();
+        if (m_pos != m_text.size())
+        {
+            throw std::invalid_argument("Unexpected text in filter: " + m_text.substr(m_pos));
+        }
+    }
+
+    // Битовая карта: бит i установлен, если запись i подходит
+    void selectBitmap(const char* records, size_t count, std::vector<uint64_t>& bitmap) const
+    {
+        bitmap.assign((count + 63) / 64, 0);
+        std::vector<uint64_t> stack(m_maxDepth * BatchWords);
+        size_t recordSize = m_layout.size();
+        for (size_t start = 0; start < count; start += BatchRecords)
+        {
+            size_t n = count - start < BatchRecords ? count - start : static_cast<size_t>(BatchRecords);
+            size_t words = (n + 63) / 64;
+            size_t depth = 0;
+            for (const auto& op : m_program)
+            {
+                uint64_t* top = stack.data() + depth * BatchWords;
+                switch (op.code)
+                {
+                case Compare:
+                    evaluate(op, records + start * recordSize, recordSize, n, top);
+                    ++depth;
+                    break;
+                case ConstTrue:
+                case ConstFalse:
+                    for (size_t w = 0; w < words; ++w) top[w] = op.code == ConstTrue ? ~0ULL : 0;
+                    ++depth;
+                    break;
+                case And:
+                case Or:
+                {
+                    // Два верхних значения стека заменяются результатом
+                    uint64_t* a = top - 2 * BatchWords;
+                    const uint64_t* b = top - BatchWords;
+                    if (op.code == And) for (size_t w = 0; w < words; ++w) a[w] &= b[w];
+                    else for (size_t w = 0; w < words; ++w) a[w] |= b[w];
+                    --depth;
+                    break;
+                }
+                case Not:
+                {
+                    uint64_t* a = top - BatchWords;
+                    for (size_t w = 0; w < words; ++w) a[w] = ~a[w];
+                    break;
+                }
+                }
+            }
+            if (n % 64)
+            {
+                stack[words - 1] &= (1ULL << (n % 64)) - 1;
+            }
+            std::memcpy(bitmap.data() + start / 64, stack.data(), words * sizeof(uint64_t));
+        }
+    }
+
+    // Вектор индексов подходящих записей
+    void selectIndices(const char* records, size_t count, std::vector<size_t>& indices) const
+    {
+        std::vector<uint64_t> bitmap;
+        selectBitmap(records, count, bitmap);
+        BitmapToIndices(bitmap.data(), count, indices);
+    }
+
+    size_t countMatches(const char* records, size_t count) const
+    {
+        std::vector<uint64_t> bitmap;
+        selectBitmap(records, count, bitmap);
+        size_t result = 0;
+        for (uint64_t word : bitmap) result += BitCount(word);
+        return result;
+    }
+
+private:
+    enum { BatchWords = 64, BatchRecords = BatchWords * 64 };
+    enum OpCode { Compare, ConstTrue, ConstFalse, And, Or, Not };
+    enum CompareOp { Eq, Ne, Lt, Le, Gt, Ge };
+
+    struct Op
+    {
+        OpCode code;
+        CompareOp cmp;
+        size_t offset;      // смещение контейнера в записи
+        size_t size;        // размер контейнера
+        bool isFloat;
+        uint64_t mask;      // маска поля на своем месте в контейнере
+        uint64_t flip;      // бит знака на своем месте (знаковые поля сравниваются со смещением)
+        uint64_t key;       // константа, приведенная к виду контейнера
+        double floatKey;
+    };
+
+    // Сравнение без извлечения поля: в контейнере маскируются чужие биты,
+    // у знаковых полей инвертируется бит знака, и результат сравнивается с
+    // заранее сдвинутой константой - порядок при этом совпадает с порядком значений поля
+    template<typename U, typename Cmp>
+    static void compareKernel(const char* base, size_t stride, size_t count,
+                              U mask, U flip, U key, Cmp cmp, uint64_t* bits)
+    {
+        for (size_t w = 0; w * 64 < count; ++w)
+        {
+            size_t n = count - w * 64 < 64 ? count - w * 64 : 64;
+            const char* p = base + w * 64 * stride;
+            uint64_t word = 0;
+            for (size_t j = 0; j < n; ++j)
+            {
+                U value;
+                std::memcpy(&value, p + j * stride, sizeof(U));
+                value = static_cast<U>((value & mask) ^ flip);
+                word |= static_cast<uint64_t>(cmp(value, key)) << j;
+            }
+            bits[w] = word;
+        }
+    }
+
+    template<typename T>
+    struct Less { bool operator()(T a, T b) const { return a < b; } };
+    template<typename T>
+    struct LessEqual { bool operator()(T a, T b) const { return a <= b; } };
+    template<typename T>
+    struct Greater { bool operator()(T a, T b) const { return a > b; } };
+    template<typename T>
+    struct GreaterEqual { bool operator()(T a, T b) const { return a >= b; } };
+    template<typename T>
+    struct Equal { bool operator()(T a, T b) const { return a == b; } };
+    template<typename T>
+    struct NotEqual { bool operator()(T a, T b) const { return a != b; } };
+
+    template<typename U>
+    static void dispatchCompare(const Op& op, const char* base, size_t stride, size_t count, uint64_t* bits)
+    {
+        U mask = static_cast<U>(op.mask), flip = static_cast<U>(op.flip), key = static_cast<U>(op.key);
+        switch (op.cmp)
+        {
+        case Eq: compareKernel(base, stride, count, mask, flip, key, Equal<U>(), bits); break;
+        case Ne: compareKernel(base, stride, count, mask, flip, key, NotEqual<U>(), bits); break;
+        case Lt: compareKernel(base, stride, count, mask, flip, key, Less<U>(), bits); break;
+        case Le: compareKernel(base, stride, count, mask, flip, key, LessEqual<U>(), bits); break;
+        case Gt: compareKernel(base, stride, count, mask, flip, key, Greater<U>(), bits); break;
+        case Ge: compareKernel(base, stride, count, mask, flip, key, GreaterEqual<U>(), bits); break;
+        }
+    }
+
+    template<typename F>
+    static void floatKernel(const Op& op, const char* base, size_t stride, size_t count, uint64_t* bits)
+    {
+        for (size_t w = 0; w * 64 < count; ++w)
+        {
+            size_t n = count - w * 64 < 64 ? count - w * 64 : 64;
+            uint64_t word = 0;
+            for (size_t j = 0; j < n; ++j)
+            {
+                F value;
+                std::memcpy(&value, base + (w * 64 + j) * stride, sizeof(F));
+                double v = value;
+                bool match;
+                switch (op.cmp)
+                {
+                case Eq: match = v == op.floatKey; break;
+                case Ne: match = v != op.floatKey; break;
+                case Lt: match = v < op.floatKey; break;
+                case Le: match = v <= op.floatKey; break;
+                case Gt: match = v > op.floatKey; break;
+                default: match = v >= op.floatKey; break;
+                }
+                word |= static_cast<uint64_t>(match) << j;
+            }
+            bits[w] = word;
+        }
+    }
+
+    void evaluate(const Op& op, const char* records, size_t stride, size_t count, uint64_t* bits) const
+    {
+        const char* base = records + op.offset;
+        if (op.isFloat)
+        {
+            if (op.size == sizeof(float)) floatKernel<float>(op, base, stride, count, bits);
+            else floatKernel<double>(op, base, stride, count, bits);
+            return;
+        }
+        switch (op.size)
+        {
+        case 1: dispatchCompare<uint8_t>(op, base, stride, count, bits); break;
+        case 2: dispatchCompare<uint16_t>(op, base, stride, count, bits); break;
+        case 4: dispatchCompare<uint32_t>(op, base, stride, count, bits); break;
+        default: dispatchCompare<uint64_t>(op, base, stride, count, bits); break;
+        }
+    }
+
+    void emit(const Op& op)
+    {
+        m_program.push_back(op);
+        if (op.code == Compare || op.code == ConstTrue || op.code == ConstFalse)
+        {
+            if (++m_depth > m_maxDepth) m_maxDepth = m_depth;
+        }
+        else if (op.code != Not)
+        {
+            --m_depth;
+        }
+    }
+
+    void emitCode(OpCode code)
+    {
+        Op op = Op();
+        op.code = code;
+        emit(op);
+    }
+
+    void skipSpaces()
+    {
+        while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos]))) ++m_pos;
+    }
+
+    bool accept(const char* token)
+    {
+        skipSpaces();
+        size_t length = std::strlen(token);
+        if (m_text.compare(m_pos, length, token) == 0)
+        {
+            m_pos += length;
+            return true;
+        }
+        return false;
+    }
+
+    void parseOr()
+    {
+        parseAnd();
+        while (accept("||"))
+        {
+            parseAnd();
+            emitCode(Or);
+        }
+    }
+
+    void parseAnd()
+    {
+        parseUnary();
+        while (accept("&&"))
+        {
+            parseUnary();
+            emitCode(And);
+        }
+    }
+
+    void parseUnary()
+    {
+        if (accept("!"))
+        {
+            parseUnary();
+            emitCode(Not);
+            return;
+        }
+        if (accept("("))
+        {
+            parseOr();
+            if (!accept(")"))
+            {
+                throw std::invalid_argument("Expected ')' in filter at position " + std::to_string(m_pos));
+            }
+            return;
+        }
+        parseComparison();
+    }
+
+    bool parseName(std::string& name)
+    {
+        skipSpaces();
+        size_t start = m_pos;
+        while (m_pos < m_text.size() &&
+               (std::isalnum(static_cast<unsigned char>(m_text[m_pos])) || m_text[m_pos] == '_' || m_text[m_pos] == '.'))
+        {
+            ++m_pos;
+        }
+        name = m_text.substr(start, m_pos - start);
+        if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])))
+        {
+            m_pos = start;
+            return false;
+        }
+        return true;
+    }
+
+    std::string parseNumber()
+    {
+        skipSpaces();
+        size_t start = m_pos;
+        if (m_pos < m_text.size() && (m_text[m_pos] == '-' || m_text[m_pos] == '+')) ++m_pos;
+        while (m_pos < m_text.size() &&
+               (std::isalnum(static_cast<unsigned char>(m_text[m_pos])) || m_text[m_pos] == '.' ||
+                ((m_text[m_pos] == '-' || m_text[m_pos] == '+') && (m_text[m_pos - 1] == 'e' || m_text[m_pos - 1] == 'E'))))
+        {
+            ++m_pos;
+        }
+        if (start == m_pos)
+        {
+            throw std::invalid_argument("Expected number in filter at position " + std::to_string(m_pos));
+        }
+        return m_text.substr(start, m_pos - start);
+    }
+
+    CompareOp parseOperator()
+    {
+        if (accept("==")) return Eq;
+        if (accept("!=")) return Ne;
+        if (accept("<=")) return Le;
+        if (accept(">=")) return Ge;
+        if (accept("<")) return Lt;
+        if (accept(">")) return Gt;
+        throw std::invalid_argument("Expected comparison in filter at position " + std::to_string(m_pos));
+    }
+
+    static CompareOp mirror(CompareOp op)
+    {
+        switch (op)
+        {
+        case Lt: return Gt;
+        case Le: return Ge;
+        case Gt: return Lt;
+        case Ge: return Le;
+        default: return op;
+        }
+    }
+
+    size_t resolveField(const std::string& name) const
+    {
+        int index = m_layout.indexOf(name);
+        size_t dot = name.rfind('.');
+        if (index < 0 && dot != std::string::npos)
+        {
+            index = m_layout.indexOf(name.substr(dot + 1));
+        }
+        if (index < 0)
+        {
+            throw std::invalid_argument("Field not found: " + name);
+        }
+        return static_cast<size_t>(index);
+    }
+
+    void parseComparison()
+    {
+        std::string name, number;
+        CompareOp cmp;
+        if (parseName(name))
+        {
+            cmp = parseOperator();
+            number = parseNumber();
+        }
+        else
+        {
+            number = parseNumber();
+            cmp = mirror(parseOperator());
+            if (!parseName(name))
+            {
+                throw std::invalid_argument("Expected field name in filter at position " + std::to_string(m_pos));
+            }
+        }
+        compileComparison(m_layout.field(resolveField(name)), cmp, number);
+    }
+
+    void compileComparison(const StructLayout::Field& field, CompareOp cmp, const std::string& number)
+    {
+        Op op = Op();
+        op.code = Compare;
+        op.cmp = cmp;
+        op.offset = field.byteOffset;
+        op.size = field.size;
+
+        char* end = nullptr;
+        double asDouble = std::strtod(number.c_str(), &end);
+        if (*end)
+        {
+            throw std::invalid_argument("Invalid number in filter: " + number);
+        }
+        if (field.kind == StructLayout::FloatValue || field.kind == StructLayout::DoubleValue)
+        {
+            op.isFloat = true;
+            op.floatKey = asDouble;
+            emit(op);
+            return;
+        }
+
+        // Целые константы разбираются точно, дробные приводятся к целой границе
+        // по смыслу сравнения (x < 2.5 то же, что x < 3)
+        bool isSigned = field.kind == StructLayout::SignedValue;
+        bool isNegative = false;
+        uint64_t key = 0;
+        errno = 0;
+        if (number.find_first_of(".eE") == std::string::npos || number.find_first_of("xX") != std::string::npos)
+        {
+            // Десятичные константы или шестнадцатеричные с префиксом 0x; ведущий ноль
+            // не делает число восьмеричным ("010" - это 10)
+            isNegative = number[0] == '-';
+            const char* digits = number.c_str() + (isNegative || number[0] == '+' ? 1 : 0);
+            int base = digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X') ? 16 : 10;
+            key = isNegative ? static_cast<uint64_t>(std::strtoll(number.c_str(), &end, base))
+                             : std::strtoull(number.c_str(), &end, base);
+            if (*end)
+            {
+                throw std::invalid_argument("Invalid number in filter: " + number);
+            }
+            if (errno == ERANGE)
+            {
+                emitCode(constantResult(cmp, isNegative));
+                return;
+            }
+        }
+        else
+        {
+            double rounded = (cmp == Lt || cmp == Ge) ? std::ceil(asDouble) : std::floor(asDouble);
+            if (rounded != asDouble && (cmp == Eq || cmp == Ne))
+            {
+                emitCode(cmp == Eq ? ConstFalse : ConstTrue);
+                return;
+            }
+            if (rounded < -std::ldexp(1.0, 63) || rounded >= std::ldexp(1.0, 64))
+            {
+                emitCode(constantResult(cmp, rounded < 0));
+                return;
+            }
+            isNegative = rounded < 0;
+            key = isNegative ? static_cast<uint64_t>(static_cast<int64_t>(rounded))
+                             : static_cast<uint64_t>(rounded);
+        }
+
+        // Константа вне диапазона значений поля: результат известен заранее
+        uint64_t high = isSigned ? field.mask >> 1 : field.mask;
+        if (isNegative)
+        {
+            int64_t low = isSigned ? -static_cast<int64_t>(high) - 1 : 0;
+            if (static_cast<int64_t>(key) < low)
+            {
+                emitCode(constantResult(cmp, true));
+                return;
+            }
+        }
+        else if (key > high)
+        {
+            emitCode(constantResult(cmp, false));
+            return;
+        }
+        compileInteger(op, field, key, isSigned);
+    }
+
+    // Результат сравнения поля с константой, лежащей ниже (below) или выше всех его значений
+    static OpCode constantResult(CompareOp cmp, bool below)
+    {
+        switch (cmp)
+        {
+        case Eq: return ConstFalse;
+        case Ne: return ConstTrue;
+        case Lt: case Le: return below ? ConstFalse : ConstTrue;
+        default: return below ? ConstTrue : ConstFalse;
+        }
+    }
+
+    void compileInteger(Op& op, const StructLayout::Field& field, uint64_t key, bool isSigned)
+    {
+        uint64_t sign = isSigned ? 1ULL << (field.bitWidth - 1) : 0;
+        op.isFloat = false;
+        op.mask = field.mask << field.bitOffset;
+        op.flip = sign << field.bitOffset;
+        op.key = ((key ^ sign) & field.mask) << field.bitOffset;
+        emit(op);
+    }
+
+    const StructLayout& m_layout;
+    std::string m_text;
+    size_t m_pos;
+    size_t m_depth;
+    size_t m_maxDepth;
+    std::vector<Op> m_program;
+};
+
+#endif // STRUCTFILTER_H
@@ -0,0 +1,362 @@
+#ifndef STRUCTGROUPBY_H
+#define STRUCTGROUPBY_H
+
+#include "struct_aggregate.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+// Сложение сумм группы; int64_t складывается по модулю 2^64, как intSum
+// в struct_aggregate.h, чтобы переполнение не было неопределенным поведением
+inline double GroupSumAdd(double a, double b) { return a + b; }
+inline uint64_t GroupSumAdd(uint64_t a, uint64_t b) { return a + b; }
+inline int64_t GroupSumAdd(int64_t a, int64_t b)
+{
+    return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+
+// Накопитель одной группы
+template<typename V>
+struct GroupAccumulator
+{
+    uint64_t count;
+    V sum;
+    V min;
+    V max;
+
+    GroupAccumulator()
+        : count(0), sum(0), min(std::numeric_limits<V>::max()), max(std::numeric_limits<V>::lowest()) {}
+
+    void add(V value)
+    {
+        ++count;
+        sum = GroupSumAdd(sum, value);
+        min = value < min ? value : min;
+        max = value > max ? value : max;
+    }
+
+    void merge(const GroupAccumulator& other)
+    {
+        count += other.count;
+        sum = GroupSumAdd(sum, other.sum);
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
+// Таблица групп по составному ключу до 64 бит.
+// Узкие ключи (до DenseBits бит) индексируют массив накопителей напрямую,
+// широкие - открытая адресация с линейным пробированием, ключ и накопитель
+// лежат в одной ячейке, поэтому поиск обычно укладывается в одну строку кэша
+template<typename V>
+class GroupTable
+{
+public:
+    enum { DenseBits = 16 };
+
+    explicit GroupTable(int keyBits) : m_dense(keyBits <= DenseBits), m_used(0)
+    {
+        if (m_dense)
+        {
+            m_slots.resize(static_cast<size_t>(1) << keyBits);
+            for (size_t i = 0; i < m_slots.size(); ++i) m_slots[i].key = i;
+        }
+        else
+        {
+            m_slots.resize(1024);
+        }
+    }
+
+    void add(uint64_t key, V value)
+    {
+        slot(key).acc.add(value);
+    }
+
+    void merge(const GroupTable& other)
+    {
+        for (const auto& s : other.m_slots)
+        {
+            if (s.acc.count) slot(s.key).acc.merge(s.acc);
+        }
+    }
+
+    template<typename F>
+    void forEach(F visit) const
+    {
+        for (const auto& s : m_slots)
+        {
+            if (s.acc.count) visit(s.key, s.acc);
+        }
+    }
+
+private:
+    struct Slot
+    {
+        uint64_t key;
+        GroupAccumulator<V> acc;    // count == 0 - ячейка свободна
+    };
+
+    Slot& slot(uint64_t key)
+    {
+        if (m_dense)
+        {
+            return m_slots[static_cast<size_t>(key)];
+        }
+        size_t mask = m_slots.size() - 1;
+        for (size_t i = static_cast<size_t>(MixBits(key)) & mask; ; i = (i + 1) & mask)
+        {
+            Slot& s = m_slots[i];
+            if (s.acc.count && s.key == key) return s;
+            if (!s.acc.count)
+            {
+                // Заполнение не выше 1/2, иначе растут цепочки пробирования
+                if (2 * (m_used + 1) > m_slots.size())
+                {
+                    grow();
+                    return slot(key);
+                }
+                ++m_used;
+                s.key = key;
+                return s;
+            }
+        }
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old(m_slots.size() * 2);
+        old.swap(m_slots);
+        size_t mask = m_slots.size() - 1;
+        for (const auto& s : old)
+        {
+            if (!s.acc.count) continue;
+            size_t i = static_cast<size_t>(MixBits(s.key)) & mask;
+            while (m_slots[i].acc.count) i = (i + 1) & mask;
+            m_slots[i] = s;
+        }
+    }
+
+    bool m_dense;
+    size_t m_used;
+    std::vector<Slot> m_slots;
+};
+
+// Группировка записей по полям-ключам (целые и битовые поля, суммарно до 64 бит)
+// с подсчетом count/sum/min/max значения одного поля.
+// Каждый поток считает свою таблицу, в конце add() таблицы сливаются
+class GroupBy
+{
+public:
+    struct Group
+    {
+        std::vector<int64_t> key;   // значения полей-ключей в порядке их перечисления
+        uint64_t count;
+        int64_t intSum;             // для целого поля значения
+        int64_t intMin;             // для знакового поля значения
+        int64_t intMax;
+        uint64_t uintMin;           // для беззнакового поля значения
+        uint64_t uintMax;
+        double realSum;             // для float/double поля значения
+        double realMin;
+        double realMax;
+    };
+
+    // valueField может быть пустым - тогда считается только count
+    GroupBy(const StructLayout& layout, const std::vector<std::string>& keyFields,
+            const std::string& valueField, unsigned threads = 0)
+        : m_layout(layout),
+          m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+          m_keyBits(0),
+          m_hasValue(!valueField.empty()),
+          m_isReal(false),
+          m_isUnsigned(false)
+    {
+        for (const auto& name : keyFields)
+        {
+            size_t index = layout.fieldIndex(name);
+            const StructLayout::Field& field = layout.field(index);
+            if (field.kind == StructLayout::FloatValue || field.kind == StructLayout::DoubleValue)
+            {
+                throw std::invalid_argument("Floating point group key: " + name);
+            }
+            m_keyFields.push_back(index);
+            m_keyBits += field.bitWidth;
+        }
+        if (m_keyFields.empty() || m_keyBits > 64)
+        {
+            throw std::invalid_argument("Group key must be 1..64 bits wide");
+        }
+        m_columns = m_keyFields;
+        if (m_hasValue)
+        {
+            size_t index = layout.fieldIndex(valueField);
+            StructLayout::ValueKind kind = layout.field(index).kind;
+            m_isReal = kind == StructLayout::FloatValue || kind == StructLayout::DoubleValue;
+            m_isUnsigned = kind == StructLayout::UnsignedValue;
+            m_columns.push_back(index);
+        }
+        // Беззнаковые значения накапливаются как uint64_t: иначе значения от 2^63 становятся отрицательными
+        if (m_isReal) m_realTable.reset(new GroupTable<double>(m_keyBits));
+        else if (m_isUnsigned) m_uintTable.reset(new GroupTable<uint64_t>(m_keyBits));
+        else m_intTable.reset(new GroupTable<int64_t>(m_keyBits));
+    }
+
+    void add(const char* records, size_t count)
+    {
+        if (m_isReal) addTo(records, count, *m_realTable);
+        else if (m_isUnsigned) addTo(records, count, *m_uintTable);
+        else addTo(records, count, *m_intTable);
+    }
+
+    std::vector<Group> groups() const
+    {
+        std::vector<Group> result;
+        if (m_isReal)
+        {
+            m_realTable->forEach([&](uint64_t key, const GroupAccumulator<double>& acc)
+            {
+                Group group = makeGroup(key, acc.count);
+                group.realSum = acc.sum;
+                group.realMin = acc.min;
+                group.realMax = acc.max;
+                result.push_back(group);
+            });
+        }
+        else if (m_isUnsigned)
+        {
+            m_uintTable->forEach([&](uint64_t key, const GroupAccumulator<uint64_t>& acc)
+            {
+                Group group = makeGroup(key, acc.count);
+                group.intSum = static_cast<int64_t>(acc.sum);
+                group.uintMin = acc.min;
+                group.uintMax = acc.max;
+                result.push_back(group);
+            });
+        }
+        else
+        {
+            m_intTable->forEach([&](uint64_t key, const GroupAccumulator<int64_t>& acc)
+            {
+                Group group = makeGroup(key, acc.count);
+                group.intSum = acc.sum;
+                group.intMin = acc.min;
+                group.intMax = acc.max;
+                result.push_back(group);
+            });
+        }
+        return result;
+    }
+
+private:
+    enum { BlockRecords = 4096, MinRecordsPerThread = 1 << 16 };
+
+    Group makeGroup(uint64_t key, uint64_t count) const
+    {
+        Group group = Group();
+        group.count = count;
+        group.key.resize(m_keyFields.size());
+        for (size_t k = m_keyFields.size(); k-- > 0;)
+        {
+            const StructLayout::Field& field = m_layout.field(m_keyFields[k]);
+            uint64_t bits = key & field.mask;
+            group.key[k] = field.kind == StructLayout::SignedValue ? StructLayout::signExtend(bits, field.bitWidth)
+                                                                   : static_cast<int64_t>(bits);
+            key = field.bitWidth >= 64 ? 0 : key >> field.bitWidth;
+        }
+        return group;
+    }
+
+    template<typename V>
+    void addTo(const char* records, size_t count, GroupTable<V>& table) const
+    {
+        size_t threads = std::min<size_t>(m_threads, (count + MinRecordsPerThread - 1) / MinRecordsPerThread);
+        if (threads <= 1)
+        {
+            accumulate(records, count, table);
+            return;
+        }
+
+        std::vector<GroupTable<V> > partials(threads, GroupTable<V>(m_keyBits));
+        std::vector<std::thread> workers;
+        size_t chunk = (count + threads - 1) / threads;
+        for (size_t t = 0; t < threads; ++t)
+        {
+            size_t start = t * chunk;
+            size_t n = std::min(chunk, count - start);
+            workers.emplace_back([this, records, start, n, &partials, t]()
+            {
+                accumulate(records + start * m_layout.size(), n, partials[t]);
+            });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        for (const auto& partial : partials)
+        {
+            table.merge(partial);
+        }
+    }
+
+    // Ключи блока собираются в массив отдельным проходом (склейка бит полей),
+    // затем значения раскладываются по таблице
+    template<typename V>
+    void accumulate(const char* records, size_t count, GroupTable<V>& table) const
+    {
+        ColumnSet block;
+        std::vector<int64_t> parts(BlockRecords);
+        std::vector<uint64_t> keys(BlockRecords);
+        std::vector<V> values(BlockRecords, V(0));
+        for (size_t start = 0; start < count; start += BlockRecords)
+        {
+            size_t n = std::min<size_t>(BlockRecords, count - start);
+            const char* src = records + start * m_layout.size();
+            block.reset(m_layout, m_columns, n);
+            for (size_t c = 0; c < m_columns.size(); ++c)
+            {
+                ExtractField(m_layout.field(m_columns[c]), src, m_layout.size(), n, block.column(c).bytes.data());
+            }
+
+            std::fill(keys.begin(), keys.begin() + n, 0);
+            for (size_t k = 0; k < m_keyFields.size(); ++k)
+            {
+                const StructLayout::Field& field = m_layout.field(m_keyFields[k]);
+                LoadColumn(block.column(k), 0, n, parts.data());
+                int shift = field.bitWidth >= 64 ? 0 : field.bitWidth;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    keys[i] = (shift ? keys[i] << shift : 0) | (static_cast<uint64_t>(parts[i]) & field.mask);
+                }
+            }
+
+            if (m_hasValue)
+            {
+                LoadColumn(block.column(m_keyFields.size()), 0, n, values.data());
+            }
+            for (size_t i = 0; i < n; ++i)
+            {
+                table.add(keys[i], values[i]);
+            }
+        }
+    }
+
+    const StructLayout& m_layout;
+    unsigned m_threads;
+    int m_keyBits;
+    bool m_hasValue;
+    bool m_isReal;
+    bool m_isUnsigned;
+    std::vector<size_t> m_keyFields;
+    std::vector<size_t> m_columns;
+    std::unique_ptr<GroupTable<int64_t> > m_intTable;
+    std::unique_ptr<GroupTable<uint64_t> > m_uintTable;
+    std::unique_ptr<GroupTable<double> > m_realTable;
+};
+
+#endif // STRUCTGROUPBY_H
@@ -0,0 +1,230 @@
+#ifndef STRUCTHASH_H
+#define STRUCTHASH_H
+
+#include "struct_aggregate.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+// Хеш и сравнение записей целиком с учетом только значимых бит (valueMask):
+// мусор в выравнивании и свободных битах контейнеров не влияет на результат.
+// Запись читается 8-байтовыми словами под маской; пары слов смешиваются
+// 128-битным умножением с секретом, как в xxh3
+class RecordHasher
+{
+public:
+    explicit RecordHasher(const StructLayout& layout, uint64_t seed = 0)
+        : m_size(layout.size()), m_full(layout.size() / 8), m_seed(seed)
+    {
+        size_t words = (layout.size() + 7) / 8;
+        std::vector<unsigned char> bytes = layout.valueMask();
+        bytes.resize(words * 8, 0);
+        m_mask.resize(words);
+        std::memcpy(m_mask.data(), bytes.data(), bytes.size());
+        // Секрет на каждое слово плюс одно для непарного последнего
+        for (size_t w = 0; w <= words; ++w) m_secret.push_back(MixBits(seed + (w + 1) * 0x9E3779B97F4A7C15ULL));
+    }
+
+    uint64_t hash(const char* record) const
+    {
+        size_t words = m_mask.size();
+        uint64_t acc = m_seed ^ (m_size * 0x9E3779B185EBCA87ULL);
+        size_t w = 0;
+        for (; w + 1 < words; w += 2)
+        {
+            acc += fold(word(record, w) ^ m_secret[w], word(record, w + 1) ^ m_secret[w + 1]);
+        }
+        if (w < words)
+        {
+            acc += fold(word(record, w) ^ m_secret[w], m_secret[words]);
+        }
+        acc ^= acc >> 37;
+        acc *= 0x165667919E3779F9ULL;
+        acc ^= acc >> 32;
+        return acc;
+    }
+
+    void hash(const char* records, size_t count, uint64_t* hashes) const
+    {
+        for (size_t i = 0; i < count; ++i) hashes[i] = hash(records + i * m_size);
+    }
+
+    bool equals(const char* a, const char* b) const
+    {
+        uint64_t difference = 0;
+        for (size_t w = 0; w < m_mask.size(); ++w) difference |= word(a, w) ^ word(b, w);
+        return difference == 0;
+    }
+
+private:
+    // Слово записи под маской; последнее неполное слово дополняется нулями
+    uint64_t word(const char* record, size_t w) const
+    {
+        uint64_t value = 0;
+        std::memcpy(&value, record + w * 8, w < m_full ? 8 : m_size - m_full * 8);
+        return value & m_mask[w];
+    }
+
+    static uint64_t fold(uint64_t a, uint64_t b)
+    {
+#if defined(__GNUC__) && defined(__SIZEOF_INT128__)
+        unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+        uint64_t aLow = a & 0xFFFFFFFF, aHigh = a >> 32, bLow = b & 0xFFFFFFFF, bHigh = b >> 32;
+        uint64_t low = aLow * bLow, middle1 = aHigh * bLow, middle2 = aLow * bHigh, high = aHigh * bHigh;
+        uint64_t cross = (low >> 32) + (middle1 & 0xFFFFFFFF) + middle2;
+        uint64_t lower = (cross << 32) | (low & 0xFFFFFFFF);
+        uint64_t upper = high + (middle1 >> 32) + (cross >> 32);
+        return lower ^ upper;
+#endif
+    }
+
+    size_t m_size;
+    size_t m_full;      // число полных 8-байтовых слов
+    uint64_t m_seed;
+    std::vector<uint64_t> m_mask;
+    std::vector<uint64_t> m_secret;
+};
+
+// Множество различных записей (ключ - запись целиком). Записи хранятся копиями
+// в плотном буфере в порядке первого появления и нумеруются строками
+class RecordHashSet
+{
+public:
+    explicit RecordHashSet(const StructLayout& layout)
+        : m_layout(layout), m_hasher(layout), m_slots(1024), m_count(0)
+    {
+    }
+
+    const StructLayout& layout() const { return m_layout; }
+    size_t size() const { return m_count; }
+    const char* record(size_t row) const { return m_records.data() + row * m_layout.size(); }
+    const std::vector<char>& records() const { return m_records; }
+
+    // Строка записи и признак того, что запись добавлена впервые
+    std::pair<size_t, bool> insert(const char* record)
+    {
+        uint64_t hash = m_hasher.hash(record);
+        size_t mask = m_slots.size() - 1;
+        for (size_t i = static_cast<size_t>(hash) & mask; ; i = (i + 1) & mask)
+        {
+            Slot& s = m_slots[i];
+            if (!s.row)
+            {
+                // Заполнение не выше 1/2, иначе растут цепочки пробирования
+                if (2 * (m_count + 1) > m_slots.size())
+                {
+                    grow();
+                    return insert(record);
+                }
+                s.hash = hash;
+                s.row = ++m_count;
+                m_records.insert(m_records.end(), record, record + m_layout.size());
+                return std::make_pair(m_count - 1, true);
+            }
+            if (s.hash == hash && m_hasher.equals(this->record(s.row - 1), record))
+            {
+                return std::make_pair(s.row - 1, false);
+            }
+        }
+    }
+
+    // Строка записи или -1, если такой записи нет
+    long long find(const char* record) const
+    {
+        uint64_t hash = m_hasher.hash(record);
+        size_t mask = m_slots.size() - 1;
+        for (size_t i = static_cast<size_t>(hash) & mask; ; i = (i + 1) & mask)
+        {
+            const Slot& s = m_slots[i];
+            if (!s.row) return -1;
+            if (s.hash == hash && m_hasher.equals(this->record(s.row - 1), record))
+            {
+                return static_cast<long long>(s.row - 1);
+            }
+        }
+    }
+
+    bool contains(const char* record) const { return find(record) >= 0; }
+
+    void clear()
+    {
+        m_slots.assign(1024, Slot());
+        m_records.clear();
+        m_count = 0;
+    }
+
+private:
+    struct Slot
+    {
+        Slot() : hash(0), row(0) {}
+        uint64_t hash;
+        size_t row;     // номер строки + 1, 0 - ячейка свободна
+    };
+
+    void grow()
+    {
+        std::vector<Slot> old(m_slots.size() * 2);
+        old.swap(m_slots);
+        size_t mask = m_slots.size() - 1;
+        for (const auto& s : old)
+        {
+            if (!s.row) continue;
+            size_t i = static_cast<size_t>(s.hash) & mask;
+            while (m_slots[i].row) i = (i + 1) & mask;
+            m_slots[i] = s;
+        }
+    }
+
+    const StructLayout& m_layout;
+    RecordHasher m_hasher;
+    std::vector<Slot> m_slots;
+    std::vector<char> m_records;
+    size_t m_count;
+};
+
+// Отображение запись -> значение поверх RecordHashSet
+template<typename V>
+class RecordHashMap
+{
+public:
+    explicit RecordHashMap(const StructLayout& layout) : m_keys(layout) {}
+
+    size_t size() const { return m_keys.size(); }
+    const char* key(size_t row) const { return m_keys.record(row); }
+    V& value(size_t row) { return m_values[row]; }
+    const V& value(size_t row) const { return m_values[row]; }
+
+    V& operator[](const char* record)
+    {
+        std::pair<size_t, bool> result = m_keys.insert(record);
+        if (result.second) m_values.push_back(V());
+        return m_values[result.first];
+    }
+
+    const V* find(const char* record) const
+    {
+        long long row = m_keys.find(record);
+        return row < 0 ? nullptr : &m_values[static_cast<size_t>(row)];
+    }
+
+private:
+    RecordHashSet m_keys;
+    std::vector<V> m_values;
+};
+
+// Удаление повторов: в out попадают различные записи в порядке первого появления,
+// возвращается их число
+inline size_t DeduplicateRecords(const StructLayout& layout, const char* records, size_t count, std::vector<char>& out)
+{
+    RecordHashSet set(layout);
+    for (size_t i = 0; i < count; ++i) set.insert(records + i * layout.size());
+    out = set.records();
+    return set.size();
+}
+
+#endif // STRUCTHASH_H
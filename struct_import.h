@@ -0,0 +1,403 @@
+#ifndef STRUCTIMPORT_H
+#define STRUCTIMPORT_H
+
+#include "struct_layout.h"
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+// Целое без знака из всей строки [begin, end); false - не число или переполнение
+inline bool ParseUnsigned(const char* begin, const char* end, uint64_t& value)
+{
+    if (begin == end) return false;
+    uint64_t result = 0;
+    for (const char* p = begin; p != end; ++p)
+    {
+        unsigned digit = static_cast<unsigned>(*p - '0');
+        if (digit > 9) return false;
+        if (result > (UINT64_MAX - digit) / 10) return false;
+        result = result * 10 + digit;
+    }
+    value = result;
+    return true;
+}
+
+inline bool ParseSigned(const char* begin, const char* end, int64_t& value)
+{
+    bool negative = begin != end && *begin == '-';
+    if (begin != end && (*begin == '-' || *begin == '+')) ++begin;
+    uint64_t magnitude;
+    if (!ParseUnsigned(begin, end, magnitude)) return false;
+    if (negative ? magnitude > static_cast<uint64_t>(INT64_MAX) + 1 : magnitude > static_cast<uint64_t>(INT64_MAX))
+    {
+        return false;
+    }
+    value = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+    return true;
+}
+
+// Вещественное число из всей строки [begin, end).
+// Быстрый путь (до 15 значащих цифр и порядок до 22) точен: мантисса и степень 10
+// представимы в double, результат - одно правильно округленное умножение или деление.
+// Остальное (длинные мантиссы, большие порядки, nan/inf) разбирает strtod
+inline bool ParseReal(const char* begin, const char* end, double& value)
+{
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    if (begin == end) return false;
+    const char* p = begin;
+    bool negative = *p == '-';
+    if (*p == '-' || *p == '+') ++p;
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+    for (; p != end && static_cast<unsigned>(*p - '0') <= 9; ++p, any = true)
+    {
+        if (mantissa || *p != '0') ++digits;
+        if (digits <= 19) mantissa = mantissa * 10 + (*p - '0');
+        else ++exponent;
+    }
+    if (p != end && *p == '.')
+    {
+        for (++p; p != end && static_cast<unsigned>(*p - '0') <= 9; ++p, any = true)
+        {
+            if (mantissa || *p != '0') ++digits;
+            if (digits <= 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                --exponent;
+            }
+        }
+    }
+    if (any && p != end && (*p == 'e' || *p == 'E'))
+    {
+        int64_t e;
+        if (!ParseSigned(p + 1, end, e) || e > 100000 || e < -100000) return false;
+        exponent += static_cast<int>(e);
+        p = end;
+    }
+
+    if (any && p == end && digits <= 15 && exponent >= -22 && exponent <= 22)
+    {
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / powers[-exponent] : result * powers[exponent];
+        value = negative ? -result : result;
+        return true;
+    }
+
+    char buffer[128];
+    size_t length = static_cast<size_t>(end - begin);
+    if (length >= sizeof(buffer)) return false;
+    std::memcpy(buffer, begin, length);
+    buffer[length] = '\0';
+    char* parsed;
+    value = std::strtod(buffer, &parsed);
+    return parsed == buffer + length;
+}
+
+// Загрузка записей из CSV или NDJSON в буфер записей.
+// Соответствие колонок (ключей) полям layout строится один раз: для CSV по строке
+// заголовка, для NDJSON по порядку ключей первого объекта с проверкой на каждой строке.
+// Значения пишутся с семантикой struct_write: лишние старшие биты отбрасываются,
+// отсутствующие поля и выравнивание остаются нулевыми
+class RecordImporter
+{
+public:
+    enum Format
+    {
+        Csv,
+        NdJson
+    };
+
+    RecordImporter(const StructLayout& layout, Format format)
+        : m_layout(layout), m_format(format), m_headerPending(format == Csv), m_line(0)
+    {
+    }
+
+    // CSV без строки заголовка: имена колонок задаются явно ("" - колонка пропускается)
+    RecordImporter(const StructLayout& layout, const std::vector<std::string>& columns)
+        : m_layout(layout), m_format(Csv), m_headerPending(false), m_line(0)
+    {
+        for (const auto& name : columns)
+        {
+            m_columns.push_back(name.empty() ? -1 : static_cast<int>(m_layout.fieldIndex(name)));
+        }
+    }
+
+    // Разбор целых строк из text в records (не более maxRecords записей).
+    // consumed - сколько байт text разобрано; неполная последняя строка остается
+    // для следующего вызова, если final == false
+    size_t parse(const char* text, size_t length, char* records, size_t maxRecords, size_t& consumed,
+                 bool final = true)
+    {
+        size_t recordSize = m_layout.size();
+        size_t count = 0;
+        const char* p = text;
+        const char* end = text + length;
+        while (p != end && count < maxRecords)
+        {
+            const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!newline && !final) break;
+            const char* lineEnd = newline ? newline : end;
+            const char* next = newline ? newline + 1 : end;
+            ++m_line;
+            if (lineEnd != p && lineEnd[-1] == '\r') --lineEnd;
+            if (lineEnd == p)
+            {
+                p = next;
+                continue;
+            }
+
+            if (m_headerPending)
+            {
+                parseHeader(p, lineEnd);
+                m_headerPending = false;
+            }
+            else
+            {
+                char* record = records + count * recordSize;
+                std::memset(record, 0, recordSize);
+                if (m_format == Csv)
+                {
+                    parseCsvLine(p, lineEnd, record);
+                }
+                else
+                {
+                    parseJsonLine(p, lineEnd, record);
+                }
+                ++count;
+            }
+            p = next;
+        }
+        consumed = static_cast<size_t>(p - text);
+        return count;
+    }
+
+    // Весь файл пакетами по batchRecords записей; записи добавляются в конец records
+    size_t importFile(std::FILE* file, std::vector<char>& records, size_t batchRecords = 4096)
+    {
+        size_t recordSize = m_layout.size();
+        size_t total = 0;
+        std::vector<char> text;
+        size_t filled = 0;
+        bool eof = false;
+        while (!eof || filled > 0)
+        {
+            if (!eof)
+            {
+                if (text.size() - filled < 65536) text.resize(filled + (1u << 20));
+                size_t n = std::fread(text.data() + filled, 1, text.size() - filled, file);
+                filled += n;
+                eof = n == 0;
+            }
+            size_t before = records.size() / recordSize;
+            records.resize((before + batchRecords) * recordSize);
+            size_t consumed;
+            size_t count = parse(text.data(), filled, records.data() + before * recordSize, batchRecords, consumed, eof);
+            records.resize((before + count) * recordSize);
+            total += count;
+            std::memmove(text.data(), text.data() + consumed, filled - consumed);
+            filled -= consumed;
+            if (eof && consumed == 0 && count == 0) break;
+        }
+        return total;
+    }
+
+private:
+    void fail(const std::string& message) const
+    {
+        throw std::runtime_error("Line " + std::to_string(m_line) + ": " + message);
+    }
+
+    static const char* skipSpaces(const char* p, const char* end)
+    {
+        while (p != end && (*p == ' ' || *p == '\t')) ++p;
+        return p;
+    }
+
+    // Конец ячейки CSV: запятая вне кавычек или конец строки (RFC 4180, "" внутри
+    // кавычек - экранированная кавычка)
+    static const char* csvCellEnd(const char* p, const char* end)
+    {
+        bool quoted = false;
+        for (; p != end; ++p)
+        {
+            if (*p == '"') quoted = !quoted;
+            else if (*p == ',' && !quoted) break;
+        }
+        return p;
+    }
+
+    // Кавычки вокруг ячейки CSV и пробелы по краям отбрасываются
+    static void trimCell(const char*& begin, const char*& end)
+    {
+        begin = skipSpaces(begin, end);
+        while (end != begin && (end[-1] == ' ' || end[-1] == '\t')) --end;
+        if (end - begin >= 2 && *begin == '"' && end[-1] == '"')
+        {
+            ++begin;
+            --end;
+        }
+    }
+
+    void parseHeader(const char* p, const char* end)
+    {
+        m_columns.clear();
+        while (true)
+        {
+            const char* comma = csvCellEnd(p, end);
+            const char* cellEnd = comma;
+            const char* begin = p;
+            trimCell(begin, cellEnd);
+            std::string name;
+            for (const char* c = begin; c != cellEnd; ++c)
+            {
+                if (*c == '"' && c + 1 != cellEnd && c[1] == '"') ++c;
+                name.push_back(*c);
+            }
+            m_columns.push_back(m_layout.indexOf(name));
+            if (comma == end) break;
+            p = comma + 1;
+        }
+    }
+
+    void parseCsvLine(const char* p, const char* end, char* record) const
+    {
+        for (size_t column = 0;; ++column)
+        {
+            const char* comma = csvCellEnd(p, end);
+            const char* cellEnd = comma;
+            if (column < m_columns.size() && m_columns[column] >= 0)
+            {
+                const char* begin = p;
+                trimCell(begin, cellEnd);
+                writeValue(static_cast<size_t>(m_columns[column]), begin, cellEnd, record);
+            }
+            if (comma == end) break;
+            p = comma + 1;
+        }
+    }
+
+    void parseJsonLine(const char* p, const char* end, char* record)
+    {
+        p = skipSpaces(p, end);
+        if (p == end || *p != '{') fail("expected JSON object");
+        p = skipSpaces(p + 1, end);
+        size_t position = 0;
+        if (p != end && *p == '}') return;
+        while (true)
+        {
+            if (p == end || *p != '"') fail("expected JSON key");
+            const char* key = ++p;
+            while (p != end && *p != '"')
+            {
+                if (*p == '\\') fail("escaped characters in keys are not supported");
+                ++p;
+            }
+            if (p == end) fail("unterminated JSON key");
+            int index = keyIndex(position++, key, p);
+            p = skipSpaces(p + 1, end);
+            if (p == end || *p != ':') fail("expected ':'");
+            p = skipSpaces(p + 1, end);
+
+            const char* value = p;
+            const char* valueEnd;
+            if (p != end && *p == '"')
+            {
+                value = ++p;
+                while (p != end && *p != '"') ++p;
+                if (p == end) fail("unterminated JSON string");
+                valueEnd = p++;
+            }
+            else
+            {
+                while (p != end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t') ++p;
+                valueEnd = p;
+                if (value != end && (*value == '{' || *value == '[')) fail("nested JSON values are not supported");
+            }
+            if (index >= 0) writeValue(static_cast<size_t>(index), value, valueEnd, record);
+
+            p = skipSpaces(p, end);
+            if (p == end) fail("unterminated JSON object");
+            if (*p == '}') return;
+            if (*p != ',') fail("expected ',' or '}'");
+            p = skipSpaces(p + 1, end);
+        }
+    }
+
+    // Индекс поля по ключу: сначала сверка с ключом, стоявшим на той же позиции
+    // в предыдущих строках, и только при несовпадении - поиск по имени
+    int keyIndex(size_t position, const char* key, const char* keyEnd)
+    {
+        size_t length = static_cast<size_t>(keyEnd - key);
+        if (position < m_keys.size() && m_keys[position].size() == length &&
+            std::memcmp(m_keys[position].data(), key, length) == 0)
+        {
+            return m_columns[position];
+        }
+        std::string name(key, length);
+        int index = m_layout.indexOf(name);
+        if (position >= m_keys.size())
+        {
+            m_keys.resize(position + 1);
+            m_columns.resize(position + 1, -1);
+        }
+        m_keys[position] = name;
+        m_columns[position] = index;
+        return index;
+    }
+
+    void writeValue(size_t index, const char* begin, const char* end, char* record) const
+    {
+        if (begin == end || (end - begin == 4 && std::memcmp(begin, "null", 4) == 0)) return;
+        // writeInt: вещественное поле получает 1.0/0.0, а не сырые биты
+        if (end - begin == 4 && std::memcmp(begin, "true", 4) == 0)
+        {
+            m_layout.writeInt(index, 1, record);
+            return;
+        }
+        if (end - begin == 5 && std::memcmp(begin, "false", 5) == 0)
+        {
+            m_layout.writeInt(index, 0, record);
+            return;
+        }
+
+        StructLayout::ValueKind kind = m_layout.field(index).kind;
+        if (kind != StructLayout::FloatValue && kind != StructLayout::DoubleValue)
+        {
+            uint64_t unsignedValue;
+            int64_t signedValue;
+            if (*begin != '-' && ParseUnsigned(begin, end, unsignedValue))
+            {
+                m_layout.writeBits(index, unsignedValue, record);
+                return;
+            }
+            if (ParseSigned(begin, end, signedValue))
+            {
+                m_layout.writeInt(index, signedValue, record);
+                return;
+            }
+        }
+        double realValue;
+        if (!ParseReal(begin, end, realValue))
+        {
+            fail("invalid number '" + std::string(begin, end) + "' for field " + m_layout.field(index).name);
+        }
+        m_layout.writeDouble(index, realValue, record);
+    }
+
+    const StructLayout& m_layout;
+    Format m_format;
+    bool m_headerPending;
+    size_t m_line;
+    std::vector<int> m_columns;         // индекс поля для колонки/позиции ключа, -1 - пропустить
+    std::vector<std::string> m_keys;    // ключи NDJSON по позициям в объекте
+};
+
+#endif // STRUCTIMPORT_H
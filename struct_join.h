@@ -0,0 +1,275 @@
+#ifndef STRUCTJOIN_H
+#define STRUCTJOIN_H
+
+#include "struct_projection.h"
+#include "struct_aggregate.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+// Пара совпавших записей: номер записи probe-стороны и номер строки build-стороны
+struct JoinMatch
+{
+    size_t probeIndex;
+    size_t buildRow;
+};
+
+// Хеш-соединение двух наборов записей с разными layout по равенству полей-ключей.
+// Хеш-таблица строится по build-стороне (ее выбирает вызывающий, обычно меньшую;
+// JoinRecords ниже выбирает сам) и хранит только нужные поля в плотных строках;
+// probe-сторона проверяется пакетами: сначала для
+// всего пакета считаются хеши и подгружаются корзины, потом идут сравнения.
+// Ключи сравниваются по значению: целые поля разной ширины и знаковости - как int64_t
+// (отрицательное знаковое не равно никакому uint64_t), а если хотя бы одна сторона
+// пары ключей float/double - обе стороны как double
+// (-0.0 равен 0.0; целые больше 2^53 при этом округляются)
+class HashJoin
+{
+public:
+    // buildColumns - поля build-стороны, которые нужны в результате (ключи сохраняются всегда)
+    HashJoin(const StructLayout& buildLayout, const std::vector<std::string>& buildKeys,
+             const std::vector<std::string>& buildColumns,
+             const StructLayout& probeLayout, const std::vector<std::string>& probeKeys)
+        : m_probeLayout(probeLayout),
+          m_projection(buildLayout, uniqueNames(buildKeys, buildColumns)),
+          m_rowLayout(m_projection.compactLayout()),
+          m_rowCount(0)
+    {
+        if (buildKeys.empty() || buildKeys.size() != probeKeys.size())
+        {
+            throw std::invalid_argument("Join key lists must be non-empty and of equal length");
+        }
+        for (size_t k = 0; k < buildKeys.size(); ++k)
+        {
+            m_rowKeys.push_back(m_rowLayout.fieldIndex(buildKeys[k]));
+            m_probeKeys.push_back(probeLayout.fieldIndex(probeKeys[k]));
+            m_realKeys.push_back(isReal(m_rowLayout, m_rowKeys.back()) || isReal(probeLayout, m_probeKeys.back()));
+            const StructLayout::Field& row = m_rowLayout.field(m_rowKeys.back());
+            const StructLayout::Field& probe = probeLayout.field(m_probeKeys.back());
+            m_signedKeys.push_back((isUnsigned64(row) && probe.kind == StructLayout::SignedValue) ||
+                                   (isUnsigned64(probe) && row.kind == StructLayout::SignedValue));
+        }
+    }
+
+    // Layout строк build-стороны, которые возвращает buildRow()
+    const StructLayout& rowLayout() const { return m_rowLayout; }
+    size_t rowCount() const { return m_rowCount; }
+    const char* buildRow(size_t row) const { return m_rows.data() + row * m_rowLayout.size(); }
+
+    // Добавление записей build-стороны (можно вызывать несколько раз до probe).
+    // Новые строки дописываются в концы цепочек; таблица перестраивается целиком
+    // только при удвоении числа корзин, поэтому серия вызовов стоит O(n)
+    void build(const char* records, size_t count)
+    {
+        size_t rowSize = m_rowLayout.size();
+        size_t first = m_rowCount;
+        m_rows.resize((m_rowCount + count) * rowSize);
+        m_projection.gather(records, count, m_rows.data() + m_rowCount * rowSize);
+        m_hashes.resize(m_rowCount + count);
+        m_next.resize(m_rowCount + count, SIZE_MAX);
+        for (size_t row = m_rowCount; row < m_rowCount + count; ++row)
+        {
+            m_hashes[row] = hashRow(m_rowLayout, m_rowKeys, m_realKeys, buildRow(row));
+        }
+        m_rowCount += count;
+
+        size_t buckets = m_buckets.empty() ? 16 : m_buckets.size();
+        while (buckets < 2 * m_rowCount) buckets <<= 1;
+        if (buckets != m_buckets.size())
+        {
+            m_buckets.assign(buckets, SIZE_MAX); // SIZE_MAX - конец цепочки
+            m_tails.assign(buckets, SIZE_MAX);
+            first = 0;
+        }
+        // Вставка в конец цепочки сохраняет исходный порядок строк
+        for (size_t row = first; row < m_rowCount; ++row)
+        {
+            size_t bucket = m_hashes[row] & (buckets - 1);
+            m_next[row] = SIZE_MAX;
+            if (m_tails[bucket] == SIZE_MAX) m_buckets[bucket] = row;
+            else m_next[m_tails[bucket]] = row;
+            m_tails[bucket] = row;
+        }
+    }
+
+    // Поиск пар для записей probe-стороны, найденные пары добавляются в matches
+    void probe(const char* records, size_t count, std::vector<JoinMatch>& matches) const
+    {
+        if (m_rowCount == 0) return;
+        size_t recordSize = m_probeLayout.size();
+        size_t mask = m_buckets.size() - 1;
+        uint64_t hashes[BatchSize];
+        for (size_t start = 0; start < count; start += BatchSize)
+        {
+            size_t n = std::min<size_t>(BatchSize, count - start);
+            const char* batch = records + start * recordSize;
+            for (size_t i = 0; i < n; ++i)
+            {
+                hashes[i] = hashRow(m_probeLayout, m_probeKeys, m_realKeys, batch + i * recordSize);
+                StructPrefetch(&m_buckets[hashes[i] & mask]);
+            }
+            for (size_t i = 0; i < n; ++i)
+            {
+                const char* record = batch + i * recordSize;
+                for (size_t row = m_buckets[hashes[i] & mask]; row != SIZE_MAX; row = m_next[row])
+                {
+                    if (m_hashes[row] == hashes[i] && keysEqual(record, buildRow(row)))
+                    {
+                        JoinMatch match = { start + i, row };
+                        matches.push_back(match);
+                    }
+                }
+            }
+        }
+    }
+
+    // Склейка пар в записи вида [запись probe][строка build]
+    void writePairs(const char* probeRecords, const std::vector<JoinMatch>& matches, char* out) const
+    {
+        size_t probeSize = m_probeLayout.size();
+        size_t rowSize = m_rowLayout.size();
+        for (const auto& match : matches)
+        {
+            std::memcpy(out, probeRecords + match.probeIndex * probeSize, probeSize);
+            std::memcpy(out + probeSize, buildRow(match.buildRow), rowSize);
+            out += probeSize + rowSize;
+        }
+    }
+
+    // Колонки выбранных полей build-стороны для найденных пар (в порядке matches)
+    ColumnSet buildColumns(const std::vector<JoinMatch>& matches) const
+    {
+        std::vector<char> rows(matches.size() * m_rowLayout.size());
+        for (size_t i = 0; i < matches.size(); ++i)
+        {
+            std::memcpy(rows.data() + i * m_rowLayout.size(), buildRow(matches[i].buildRow), m_rowLayout.size());
+        }
+        return transpose(m_rowLayout, rows.data(), matches.size());
+    }
+
+private:
+    enum { BatchSize = 256 };
+
+    static std::vector<std::string> uniqueNames(const std::vector<std::string>& keys,
+                                                const std::vector<std::string>& columns)
+    {
+        std::vector<std::string> names = keys;
+        for (const auto& name : columns)
+        {
+            if (std::find(names.begin(), names.end(), name) == names.end()) names.push_back(name);
+        }
+        return names;
+    }
+
+    static bool isReal(const StructLayout& layout, size_t index)
+    {
+        StructLayout::ValueKind kind = layout.field(index).kind;
+        return kind == StructLayout::FloatValue || kind == StructLayout::DoubleValue;
+    }
+
+    // uint64_t выше 2^63 читается через readInt как отрицательное число
+    static bool isUnsigned64(const StructLayout::Field& field)
+    {
+        return field.kind == StructLayout::UnsignedValue && field.bitWidth == 64;
+    }
+
+    // Значение ключа в общем для пары ключей виде: биты double или int64_t
+    static uint64_t keyValue(const StructLayout& layout, size_t index, bool real, const char* record)
+    {
+        if (real)
+        {
+            double value = layout.readDouble(index, record);
+            if (value == 0) value = 0;      // -0.0 и 0.0 - один ключ
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+        return static_cast<uint64_t>(layout.readInt(index, record));
+    }
+
+    static uint64_t hashRow(const StructLayout& layout, const std::vector<size_t>& keys,
+                            const std::vector<bool>& real, const char* record)
+    {
+        uint64_t hash = 0;
+        for (size_t k = 0; k < keys.size(); ++k)
+        {
+            hash = MixBits(hash ^ keyValue(layout, keys[k], real[k], record));
+        }
+        return hash;
+    }
+
+    bool keysEqual(const char* probeRecord, const char* row) const
+    {
+        for (size_t k = 0; k < m_rowKeys.size(); ++k)
+        {
+            if (m_realKeys[k])
+            {
+                // Сравнение значений, а не бит: NaN не равен ничему
+                if (m_probeLayout.readDouble(m_probeKeys[k], probeRecord) != m_rowLayout.readDouble(m_rowKeys[k], row))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                int64_t value = m_probeLayout.readInt(m_probeKeys[k], probeRecord);
+                if (value != m_rowLayout.readInt(m_rowKeys[k], row) || (m_signedKeys[k] && value < 0)) return false;
+            }
+        }
+        return true;
+    }
+
+    const StructLayout& m_probeLayout;
+    Projection m_projection;
+    StructLayout m_rowLayout;
+    std::vector<size_t> m_rowKeys;
+    std::vector<size_t> m_probeKeys;
+    std::vector<bool> m_realKeys;   // пара ключей сравнивается как double
+    std::vector<bool> m_signedKeys; // одна сторона uint64_t, другая знаковая: отрицательные не равны
+    size_t m_rowCount;
+    std::vector<char> m_rows;
+    std::vector<uint64_t> m_hashes;
+    std::vector<size_t> m_buckets;
+    std::vector<size_t> m_tails;    // последняя строка цепочки каждой корзины
+    std::vector<size_t> m_next;
+};
+
+// Пара совпавших записей двух наборов: номера записей в левом и правом наборе
+struct JoinPair
+{
+    size_t leftIndex;
+    size_t rightIndex;
+};
+
+// Соединение двух наборов целиком: таблица строится по меньшему набору, пары
+// возвращаются по возрастанию (leftIndex, rightIndex) при любом выборе build-стороны
+inline std::vector<JoinPair> JoinRecords(const StructLayout& leftLayout, const std::vector<std::string>& leftKeys,
+                                         const char* left, size_t leftCount,
+                                         const StructLayout& rightLayout, const std::vector<std::string>& rightKeys,
+                                         const char* right, size_t rightCount)
+{
+    bool buildLeft = leftCount <= rightCount;
+    HashJoin join(buildLeft ? leftLayout : rightLayout, buildLeft ? leftKeys : rightKeys, std::vector<std::string>(),
+                  buildLeft ? rightLayout : leftLayout, buildLeft ? rightKeys : leftKeys);
+    join.build(buildLeft ? left : right, buildLeft ? leftCount : rightCount);
+    std::vector<JoinMatch> matches;
+    join.probe(buildLeft ? right : left, buildLeft ? rightCount : leftCount, matches);
+
+    std::vector<JoinPair> pairs(matches.size());
+    for (size_t i = 0; i < matches.size(); ++i)
+    {
+        pairs[i].leftIndex = buildLeft ? matches[i].buildRow : matches[i].probeIndex;
+        pairs[i].rightIndex = buildLeft ? matches[i].probeIndex : matches[i].buildRow;
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const JoinPair& a, const JoinPair& b)
+    {
+        return a.leftIndex != b.leftIndex ? a.leftIndex < b.leftIndex : a.rightIndex < b.rightIndex;
+    });
+    return pairs;
+}
+
+#endif // STRUCTJOIN_H
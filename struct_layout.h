@@ -0,0 +1,318 @@
+#ifndef STRUCTLAYOUT_H
+#define STRUCTLAYOUT_H
+
+#include "struct_parser.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifdef STRUCT_LAYOUT_PROFILE
+class StructLayout;
+// Учет обращения к полю (struct_profile.h)
+inline void ProfileFieldAccess(const StructLayout& layout, size_t index, const char* record, bool write);
+#define STRUCT_LAYOUT_PROFILE_ACCESS(index, record, write) ProfileFieldAccess(*this, index, record, write)
+#else
+#define STRUCT_LAYOUT_PROFILE_ACCESS(index, record, write)
+#endif
+
+// Скомпилированное описание структуры: текст разбирается один раз в конструкторе,
+// дальше чтение и запись полей идут по готовой таблице без повторного парсинга
+class StructLayout
+{
+public:
+    // Как интерпретировать биты поля при расширении до 64 бит
+    enum ValueKind
+    {
+        UnsignedValue,
+        SignedValue,
+        FloatValue,
+        DoubleValue
+    };
+
+    struct Field
+    {
+        std::string type;
+        std::string name;
+        int byteOffset;     // смещение поля (для битового поля - смещение контейнера)
+        int bitOffset;      // сдвиг внутри контейнера, у обычных полей 0
+        int bitWidth;       // у обычных полей равен size * 8
+        size_t size;        // размер поля или контейнера в байтах
+        bool isBitField;
+        ValueKind kind;
+        uint64_t mask;      // маска значения до сдвига
+    };
+
+    StructLayout() : m_size(0), m_id(0) {}
+
+    explicit StructLayout(const std::string& structText) : m_size(0), m_id(0)
+    {
+        auto info = BitFieldStructParser::parseStruct(structText);
+        m_name = info.name;
+        // totalSize парсера считает неполный последний контейнер битовых полей
+        // за 1 байт, а читается и пишется контейнер целиком: запись должна его вмещать
+        m_size = info.totalSize;
+        m_fields.reserve(info.fields.size());
+        for (const auto& src : info.fields)
+        {
+            Field field;
+            field.type = src.type;
+            field.name = src.name;
+            field.byteOffset = src.byteOffset;
+            field.bitOffset = src.isBitField ? src.bitOffset : 0;
+            field.bitWidth = src.isBitField ? src.bitWidth : static_cast<int>(src.size * 8);
+            field.size = src.size;
+            field.isBitField = src.isBitField;
+            field.kind = kindOf(src.type);
+            field.mask = maskOf(field.bitWidth);
+            m_size = std::max(m_size, static_cast<size_t>(field.byteOffset) + field.size);
+            addField(field);
+        }
+    }
+
+    // Layout из готовой таблицы полей (без разбора текста); каждое поле
+    // вместе с контейнером должно помещаться в size байт
+    StructLayout(const std::string& name, size_t size, const std::vector<Field>& fields)
+        : m_name(name), m_size(size), m_id(0)
+    {
+        for (const auto& field : fields)
+        {
+            if (field.byteOffset < 0 || static_cast<size_t>(field.byteOffset) + field.size > size)
+            {
+                throw std::invalid_argument("Field does not fit in the record: " + field.name);
+            }
+            addField(field);
+        }
+    }
+
+    const std::string& name() const { return m_name; }
+    size_t size() const { return m_size; }
+    size_t fieldCount() const { return m_fields.size(); }
+    const std::vector<Field>& fields() const { return m_fields; }
+    const Field& field(size_t index) const { return m_fields[index]; }
+
+    // Номер таблицы полей: новый при каждом ее изменении, копия layout сохраняет номер.
+    // В отличие от адреса объекта не совпадает у разных таблиц
+    uint64_t id() const { return m_id; }
+
+    // Маска значимых бит записи: 0xFF в байтах полей, нули в выравнивании
+    // и в неиспользуемых битах контейнеров битовых полей
+    std::vector<unsigned char> valueMask() const
+    {
+        std::vector<unsigned char> mask(m_size, 0);
+        for (const auto& f : m_fields)
+        {
+            char bytes[8];
+            storeUnit(bytes, f.size, f.isBitField ? f.mask << f.bitOffset : maskOf(static_cast<int>(f.size * 8)));
+            for (size_t i = 0; i < f.size; ++i)
+            {
+                mask[f.byteOffset + i] |= static_cast<unsigned char>(bytes[i]);
+            }
+        }
+        return mask;
+    }
+
+    // Индекс поля по имени или -1, если такого поля нет
+    int indexOf(const std::string& fieldName) const
+    {
+        auto it = m_index.find(fieldName);
+        return it == m_index.end() ? -1 : static_cast<int>(it->second);
+    }
+
+    size_t fieldIndex(const std::string& fieldName) const
+    {
+        int index = indexOf(fieldName);
+        if (index < 0)
+        {
+            StructMetrics::instance().fieldNotFound.add();
+            throw std::invalid_argument("Field not found: " + fieldName);
+        }
+        return static_cast<size_t>(index);
+    }
+
+    // Сырые биты поля, дополненные нулями до 64 бит
+    uint64_t readBits(size_t index, const char* record) const
+    {
+        const Field& f = m_fields[index];
+        STRUCT_LAYOUT_PROFILE_ACCESS(index, record, false);
+        uint64_t value = loadUnit(record + f.byteOffset, f.size);
+        return f.isBitField ? (value >> f.bitOffset) & f.mask : value;
+    }
+
+    // Целое значение с учетом знака (знаковые битовые поля расширяются как в C)
+    int64_t readInt(size_t index, const char* record) const
+    {
+        const Field& f = m_fields[index];
+        switch (f.kind)
+        {
+        case FloatValue:
+        case DoubleValue:
+            return static_cast<int64_t>(readDouble(index, record));
+        case SignedValue:
+            return signExtend(readBits(index, record), f.bitWidth);
+        default:
+            return static_cast<int64_t>(readBits(index, record));
+        }
+    }
+
+    double readDouble(size_t index, const char* record) const
+    {
+        const Field& f = m_fields[index];
+        switch (f.kind)
+        {
+        case FloatValue:
+        {
+            STRUCT_LAYOUT_PROFILE_ACCESS(index, record, false);
+            float value;
+            std::memcpy(&value, record + f.byteOffset, sizeof(value));
+            return value;
+        }
+        case DoubleValue:
+        {
+            STRUCT_LAYOUT_PROFILE_ACCESS(index, record, false);
+            double value;
+            std::memcpy(&value, record + f.byteOffset, sizeof(value));
+            return value;
+        }
+        case SignedValue:
+            return static_cast<double>(readInt(index, record));
+        default:
+            return static_cast<double>(readBits(index, record));
+        }
+    }
+
+    // Запись сырых бит: лишние старшие биты значения отбрасываются
+    void writeBits(size_t index, uint64_t value, char* record) const
+    {
+        const Field& f = m_fields[index];
+        STRUCT_LAYOUT_PROFILE_ACCESS(index, record, true);
+        if (!f.isBitField)
+        {
+            storeUnit(record + f.byteOffset, f.size, value);
+            return;
+        }
+        uint64_t current = loadUnit(record + f.byteOffset, f.size);
+        current &= ~(f.mask << f.bitOffset);
+        current |= (value & f.mask) << f.bitOffset;
+        storeUnit(record + f.byteOffset, f.size, current);
+    }
+
+    void writeInt(size_t index, int64_t value, char* record) const
+    {
+        const Field& f = m_fields[index];
+        if (f.kind == FloatValue || f.kind == DoubleValue)
+        {
+            writeDouble(index, static_cast<double>(value), record);
+            return;
+        }
+        writeBits(index, static_cast<uint64_t>(value), record);
+    }
+
+    void writeDouble(size_t index, double value, char* record) const
+    {
+        const Field& f = m_fields[index];
+        switch (f.kind)
+        {
+        case FloatValue:
+        {
+            STRUCT_LAYOUT_PROFILE_ACCESS(index, record, true);
+            float narrow = static_cast<float>(value);
+            std::memcpy(record + f.byteOffset, &narrow, sizeof(narrow));
+            break;
+        }
+        case DoubleValue:
+            STRUCT_LAYOUT_PROFILE_ACCESS(index, record, true);
+            std::memcpy(record + f.byteOffset, &value, sizeof(value));
+            break;
+        default:
+            writeInt(index, static_cast<int64_t>(value), record);
+            break;
+        }
+    }
+
+    template<typename T>
+    T read(const std::string& fieldName, const char* record) const
+    {
+        size_t index = fieldIndex(fieldName);
+        const Field& f = m_fields[index];
+        if (f.kind == FloatValue || f.kind == DoubleValue)
+        {
+            return static_cast<T>(readDouble(index, record));
+        }
+        return static_cast<T>(readInt(index, record));
+    }
+
+    static ValueKind kindOf(const std::string& type)
+    {
+        if (type == "float") return FloatValue;
+        if (type == "double") return DoubleValue;
+        if (type == "char" || type == "short" || type.compare(0, 3, "int") == 0) return SignedValue;
+        return UnsignedValue;
+    }
+
+    static uint64_t maskOf(int bitWidth)
+    {
+        return bitWidth >= 64 ? ~0ULL : (1ULL << bitWidth) - 1;
+    }
+
+    static int64_t signExtend(uint64_t value, int bitWidth)
+    {
+        if (bitWidth >= 64) return static_cast<int64_t>(value);
+        int shift = 64 - bitWidth;
+        return static_cast<int64_t>(value << shift) >> shift;
+    }
+
+    // Чтение/запись контейнера размером 1, 2, 4 или 8 байт (порядок байт хоста)
+    static uint64_t loadUnit(const char* p, size_t size)
+    {
+        switch (size)
+        {
+        case 1: { uint8_t v; std::memcpy(&v, p, 1); return v; }
+        case 2: { uint16_t v; std::memcpy(&v, p, 2); return v; }
+        case 4: { uint32_t v; std::memcpy(&v, p, 4); return v; }
+        default: { uint64_t v; std::memcpy(&v, p, 8); return v; }
+        }
+    }
+
+    static void storeUnit(char* p, size_t size, uint64_t value)
+    {
+        switch (size)
+        {
+        case 1: { uint8_t v = static_cast<uint8_t>(value); std::memcpy(p, &v, 1); break; }
+        case 2: { uint16_t v = static_cast<uint16_t>(value); std::memcpy(p, &v, 2); break; }
+        case 4: { uint32_t v = static_cast<uint32_t>(value); std::memcpy(p, &v, 4); break; }
+        default: std::memcpy(p, &value, 8); break;
+        }
+    }
+
+protected:
+    void addField(const Field& field)
+    {
+        m_index[field.name] = m_fields.size();
+        m_fields.push_back(field);
+        m_id = nextId();
+    }
+
+    static uint64_t nextId()
+    {
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
+    }
+
+    std::string m_name;
+    size_t m_size;
+    std::vector<Field> m_fields;
+    std::unordered_map<std::string, size_t> m_index;
+    uint64_t m_id;
+};
+
+#ifdef STRUCT_LAYOUT_PROFILE
+#include "struct_profile.h"
+#endif
+
+#endif // STRUCTLAYOUT_H
@@ -0,0 +1,307 @@
+#ifndef STRUCTLAYOUTCACHE_H
+#define STRUCTLAYOUTCACHE_H
+
+#include "struct_binary.h"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define STRUCT_LAYOUT_CACHE_MMAP 1
+#endif
+
+// 64-битный FNV-1a хеш текста структуры
+inline uint64_t HashStructText(const std::string& text)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : text)
+    {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Дисковый кеш скомпилированных layout.
+//
+// Файл: "SPLC" | u16 версия | u16 0 | u32 число записей |
+//       (u64 хеш текста | u32 смещение | u32 размер | u32 CRC-32)* |
+//       данные записей: str текст структуры | layout (SerializeLayout)
+//
+// Файл отображается в память целиком; layout декодируется из отображения в новый
+// StructLayout при первом обращении к тому же тексту (таблица полей StructLayout
+// хранится в std::vector, поэтому прямо из отображения не читается): хеш только
+// сужает поиск, текст сравнивается целиком.
+// Если текст изменился, файла нет или он испорчен, layout строится через
+// parseStruct, а save() переписывает кеш. Выданный layout больше не заменяется.
+class LayoutCache
+{
+public:
+    explicit LayoutCache(const std::string& path)
+        : m_path(path), m_data(nullptr), m_size(0), m_mapped(false), m_dirty(false), m_hits(0), m_misses(0)
+    {
+        load();
+    }
+
+    ~LayoutCache()
+    {
+        unload();
+    }
+
+    // Layout для текста структуры; ссылка действительна, пока жив кеш
+    const StructLayout& get(const std::string& structText)
+    {
+        uint64_t hash = HashStructText(structText);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto loaded = m_layouts.find(structText);
+        if (loaded != m_layouts.end())
+        {
+            return *loaded->second;
+        }
+
+        std::unique_ptr<StructLayout> layout;
+        auto stored = m_entries.equal_range(hash);
+        for (auto it = stored.first; it != stored.second && !layout; ++it)
+        {
+            if (it->second.text == structText) layout = decode(it->second);
+        }
+        if (layout)
+        {
+            ++m_hits;
+            StructMetrics::instance().cacheHits.add();
+        }
+        else
+        {
+            ++m_misses;
+            StructMetrics::instance().cacheMisses.add();
+            layout.reset(new StructLayout(structText));
+            m_dirty = true;
+        }
+
+        // Слот новый: текста в m_layouts не было, опубликованные layout не трогаются
+        std::unique_ptr<StructLayout>& slot = m_layouts[structText];
+        slot = std::move(layout);
+        return *slot;
+    }
+
+    size_t hits() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_hits;
+    }
+
+    size_t misses() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_misses;
+    }
+
+    bool dirty() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_dirty;
+    }
+
+    // Запись кеша: записи из файла, к которым не обращались, сохраняются как есть.
+    // Файл пишется во временный и подменяется переименованием
+    void save()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_dirty) return;
+
+        struct Output
+        {
+            uint64_t hash;
+            std::string blob;
+        };
+        std::vector<Output> outputs;
+        for (const auto& item : m_layouts)
+        {
+            Output output = { HashStructText(item.first), std::string() };
+            BinaryWriter(output.blob).str(item.first);
+            SerializeLayout(*item.second, output.blob);
+            outputs.push_back(output);
+        }
+        for (const auto& item : m_entries)
+        {
+            if (m_layouts.count(item.second.text)) continue;
+            Output output = { item.first, std::string(item.second.data, item.second.size) };
+            outputs.push_back(output);
+        }
+
+        std::string file;
+        BinaryWriter writer(file);
+        writer.bytes("SPLC", 4);
+        writer.u16(Version);
+        writer.u16(0);
+        writer.u32(static_cast<uint32_t>(outputs.size()));
+        size_t offset = HeaderSize + outputs.size() * EntrySize;
+        for (const auto& output : outputs)
+        {
+            writer.u64(output.hash);
+            writer.u32(static_cast<uint32_t>(offset));
+            writer.u32(static_cast<uint32_t>(output.blob.size()));
+            writer.u32(Crc32(output.blob.data(), output.blob.size()));
+            offset += output.blob.size();
+        }
+        for (const auto& output : outputs)
+        {
+            writer.bytes(output.blob.data(), output.blob.size());
+        }
+
+        std::string temporary = m_path + ".tmp";
+        std::FILE* f = std::fopen(temporary.c_str(), "wb");
+        if (!f)
+        {
+            throw std::runtime_error("Unable to write layout cache: " + temporary);
+        }
+        bool written = std::fwrite(file.data(), 1, file.size(), f) == file.size();
+        if (std::fclose(f) != 0 || !written || std::rename(temporary.c_str(), m_path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Unable to write layout cache: " + m_path);
+        }
+        m_dirty = false;
+    }
+
+private:
+    LayoutCache(const LayoutCache&);
+    LayoutCache& operator=(const LayoutCache&);
+
+    enum { Version = 2, HeaderSize = 12, EntrySize = 20 };
+
+    struct Entry
+    {
+        std::string text;
+        const char* data;       // текст и layout
+        size_t size;
+        uint32_t crc;
+    };
+
+    // Layout из файла или nullptr, если запись испорчена
+    std::unique_ptr<StructLayout> decode(const Entry& entry) const
+    {
+        if (Crc32(entry.data, entry.size) != entry.crc) return std::unique_ptr<StructLayout>();
+        try
+        {
+            BinaryReader reader(entry.data, entry.size);
+            reader.str();
+            return std::unique_ptr<StructLayout>(new StructLayout(DeserializeLayout(reader)));
+        }
+        catch (const std::runtime_error&)
+        {
+            return std::unique_ptr<StructLayout>();
+        }
+    }
+
+    void load()
+    {
+        if (!map()) return;
+        try
+        {
+            BinaryReader reader(m_data, m_size);
+            if (std::memcmp(reader.bytes(4), "SPLC", 4) != 0 || reader.u16() != Version)
+            {
+                throw std::runtime_error("Unknown layout cache format");
+            }
+            reader.u16();
+            uint32_t count = reader.u32();
+            if (count > reader.remaining() / EntrySize)
+            {
+                throw std::runtime_error("Corrupted layout cache");
+            }
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                uint64_t hash = reader.u64();
+                Entry entry;
+                size_t offset = reader.u32();
+                entry.size = reader.u32();
+                entry.crc = reader.u32();
+                if (offset > m_size || entry.size > m_size - offset)
+                {
+                    throw std::runtime_error("Corrupted layout cache");
+                }
+                entry.data = m_data + offset;
+                entry.text = BinaryReader(entry.data, entry.size).str();
+                m_entries.insert(std::make_pair(hash, entry));
+            }
+        }
+        catch (const std::runtime_error&)
+        {
+            // Испорченный кеш не ошибка: все layout будут построены заново
+            m_entries.clear();
+            m_dirty = true;
+        }
+    }
+
+#ifdef STRUCT_LAYOUT_CACHE_MMAP
+    bool map()
+    {
+        int fd = ::open(m_path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* data = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) return false;
+        m_data = static_cast<const char*>(data);
+        m_size = static_cast<size_t>(info.st_size);
+        m_mapped = true;
+        return true;
+    }
+
+    void unload()
+    {
+        if (m_mapped) ::munmap(const_cast<char*>(m_data), m_size);
+    }
+#else
+    // Без mmap файл просто читается в память
+    bool map()
+    {
+        std::FILE* f = std::fopen(m_path.c_str(), "rb");
+        if (!f) return false;
+        char buffer[65536];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), f)) > 0) m_buffer.insert(m_buffer.end(), buffer, buffer + n);
+        std::fclose(f);
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+        return m_size > 0;
+    }
+
+    void unload()
+    {
+    }
+
+    std::vector<char> m_buffer;
+#endif
+
+    std::string m_path;
+    const char* m_data;
+    size_t m_size;
+    bool m_mapped;
+    bool m_dirty;
+    size_t m_hits;
+    size_t m_misses;
+    mutable std::mutex m_mutex;
+    std::unordered_multimap<uint64_t, Entry> m_entries;
+    std::unordered_map<std::string, std::unique_ptr<StructLayout> > m_layouts;    // по полному тексту
+};
+
+#endif // STRUCTLAYOUTCACHE_H
@@ -0,0 +1,221 @@
+#ifndef STRUCTMETRICS_H
+#define STRUCTMETRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+#include <functional>
+
+// Счетчик, увеличиваемый без блокировок
+class MetricCounter
+{
+public:
+    MetricCounter() : m_value(0) {}
+
+    void add(uint64_t delta = 1) { m_value.fetch_add(delta, std::memory_order_relaxed); }
+    uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> m_value;
+};
+
+// Гистограмма задержек в наносекундах в духе HDR: 16 корзин на каждую степень двойки
+// (относительная погрешность не больше 1/16), значения до 2^40 нс (~18 минут).
+// Запись - один fetch_add по корзине плюс счетчики суммы и числа
+class LatencyHistogram
+{
+public:
+    enum
+    {
+        SubBits = 4,
+        SubBuckets = 1 << SubBits,
+        MaxExponent = 40,
+        BucketCount = (MaxExponent - SubBits + 2) * SubBuckets
+    };
+
+    LatencyHistogram() : m_count(0), m_sum(0)
+    {
+        for (size_t b = 0; b < BucketCount; ++b) m_buckets[b].store(0, std::memory_order_relaxed);
+    }
+
+    void record(uint64_t nanoseconds)
+    {
+        m_buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+
+    // Число записанных значений не больше limit (корзина, содержащая limit, входит целиком;
+    // точно для limit = 2^k - 1, верхней границы корзины)
+    uint64_t countAtMost(uint64_t limit) const
+    {
+        size_t last = bucketOf(limit);
+        uint64_t total = 0;
+        for (size_t b = 0; b <= last; ++b) total += m_buckets[b].load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // Значение квантиля q (0..1): верхняя граница корзины, в которую он попал
+    uint64_t quantile(double q) const
+    {
+        uint64_t counts[BucketCount];
+        uint64_t total = 0;
+        for (size_t b = 0; b < BucketCount; ++b) total += counts[b] = m_buckets[b].load(std::memory_order_relaxed);
+        if (!total) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BucketCount; ++b)
+        {
+            seen += counts[b];
+            if (seen >= rank) return upperBound(b);
+        }
+        return upperBound(BucketCount - 1);
+    }
+
+private:
+    static size_t bucketOf(uint64_t value)
+    {
+        if (value < SubBuckets) return static_cast<size_t>(value);
+        int exponent = 63;
+        while (!(value >> exponent)) --exponent;
+        if (exponent > MaxExponent) return BucketCount - 1;
+        size_t sub = static_cast<size_t>(value >> (exponent - SubBits)) & (SubBuckets - 1);
+        return static_cast<size_t>(exponent - SubBits + 1) * SubBuckets + sub;
+    }
+
+    static uint64_t lowerBound(size_t bucket)
+    {
+        if (bucket < SubBuckets) return bucket;
+        size_t exponent = bucket / SubBuckets + SubBits - 1;
+        return (static_cast<uint64_t>(SubBuckets + bucket % SubBuckets)) << (exponent - SubBits);
+    }
+
+    static uint64_t upperBound(size_t bucket) { return bucket + 1 < BucketCount ? lowerBound(bucket + 1) - 1 : ~0ULL; }
+
+    std::atomic<uint64_t> m_buckets[BucketCount];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+};
+
+// Встроенные метрики разбора и доступа к полям. Обновления - атомарные
+// инкременты без блокировок; снимок в текстовом формате Prometheus
+// пишется в файл или отдается обработчику, сеть не нужна
+class StructMetrics
+{
+public:
+    static StructMetrics& instance()
+    {
+        // Не разрушается: метрики могут обновляться при завершении программы
+        static StructMetrics* metrics = new StructMetrics();
+        return *metrics;
+    }
+
+    MetricCounter parses;           // вызовы parseStruct
+    MetricCounter parseErrors;
+    LatencyHistogram parseLatency;
+    MetricCounter cacheHits;        // LayoutCache
+    MetricCounter cacheMisses;
+    MetricCounter fieldNotFound;
+    MetricCounter bytesDecoded;     // байты записей, прочитанных из файлов записей
+
+    std::string prometheusText() const
+    {
+        std::string out;
+        counter(out, "struct_parse_total", "Number of struct texts parsed", parses.value());
+        counter(out, "struct_parse_errors_total", "Number of struct texts that failed to parse", parseErrors.value());
+
+        out += "# HELP struct_parse_duration_seconds Struct text parse latency\n";
+        out += "# TYPE struct_parse_duration_seconds histogram\n";
+        char text[256];
+        // Границы 2^k - 1 нс от ~1 мкс до ~1 с совпадают с границами корзин гистограммы,
+        // поэтому в le попадают ровно значения не больше границы
+        for (int k = 10; k <= 30; ++k)
+        {
+            uint64_t limit = (1ULL << k) - 1;
+            std::snprintf(text, sizeof(text), "struct_parse_duration_seconds_bucket{le=\"%.10g\"} %llu\n",
+                          static_cast<double>(limit) / 1e9, static_cast<unsigned long long>(parseLatency.countAtMost(limit)));
+            out += text;
+        }
+        unsigned long long count = parseLatency.count();
+        std::snprintf(text, sizeof(text),
+                      "struct_parse_duration_seconds_bucket{le=\"+Inf\"} %llu\n"
+                      "struct_parse_duration_seconds_sum %.9g\n"
+                      "struct_parse_duration_seconds_count %llu\n",
+                      count, static_cast<double>(parseLatency.sum()) / 1e9, count);
+        out += text;
+
+        counter(out, "struct_layout_cache_hits_total", "Layouts loaded from the layout cache", cacheHits.value());
+        counter(out, "struct_layout_cache_misses_total", "Layouts parsed because the cache had no entry",
+                cacheMisses.value());
+        counter(out, "struct_field_not_found_total", "Field lookups by a name the struct does not have",
+                fieldNotFound.value());
+        counter(out, "struct_bytes_decoded_total", "Record bytes decoded from record files", bytesDecoded.value());
+        return out;
+    }
+
+    void exportPrometheus(const std::function<void(const std::string&)>& callback) const
+    {
+        callback(prometheusText());
+    }
+
+    // Файл заменяется целиком (через временный), чтобы сборщик не увидел половину снимка
+    void writePrometheus(const std::string& path) const
+    {
+        std::string text = prometheusText();
+        std::string temporary = path + ".tmp";
+        std::FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (!file)
+        {
+            throw std::runtime_error("Unable to create metrics file: " + temporary);
+        }
+        bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+        written = std::fclose(file) == 0 && written;
+        if (!written || std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Unable to write metrics file: " + path);
+        }
+    }
+
+    // Замер одного разбора: время и ошибки фиксируются при выходе из области
+    class ParseScope
+    {
+    public:
+        ParseScope() : m_start(std::chrono::steady_clock::now()), m_done(false) {}
+
+        void done() { m_done = true; }
+
+        ~ParseScope()
+        {
+            StructMetrics& metrics = instance();
+            auto elapsed = std::chrono::steady_clock::now() - m_start;
+            metrics.parses.add();
+            metrics.parseLatency.record(
+                static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            if (!m_done) metrics.parseErrors.add();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point m_start;
+        bool m_done;
+    };
+
+private:
+    StructMetrics() {}
+
+    static void counter(std::string& out, const char* name, const char* help, uint64_t value)
+    {
+        char text[256];
+        std::snprintf(text, sizeof(text), "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name,
+                      static_cast<unsigned long long>(value));
+        out += text;
+    }
+};
+
+#endif // STRUCTMETRICS_H
@@ -0,0 +1,253 @@
+#ifndef STRUCTOPTIMIZE_H
+#define STRUCTOPTIMIZE_H
+
+#include "struct_layout.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sstream>
+#include <algorithm>
+
+// Модель размещения полей, по которой считается размер структуры
+enum LayoutAbi
+{
+    PackedAbi,      // без выравнивания, контейнер битовых полей занимает полный размер
+                    // (как StructLayout::size(); totalSize парсера считает неполный
+                    // последний контейнер за 1 байт)
+    NaturalAbi      // выравнивание по размеру типа, как в SysV x86-64
+};
+
+// Размер и число кеш-линий для одного порядка полей
+struct LayoutFootprint
+{
+    size_t size;
+    size_t padding;         // байты, не занятые полями
+    size_t cacheLines;
+    size_t hotCacheLines;   // линии, в которые попадают поля с ненулевой частотой доступа
+};
+
+// Подбор порядка полей и упаковки битовых полей: минимальный размер по выбранной
+// модели, а при наличии профиля доступа - часто используемые поля в первых кеш-линиях.
+// Битовые поля одного типа раскладываются по контейнерам "первый подходящий"
+// по убыванию ширины; безымянные битовые поля (явное выравнивание) отбрасываются
+class LayoutOptimizer
+{
+public:
+    enum { CacheLine = 64 };
+
+    explicit LayoutOptimizer(const StructLayout& layout, LayoutAbi abi = NaturalAbi) : m_layout(layout), m_abi(abi)
+    {
+        for (const auto& field : layout.fields())
+        {
+            if (!field.name.empty()) m_fields.push_back(field);
+        }
+    }
+
+    // Частоты доступа по именам полей (например, из профиля struct_profile.h)
+    void setProfile(const std::map<std::string, uint64_t>& accessCounts) { m_profile = accessCounts; }
+
+    // Исходный порядок полей
+    LayoutFootprint current() const { return footprint(originalUnits()); }
+
+    LayoutFootprint proposed() const { return footprint(proposedUnits()); }
+
+    // Текст структуры с предложенным порядком полей
+    std::string proposedText() const
+    {
+        std::ostringstream out;
+        out << "struct " << m_layout.name() << " {\n";
+        for (const Unit& unit : proposedUnits())
+        {
+            for (const auto& field : unit.fields)
+            {
+                out << "    " << field.type << " " << field.name;
+                if (field.isBitField) out << " : " << field.bitWidth;
+                out << ";\n";
+            }
+        }
+        out << "};\n";
+        return out.str();
+    }
+
+private:
+    // Обычное поле или контейнер битовых полей
+    struct Unit
+    {
+        size_t size;
+        std::vector<StructLayout::Field> fields;
+        uint64_t heat;
+    };
+
+    uint64_t heatOf(const StructLayout::Field& field) const
+    {
+        auto it = m_profile.find(field.name);
+        return it == m_profile.end() ? 0 : it->second;
+    }
+
+    size_t align(size_t offset, size_t size) const
+    {
+        return m_abi == NaturalAbi ? (offset + size - 1) / size * size : offset;
+    }
+
+    // Контейнеры в исходном порядке: битовое поле продолжает предыдущий контейнер
+    // того же размера, если помещается в него
+    std::vector<Unit> originalUnits() const
+    {
+        std::vector<Unit> units;
+        int usedBits = 0;
+        for (const auto& field : m_fields)
+        {
+            bool joins = field.isBitField && !units.empty() && units.back().fields.back().isBitField &&
+                         units.back().size == field.size && usedBits + field.bitWidth <= static_cast<int>(field.size * 8);
+            if (joins)
+            {
+                usedBits += field.bitWidth;
+            }
+            else
+            {
+                Unit unit = { field.size, std::vector<StructLayout::Field>(), 0 };
+                units.push_back(unit);
+                usedBits = field.isBitField ? field.bitWidth : 0;
+            }
+            units.back().fields.push_back(field);
+            units.back().heat += heatOf(field);
+        }
+        return units;
+    }
+
+    std::vector<Unit> proposedUnits() const
+    {
+        std::vector<Unit> units;
+        std::map<std::string, std::vector<StructLayout::Field> > bitFields;
+        std::vector<std::string> bitTypes;
+        for (const auto& field : m_fields)
+        {
+            if (!field.isBitField)
+            {
+                Unit unit = { field.size, std::vector<StructLayout::Field>(1, field), heatOf(field) };
+                units.push_back(unit);
+                continue;
+            }
+            if (!bitFields.count(field.type)) bitTypes.push_back(field.type);
+            bitFields[field.type].push_back(field);
+        }
+
+        for (const auto& type : bitTypes)
+        {
+            std::vector<StructLayout::Field>& fields = bitFields[type];
+            std::stable_sort(fields.begin(), fields.end(), [](const StructLayout::Field& a, const StructLayout::Field& b)
+            {
+                return a.bitWidth > b.bitWidth;
+            });
+            std::vector<int> free;
+            size_t first = units.size();
+            for (const auto& field : fields)
+            {
+                size_t c = 0;
+                while (c < free.size() && free[c] < field.bitWidth) ++c;
+                if (c == free.size())
+                {
+                    Unit unit = { field.size, std::vector<StructLayout::Field>(), 0 };
+                    units.push_back(unit);
+                    free.push_back(static_cast<int>(field.size * 8));
+                }
+                free[c] -= field.bitWidth;
+                units[first + c].fields.push_back(field);
+                units[first + c].heat += heatOf(field);
+            }
+        }
+
+        auto byAlignment = [](const Unit& a, const Unit& b) { return a.size > b.size; };
+        if (m_profile.empty())
+        {
+            std::stable_sort(units.begin(), units.end(), byAlignment);
+            return units;
+        }
+
+        // Горячие контейнеры по убыванию частоты на байт набираются группами
+        // по кеш-линии, внутри группы - по убыванию выравнивания; холодные - в конце
+        std::stable_sort(units.begin(), units.end(), [](const Unit& a, const Unit& b)
+        {
+            return a.heat * b.size > b.heat * a.size;
+        });
+        std::vector<Unit> ordered;
+        size_t begin = 0, bytes = 0;
+        auto closeGroup = [&](size_t end)
+        {
+            size_t from = ordered.size();
+            ordered.insert(ordered.end(), units.begin() + begin, units.begin() + end);
+            std::stable_sort(ordered.begin() + from, ordered.end(), byAlignment);
+            begin = end;
+            bytes = 0;
+        };
+        size_t hotCount = static_cast<size_t>(std::count_if(units.begin(), units.end(), [](const Unit& unit)
+        {
+            return unit.heat != 0;
+        }));
+        for (size_t u = 0; u < hotCount; ++u)
+        {
+            if (bytes + units[u].size > CacheLine && u > begin) closeGroup(u);
+            bytes += units[u].size;
+        }
+        if (begin < hotCount) closeGroup(hotCount);
+
+        // Холодные поля по убыванию выравнивания, но сначала - мелкие, которые
+        // закрывают дыру выравнивания после горячих
+        std::vector<Unit> cold(units.begin() + hotCount, units.end());
+        std::stable_sort(cold.begin(), cold.end(), byAlignment);
+        size_t offset = endOffset(ordered);
+        while (m_abi == NaturalAbi && offset % 8 && !cold.empty())
+        {
+            size_t room = offset & (0 - offset);
+            size_t c = 0;
+            while (c < cold.size() && cold[c].size > room) ++c;
+            if (c == cold.size()) break;
+            ordered.push_back(cold[c]);
+            cold.erase(cold.begin() + c);
+            offset += ordered.back().size;
+        }
+        ordered.insert(ordered.end(), cold.begin(), cold.end());
+        return ordered;
+    }
+
+    size_t endOffset(const std::vector<Unit>& units) const
+    {
+        size_t offset = 0;
+        for (const Unit& unit : units) offset = align(offset, unit.size) + unit.size;
+        return offset;
+    }
+
+    LayoutFootprint footprint(const std::vector<Unit>& units) const
+    {
+        size_t offset = 0, used = 0, maxAlign = 1;
+        std::vector<char> hot;
+        for (const Unit& unit : units)
+        {
+            offset = align(offset, unit.size);
+            if (unit.heat)
+            {
+                size_t last = (offset + unit.size - 1) / CacheLine;
+                if (hot.size() <= last) hot.resize(last + 1, 0);
+                for (size_t line = offset / CacheLine; line <= last; ++line) hot[line] = 1;
+            }
+            used += unit.size;
+            offset += unit.size;
+            maxAlign = std::max(maxAlign, unit.size);
+        }
+        LayoutFootprint result;
+        result.size = m_abi == NaturalAbi ? align(offset, maxAlign) : offset;
+        result.padding = result.size - used;
+        result.cacheLines = (result.size + CacheLine - 1) / CacheLine;
+        result.hotCacheLines = static_cast<size_t>(std::count(hot.begin(), hot.end(), 1));
+        return result;
+    }
+
+    const StructLayout& m_layout;
+    LayoutAbi m_abi;
+    std::vector<StructLayout::Field> m_fields;
+    std::map<std::string, uint64_t> m_profile;
+};
+
+#endif // STRUCTOPTIMIZE_H
@@ -12,6 +12,16 @@
 #include <cstring>
 #include <algorithm>
 
+#include "struct_metrics.h"
+
+#ifdef STRUCT_LAYOUT_PROFILE
+// Учет обращения к полю index текста структуры (struct_profile.h)
+inline void ProfileTextAccess(const std::string& structText, size_t index, const char* record, bool write);
+#define STRUCT_PARSER_PROFILE_ACCESS(text, index, record, write) ProfileTextAccess(text, index, record, write)
+#else
+#define STRUCT_PARSER_PROFILE_ACCESS(text, index, record, write)
+#endif
+
 class BitFieldStructParser
 {
     friend inline std::string FieldType(const std::string &StructText, const std::string &FieldName);
@@ -179,6 +189,7 @@ private:
 public:
     static StructInfo parseStruct(const std::string& structText)
     {
+        StructMetrics::ParseScope metricsScope;
         StructInfo structInfo;
 
         // Предварительная обработка текста
@@ -309,6 +320,7 @@ public:
             throw std::invalid_argument("Не удалось найти содержимое структуры между {}");
         }
 
+        metricsScope.done();
         return structInfo;
     }
 
@@ -328,6 +340,7 @@ public:
         {
             if (field.name == fieldName)
             {
+                STRUCT_PARSER_PROFILE_ACCESS(structText, static_cast<size_t>(&field - structInfo.fields.data()), buffer, true);
                 if (!field.isBitField)
                 {
                     // Обычное поле
@@ -359,6 +372,7 @@ public:
             }
         }
 
+        StructMetrics::instance().fieldNotFound.add();
         throw std::invalid_argument("Field not found: " + fieldName);
     }
 
@@ -371,6 +385,7 @@ public:
         {
             if (field.name == fieldName)
             {
+                STRUCT_PARSER_PROFILE_ACCESS(structText, static_cast<size_t>(&field - structInfo.fields.data()), buffer, false);
                 if (!field.isBitField)
                 {
                     // Обычное поле
@@ -392,6 +407,7 @@ public:
             }
         }
 
+        StructMetrics::instance().fieldNotFound.add();
         throw std::invalid_argument("Field not found: " + fieldName);
     }
 
@@ -464,5 +480,9 @@ inline int32_t StructSizeOf(const std::string &StructString)
   return BitFieldStructParser::struct_sizeof(StructString);
 }
 
+#ifdef STRUCT_LAYOUT_PROFILE
+// Определение ProfileTextAccess; struct_layout.h подключает struct_profile.h
+#include "struct_layout.h"
+#endif
 
 #endif // STRUCTPARSER_H
@@ -0,0 +1,419 @@
+// Набор бенчмарков разбора структур и доступа к полям.
+//
+// struct_parser_bench [--filter <подстрока>] [--min-time <секунды>] [--json <файл>]
+//
+// Каждый бенчмарк запускается с удвоением числа итераций, пока один прогон не займет
+// не меньше --min-time (по умолчанию 0.5 с). Данные генерируются с фиксированным seed,
+// поэтому результаты сравнимы между запусками. --json пишет результаты в формате,
+// близком к Google Benchmark, для отслеживания регрессий.
+
+#include "struct_layout.h"
+#include "struct_columns.h"
+#include "struct_builder.h"
+
+#include <ctime>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+namespace
+{
+
+// Не дает компилятору выбросить вычисление, результат которого не используется
+template<typename T>
+inline void KeepValue(const T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile T sink;
+    sink = value;
+#endif
+}
+
+// Состояние одного прогона: функция выполняет iterations повторений
+// и сообщает, сколько элементов и байт обработано за весь прогон.
+// Если функция сама замерила время (seconds > 0), берется оно, а не время всего вызова
+struct BenchState
+{
+    uint64_t iterations;
+    uint64_t items;
+    uint64_t bytes;
+    double seconds;
+};
+
+struct BenchResult
+{
+    std::string name;
+    uint64_t iterations;
+    double seconds;
+    uint64_t items;
+    uint64_t bytes;
+};
+
+typedef std::function<void(BenchState&)> BenchFunction;
+
+std::vector<std::pair<std::string, BenchFunction> >& Registry()
+{
+    static std::vector<std::pair<std::string, BenchFunction> > benchmarks;
+    return benchmarks;
+}
+
+void Register(const std::string& name, const BenchFunction& function)
+{
+    Registry().push_back(std::make_pair(name, function));
+}
+
+BenchResult Run(const std::string& name, const BenchFunction& function, double minTime)
+{
+    uint64_t iterations = 1;
+    while (true)
+    {
+        BenchState state = { iterations, 0, 0, 0 };
+        auto start = std::chrono::steady_clock::now();
+        function(state);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (state.seconds > 0) seconds = state.seconds;
+        if (seconds >= minTime || iterations >= 1000000000ULL)
+        {
+            BenchResult result = { name, iterations, seconds, state.items, state.bytes };
+            return result;
+        }
+        // Следующая попытка с запасом, чтобы не удваивать много раз
+        double scale = seconds > 0 ? minTime * 1.4 / seconds : 10;
+        uint64_t next = static_cast<uint64_t>(static_cast<double>(iterations) * (scale > 10 ? 10 : scale));
+        iterations = next > iterations ? next : iterations * 2;
+    }
+}
+
+// --- Генераторы синтетических данных ---
+
+// Текст структуры из fieldCount полей: обычные поля разных типов вперемешку с группами
+// битовых полей, целиком заполняющими контейнер
+std::string GenerateStructText(size_t fieldCount, uint64_t seed)
+{
+    static const char* plainTypes[] = { "uint8_t", "int16_t", "uint32_t", "int32_t", "uint64_t", "float", "double" };
+    static const int groups[][4] = { { 3, 5, 0, 0 }, { 1, 7, 8, 0 }, { 4, 12, 16, 0 }, { 10, 22, 0, 0 } };
+    static const char* groupTypes[] = { "uint8_t", "uint16_t", "uint32_t", "uint32_t" };
+    std::mt19937_64 random(seed);
+    std::string text = "struct Synthetic" + std::to_string(fieldCount) + " {\n";
+    size_t produced = 0;
+    while (produced < fieldCount)
+    {
+        if (random() % 3 == 0 && fieldCount - produced >= 3)
+        {
+            size_t g = random() % 4;
+            // Группа {3, 5} занимает uint8_t целиком, {1, 7, 8} - uint16_t и т.д.
+            for (int k = 0; k < 4 && groups[g][k]; ++k)
+            {
+                text += std::string("    ") + groupTypes[g] + " f" + std::to_string(produced++) + " : " +
+                        std::to_string(groups[g][k]) + ";\n";
+            }
+            continue;
+        }
+        text += std::string("    ") + plainTypes[random() % 7] + " f" + std::to_string(produced++) + ";\n";
+    }
+    return text + "};\n";
+}
+
+std::vector<char> GenerateRecords(const StructLayout& layout, size_t count, uint64_t seed)
+{
+    std::mt19937_64 random(seed);
+    std::vector<char> records(count * layout.size());
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        for (size_t f = 0; f < layout.fieldCount(); ++f)
+        {
+            const StructLayout::Field& field = layout.field(f);
+            if (field.kind == StructLayout::FloatValue || field.kind == StructLayout::DoubleValue)
+            {
+                layout.writeDouble(f, static_cast<double>(random() % 1000000) / 100, record);
+            }
+            else
+            {
+                layout.writeBits(f, random(), record);
+            }
+        }
+    }
+    return records;
+}
+
+// Первое обычное целое поле и первое битовое поле layout
+size_t FindField(const StructLayout& layout, bool bitField)
+{
+    for (size_t f = 0; f < layout.fieldCount(); ++f)
+    {
+        const StructLayout::Field& field = layout.field(f);
+        if (field.isBitField == bitField && field.kind != StructLayout::FloatValue &&
+            field.kind != StructLayout::DoubleValue)
+        {
+            return f;
+        }
+    }
+    return 0;
+}
+
+// --- Бенчмарки ---
+
+const uint64_t Seed = 20240601;
+const size_t HotRecords = 4096;        // помещаются в кеш: измеряется задержка доступа
+const size_t BatchRecords = 1 << 20;   // не помещаются в кеш: измеряется пропускная способность
+
+void RegisterParse(size_t fieldCount)
+{
+    std::string text = GenerateStructText(fieldCount, Seed);
+    Register("parse/fields:" + std::to_string(fieldCount), [text](BenchState& state)
+    {
+        for (uint64_t i = 0; i < state.iterations; ++i)
+        {
+            StructLayout layout(text);
+            KeepValue(layout.size());
+        }
+        state.items = state.iterations;
+        state.bytes = state.iterations * text.size();
+    });
+}
+
+void RegisterAccess(const StructLayout& layout, bool bitField)
+{
+    std::string kind = bitField ? "bitfield" : "plain";
+    size_t field = FindField(layout, bitField);
+    std::shared_ptr<std::vector<char> > records(new std::vector<char>(GenerateRecords(layout, HotRecords, Seed)));
+
+    Register("read/" + kind, [&layout, field, records](BenchState& state)
+    {
+        const char* data = records->data();
+        size_t recordSize = layout.size();
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < state.iterations; ++i)
+        {
+            sum += layout.readBits(field, data + (i % HotRecords) * recordSize);
+        }
+        KeepValue(sum);
+        state.items = state.iterations;
+    });
+
+    Register("write/" + kind, [&layout, field, records](BenchState& state)
+    {
+        char* data = records->data();
+        size_t recordSize = layout.size();
+        for (uint64_t i = 0; i < state.iterations; ++i)
+        {
+            layout.writeBits(field, i, data + (i % HotRecords) * recordSize);
+        }
+        KeepValue(data[0]);
+        state.items = state.iterations;
+    });
+
+    // Тот же доступ на чтение во всех потоках сразу, у каждого потока свои записи.
+    // Каждый поток делает iterations чтений; замеряется только время от общего старта
+    // до завершения последнего потока (создание и join потоков не входят), так что
+    // ns/iter - время одного чтения в потоке при нагрузке на все ядра
+    unsigned threads = std::thread::hardware_concurrency();
+    if (threads < 2) threads = 2;
+    std::shared_ptr<std::vector<std::vector<char> > > perThreadRecords(new std::vector<std::vector<char> >());
+    for (unsigned t = 0; t < threads; ++t) perThreadRecords->push_back(GenerateRecords(layout, HotRecords, Seed + t));
+    Register("read/" + kind + "/threads:" + std::to_string(threads), [&layout, field, threads, perThreadRecords](BenchState& state)
+    {
+        const std::vector<std::vector<char> >& data = *perThreadRecords;
+        std::atomic<unsigned> ready(0), finished(0);
+        std::atomic<bool> go(false);
+        uint64_t iterations = state.iterations;
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t)
+        {
+            workers.push_back(std::thread([&layout, &data, &ready, &finished, &go, field, iterations, t]()
+            {
+                const char* records = data[t].data();
+                size_t recordSize = layout.size();
+                uint64_t sum = 0;
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                for (uint64_t i = 0; i < iterations; ++i) sum += layout.readBits(field, records + (i % HotRecords) * recordSize);
+                KeepValue(sum);
+                finished.fetch_add(1, std::memory_order_release);
+            }));
+        }
+        while (ready.load() < threads) std::this_thread::yield();
+        auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        while (finished.load(std::memory_order_acquire) < threads) std::this_thread::yield();
+        state.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (auto& worker : workers) worker.join();
+        state.items = iterations * threads;
+    });
+}
+
+void RegisterColumns(const StructLayout& layout)
+{
+    std::shared_ptr<std::vector<char> > records(new std::vector<char>(GenerateRecords(layout, BatchRecords, Seed)));
+
+    Register("columns/transpose_all", [&layout, records](BenchState& state)
+    {
+        ColumnSet columns;
+        std::vector<size_t> all(layout.fieldCount());
+        for (size_t f = 0; f < all.size(); ++f) all[f] = f;
+        for (uint64_t i = 0; i < state.iterations; ++i)
+        {
+            transpose(layout, records->data(), BatchRecords, all, columns);
+            KeepValue(columns.column(0).bytes[0]);
+        }
+        state.items = state.iterations * BatchRecords;
+        state.bytes = state.items * layout.size();
+    });
+
+    for (int bitField = 0; bitField < 2; ++bitField)
+    {
+        const StructLayout::Field& field = layout.field(FindField(layout, bitField != 0));
+        Register(std::string("columns/extract_") + (bitField ? "bitfield" : "plain"),
+                 [&layout, &field, records](BenchState& state)
+        {
+            std::vector<char> column(BatchRecords * field.size);
+            for (uint64_t i = 0; i < state.iterations; ++i)
+            {
+                ExtractField(field, records->data(), layout.size(), BatchRecords, column.data());
+                KeepValue(column[0]);
+            }
+            // Байты - размер полученной колонки
+            state.items = state.iterations * BatchRecords;
+            state.bytes = state.items * field.size;
+        });
+    }
+}
+
+void RegisterBuilder(const StructLayout& layout)
+{
+    Register("builder/build", [&layout](BenchState& state)
+    {
+        RecordBuilder builder(layout);
+        std::vector<char> records(HotRecords * layout.size());
+        for (uint64_t i = 0; i < state.iterations; ++i)
+        {
+            for (size_t f = 0; f < layout.fieldCount(); ++f) builder.set(f, static_cast<int64_t>(i + f));
+            builder.build(records.data() + (i % HotRecords) * layout.size());
+            builder.reset();
+        }
+        KeepValue(records[0]);
+        state.items = state.iterations;
+        state.bytes = state.iterations * layout.size();
+    });
+
+    Register("builder/apply_one_field", [&layout](BenchState& state)
+    {
+        RecordBuilder builder(layout);
+        std::vector<char> records = GenerateRecords(layout, HotRecords, Seed);
+        size_t field = FindField(layout, true);
+        for (uint64_t i = 0; i < state.iterations; ++i)
+        {
+            builder.set(field, static_cast<int64_t>(i));
+            builder.apply(records.data() + (i % HotRecords) * layout.size());
+            builder.reset();
+        }
+        KeepValue(records[0]);
+        state.items = state.iterations;
+    });
+}
+
+std::string JsonEscape(const std::string& text)
+{
+    std::string out;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        out += c;
+    }
+    return out;
+}
+
+void WriteJson(const std::vector<BenchResult>& results, const char* path, const char* executable)
+{
+    std::FILE* file = std::fopen(path, "w");
+    if (!file)
+    {
+        std::fprintf(stderr, "Unable to create %s\n", path);
+        std::exit(1);
+    }
+    char date[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    std::fprintf(file, "{\n  \"context\": {\n");
+    std::fprintf(file, "    \"date\": \"%s\",\n", date);
+    std::fprintf(file, "    \"executable\": \"%s\",\n", JsonEscape(executable).c_str());
+    std::fprintf(file, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+#ifdef NDEBUG
+    std::fprintf(file, "    \"library_build_type\": \"release\",\n");
+#else
+    std::fprintf(file, "    \"library_build_type\": \"debug\",\n");
+#endif
+#ifdef __VERSION__
+    std::fprintf(file, "    \"compiler\": \"%s\",\n", JsonEscape(__VERSION__).c_str());
+#endif
+    std::fprintf(file, "    \"seed\": %llu\n  },\n  \"benchmarks\": [\n", static_cast<unsigned long long>(Seed));
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult& r = results[i];
+        std::fprintf(file, "    {\n      \"name\": \"%s\",\n      \"iterations\": %llu,\n", JsonEscape(r.name).c_str(),
+                     static_cast<unsigned long long>(r.iterations));
+        std::fprintf(file, "      \"real_time\": %.6g,\n      \"time_unit\": \"ns\"", r.seconds * 1e9 / r.iterations);
+        if (r.items) std::fprintf(file, ",\n      \"items_per_second\": %.6g", r.items / r.seconds);
+        if (r.bytes) std::fprintf(file, ",\n      \"bytes_per_second\": %.6g", r.bytes / r.seconds);
+        std::fprintf(file, "\n    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+    std::fclose(file);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string filter;
+    double minTime = 0.5;
+    const char* jsonPath = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) minTime = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--filter <substring>] [--min-time <seconds>] [--json <file>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // Layout для бенчмарков доступа: 32 поля, треть из них - битовые
+    const StructLayout layout(GenerateStructText(32, Seed));
+    RegisterParse(4);
+    RegisterParse(16);
+    RegisterParse(64);
+    RegisterAccess(layout, false);
+    RegisterAccess(layout, true);
+    RegisterColumns(layout);
+    RegisterBuilder(layout);
+
+    std::printf("%-32s %14s %14s %14s %14s\n", "benchmark", "iterations", "ns/iter", "items/s", "MB/s");
+    std::vector<BenchResult> results;
+    for (const auto& bench : Registry())
+    {
+        if (!filter.empty() && bench.first.find(filter) == std::string::npos) continue;
+        BenchResult r = Run(bench.first, bench.second, minTime);
+        std::printf("%-32s %14llu %14.2f %14.4g %14.1f\n", r.name.c_str(), static_cast<unsigned long long>(r.iterations),
+                    r.seconds * 1e9 / r.iterations, r.items / r.seconds, r.bytes / r.seconds / 1e6);
+        std::fflush(stdout);
+        results.push_back(r);
+    }
+    if (jsonPath) WriteJson(results, jsonPath, argv[0]);
+    return 0;
+}
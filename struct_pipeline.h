@@ -0,0 +1,372 @@
+#ifndef STRUCTPIPELINE_H
+#define STRUCTPIPELINE_H
+
+#include "struct_layout.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <cstdio>
+
+const size_t PipelineCacheLine = 64;
+
+// Пауза при пустой/полной очереди: сначала короткое ожидание, потом уступаем поток
+inline void PipelineBackoff(unsigned& spins)
+{
+    if (++spins < 64) return;
+    spins = 0;
+    std::this_thread::yield();
+}
+
+// Ограниченная очередь один писатель - один читатель без блокировок.
+// Емкость округляется вверх до степени двойки
+template<typename T>
+class SpscRing
+{
+public:
+    typedef T value_type;
+
+    explicit SpscRing(size_t capacity) : m_head(0), m_tail(0)
+    {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        m_mask = size - 1;
+        m_items.resize(size);
+    }
+
+    bool tryPush(const T& item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) > m_mask) return false;
+        m_items[tail & m_mask] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& item)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) return false;
+        item = m_items[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    // Индексы разнесены по разным кэш-линиям, чтобы писатель и читатель не мешали друг другу
+    // (выравнивание дополнением, а не alignas: объект может создаваться через обычный new)
+    std::atomic<size_t> m_head;
+    char m_headPad[PipelineCacheLine - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_tail;
+    char m_tailPad[PipelineCacheLine - sizeof(std::atomic<size_t>)];
+    size_t m_mask;
+    std::vector<T> m_items;
+};
+
+// Ограниченная очередь со многими писателями и читателями (ячейки с номерами последовательности)
+template<typename T>
+class MpmcRing
+{
+public:
+    typedef T value_type;
+
+    explicit MpmcRing(size_t capacity) : m_head(0), m_tail(0)
+    {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        m_mask = size - 1;
+        m_cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i)
+        {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPush(const T& item)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[pos & m_mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.item = item;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // очередь заполнена
+            }
+            else
+            {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& item)
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[pos & m_mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    item = cell.item;
+                    cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // очередь пуста
+            }
+            else
+            {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    std::atomic<size_t> m_head;
+    char m_headPad[PipelineCacheLine - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_tail;
+    char m_tailPad[PipelineCacheLine - sizeof(std::atomic<size_t>)];
+    size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+};
+
+// Конвейер чтение -> декодирование -> вывод.
+// Каждая стадия работает в своем потоке, стадии связаны очередями без блокировок,
+// буферы записей и результаты декодирования переиспользуются по кругу.
+// Output - тип результата декодирования одного пакета (колонки, события и т.п.),
+// он создается заранее и передается в decode повторно, поэтому должен сам очищаться.
+template<typename Output>
+class RecordPipeline
+{
+public:
+    // Заполняет buffer не более чем maxRecords записями, возвращает их число (0 - конец данных)
+    typedef std::function<size_t(char* buffer, size_t maxRecords)> ReadFunction;
+    typedef std::function<void(const StructLayout& layout, const char* records, size_t count, Output& out)> DecodeFunction;
+    typedef std::function<void(const Output& out, size_t count)> SinkFunction;
+
+    // decoderThreads > 1 распределяет пакеты по декодерам по кругу;
+    // порядок пакетов на выходе при этом сохраняется
+    RecordPipeline(const StructLayout& layout, size_t recordsPerBatch = 4096,
+                   size_t batchCount = 8, size_t decoderThreads = 1)
+        : m_layout(layout),
+          m_recordsPerBatch(recordsPerBatch),
+          m_batchCount(batchCount),
+          m_decoderThreads(decoderThreads)
+    {
+        if (layout.size() == 0 || recordsPerBatch == 0 || decoderThreads == 0)
+        {
+            throw std::invalid_argument("Invalid pipeline configuration");
+        }
+        if (m_batchCount < 2 * m_decoderThreads)
+        {
+            m_batchCount = 2 * m_decoderThreads;
+        }
+    }
+
+    void run(const ReadFunction& read, const DecodeFunction& decode, const SinkFunction& sink)
+    {
+        std::vector<InputBatch> inputs(m_batchCount);
+        std::vector<OutputBatch> outputs(m_batchCount);
+        MpmcRing<InputBatch*> freeInputs(m_batchCount);
+        for (size_t i = 0; i < m_batchCount; ++i)
+        {
+            inputs[i].data.resize(m_recordsPerBatch * m_layout.size());
+            freeInputs.tryPush(&inputs[i]);
+        }
+
+        // У каждого декодера свой запас результатов: вывод забирает пакеты строго
+        // по порядку, и при общем запасе декодеры, ушедшие вперед, могли бы занять
+        // все результаты, пока декодер следующего по порядку пакета ждет свободный
+        std::vector<std::unique_ptr<SpscRing<InputBatch*> > > toDecoder;
+        std::vector<std::unique_ptr<SpscRing<OutputBatch*> > > toSink;
+        std::vector<std::unique_ptr<SpscRing<OutputBatch*> > > freeOutputs;
+        for (size_t i = 0; i < m_decoderThreads; ++i)
+        {
+            toDecoder.emplace_back(new SpscRing<InputBatch*>(m_batchCount));
+            toSink.emplace_back(new SpscRing<OutputBatch*>(m_batchCount));
+            freeOutputs.emplace_back(new SpscRing<OutputBatch*>(m_batchCount));
+        }
+        for (size_t i = 0; i < m_batchCount; ++i)
+        {
+            freeOutputs[i % m_decoderThreads]->tryPush(&outputs[i]);
+        }
+
+        m_abort.store(false);
+        m_error = std::exception_ptr();
+
+        std::vector<std::thread> threads;
+        threads.emplace_back([&]()
+        {
+            guarded([&]()
+            {
+                for (size_t seq = 0; ; ++seq)
+                {
+                    InputBatch* batch = pop(freeInputs);
+                    if (!batch) return;
+                    batch->count = read(batch->data.data(), m_recordsPerBatch);
+                    if (batch->count == 0)
+                    {
+                        freeInputs.tryPush(batch);
+                        // Признак конца отправляем каждому декодеру
+                        for (size_t i = 0; i < m_decoderThreads; ++i)
+                        {
+                            push(*toDecoder[i], static_cast<InputBatch*>(nullptr));
+                        }
+                        return;
+                    }
+                    push(*toDecoder[seq % m_decoderThreads], batch);
+                }
+            });
+        });
+
+        for (size_t d = 0; d < m_decoderThreads; ++d)
+        {
+            threads.emplace_back([&, d]()
+            {
+                guarded([&]()
+                {
+                    for (;;)
+                    {
+                        InputBatch* batch = pop(*toDecoder[d]);
+                        if (!batch)
+                        {
+                            push(*toSink[d], static_cast<OutputBatch*>(nullptr));
+                            return;
+                        }
+                        OutputBatch* out = pop(*freeOutputs[d]);
+                        if (!out) return;
+                        decode(m_layout, batch->data.data(), batch->count, out->value);
+                        out->count = batch->count;
+                        push(freeInputs, batch);
+                        push(*toSink[d], out);
+                    }
+                });
+            });
+        }
+
+        guarded([&]()
+        {
+            for (size_t seq = 0; ; ++seq)
+            {
+                OutputBatch* out = pop(*toSink[seq % m_decoderThreads]);
+                if (!out) return;
+                sink(out->value, out->count);
+                push(*freeOutputs[seq % m_decoderThreads], out);
+            }
+        });
+
+        // Вывод закончился (или упал) - остальные стадии больше не нужны
+        m_abort.store(true);
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+    // Стандартная стадия чтения из файла
+    static ReadFunction fileReader(std::FILE* file, size_t recordSize)
+    {
+        return [file, recordSize](char* buffer, size_t maxRecords) -> size_t
+        {
+            return std::fread(buffer, recordSize, maxRecords, file);
+        };
+    }
+
+private:
+    struct InputBatch
+    {
+        std::vector<char> data;
+        size_t count;
+    };
+
+    struct OutputBatch
+    {
+        Output value;
+        size_t count;
+    };
+
+    template<typename F>
+    void guarded(F body)
+    {
+        try
+        {
+            body();
+        }
+        catch (...)
+        {
+            bool expected = false;
+            if (m_abort.compare_exchange_strong(expected, true))
+            {
+                m_error = std::current_exception();
+            }
+        }
+    }
+
+    // Ожидание в очередях прерывается, если какая-то стадия завершилась с ошибкой
+    template<typename Ring, typename T>
+    void push(Ring& ring, T item)
+    {
+        unsigned spins = 0;
+        while (!ring.tryPush(item))
+        {
+            if (m_abort.load(std::memory_order_relaxed)) return;
+            PipelineBackoff(spins);
+        }
+    }
+
+    template<typename Ring>
+    typename Ring::value_type pop(Ring& ring)
+    {
+        typename Ring::value_type item = nullptr;
+        unsigned spins = 0;
+        while (!ring.tryPop(item))
+        {
+            if (m_abort.load(std::memory_order_relaxed)) return nullptr;
+            PipelineBackoff(spins);
+        }
+        return item;
+    }
+
+    const StructLayout& m_layout;
+    size_t m_recordsPerBatch;
+    size_t m_batchCount;
+    size_t m_decoderThreads;
+    std::atomic<bool> m_abort;
+    std::exception_ptr m_error;
+};
+
+#endif // STRUCTPIPELINE_H
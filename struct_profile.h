@@ -0,0 +1,288 @@
+#ifndef STRUCTPROFILE_H
+#define STRUCTPROFILE_H
+
+// Профиль обращений к полям: какие поля читаются и пишутся чаще всего.
+// Счетчики ведутся только при сборке с -DSTRUCT_LAYOUT_PROFILE: тогда чтение и запись
+// через StructLayout (readBits/readDouble/writeBits/writeDouble и все, что через них
+// идет) и через struct_read/struct_write парсера отмечают обращение. Без флага вызовы
+// в struct_layout.h и struct_parser.h не компилируются.
+//
+// У каждого потока свой набор счетчиков (увеличивается без атомарных RMW); dump()
+// и snapshot() складывают наборы всех потоков, включая завершившиеся.
+// Layout опознается по StructLayout::id(): layout, пересозданный по тому же адресу,
+// получает новые счетчики. Для struct_read/struct_write layout строится один раз
+// на текст структуры. В снимке счетчики layout с одинаковым именем и набором полей
+// складываются.
+
+#include "struct_layout.h"
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <unordered_map>
+
+// Суммарные счетчики поля
+struct FieldProfileEntry
+{
+    std::string name;
+    bool isBitField;
+    size_t cacheLine;       // номер кеш-линии поля от начала записи
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t bytes;         // байты контейнеров, загруженных или записанных
+    uint64_t splitLines;    // обращения, попавшие на границу двух кеш-линий
+
+    uint64_t accesses() const { return reads + writes; }
+};
+
+struct LayoutProfileEntry
+{
+    std::string name;
+    size_t recordSize;
+    std::vector<FieldProfileEntry> fields;
+};
+
+class FieldProfile
+{
+public:
+    enum { CacheLine = 64 };
+
+    static void touch(const StructLayout& layout, size_t index, const char* record, bool write)
+    {
+        Shard& shard = localShard();
+        Counters* counters = shard.lastId == layout.id() ? shard.lastCounters : shard.find(layout);
+        const StructLayout::Field& field = layout.field(index);
+        Counter& c = counters->fields[index];
+        bump(write ? c.writes : c.reads, 1);
+        bump(c.bytes, field.size);
+        uintptr_t start = reinterpret_cast<uintptr_t>(record) + field.byteOffset;
+        if (start % CacheLine + field.size > CacheLine) bump(c.splitLines, 1);
+    }
+
+    // Обращение через struct_read/struct_write: index - номер поля в разборе текста.
+    // Layout по тексту ищется в таблице потока; общий реестр - только при первой встрече
+    static void touchText(const std::string& structText, size_t index, const char* record, bool write)
+    {
+        Shard& shard = localShard();
+        const StructLayout*& layout = shard.texts[structText];
+        if (!layout)
+        {
+            Registry& registry = registryInstance();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            std::unique_ptr<StructLayout>& slot = registry.texts[structText];
+            if (!slot) slot.reset(new StructLayout(structText));
+            layout = slot.get();
+        }
+        touch(*layout, index, record, write);
+    }
+
+    // Сумма по всем потокам; счетчики layout с одинаковыми именем и таблицей полей складываются
+    static std::vector<LayoutProfileEntry> snapshot()
+    {
+        std::vector<LayoutProfileEntry> result;
+        Registry& registry = registryInstance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const auto& shard : registry.shards)
+        {
+            std::lock_guard<std::mutex> shardLock(shard->mutex);
+            for (const auto& item : shard->layouts) merge(*item.second, result);
+        }
+        return result;
+    }
+
+    // Таблица по всем layout и полям
+    static void dump(std::FILE* out)
+    {
+        for (const auto& layout : snapshot())
+        {
+            std::fprintf(out, "struct %s (%zu bytes)\n", layout.name.c_str(), layout.recordSize);
+            std::fprintf(out, "  %-24s %12s %12s %14s %6s %8s %10s\n", "field", "reads", "writes", "bytes", "line",
+                         "kind", "split");
+            for (const auto& f : layout.fields)
+            {
+                std::fprintf(out, "  %-24s %12llu %12llu %14llu %6zu %8s %10llu\n", f.name.c_str(),
+                             static_cast<unsigned long long>(f.reads), static_cast<unsigned long long>(f.writes),
+                             static_cast<unsigned long long>(f.bytes), f.cacheLine, f.isBitField ? "bitfield" : "plain",
+                             static_cast<unsigned long long>(f.splitLines));
+            }
+        }
+    }
+
+    // Строки "<поле> <число обращений>" для layout с именем layoutName -
+    // формат профиля для LayoutOptimizer и "myproject optimize --profile"
+    static void writeAccessCounts(const std::string& layoutName, std::FILE* out)
+    {
+        std::map<std::string, uint64_t> counts;
+        for (const auto& layout : snapshot())
+        {
+            if (layout.name != layoutName) continue;
+            for (const auto& f : layout.fields) counts[f.name] += f.accesses();
+        }
+        for (const auto& item : counts)
+        {
+            std::fprintf(out, "%s %llu\n", item.first.c_str(), static_cast<unsigned long long>(item.second));
+        }
+    }
+
+    // Обнуление счетчиков всех потоков; обращения, идущие в этот момент
+    // в других потоках, могут пережить сброс
+    static void reset()
+    {
+        Registry& registry = registryInstance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const auto& shard : registry.shards)
+        {
+            std::lock_guard<std::mutex> shardLock(shard->mutex);
+            for (const auto& item : shard->layouts)
+            {
+                for (size_t f = 0; f < item.second->fieldCount; ++f)
+                {
+                    Counter& c = item.second->fields[f];
+                    c.reads = 0;
+                    c.writes = 0;
+                    c.bytes = 0;
+                    c.splitLines = 0;
+                }
+            }
+        }
+    }
+
+private:
+    struct Counter
+    {
+        std::atomic<uint64_t> reads;
+        std::atomic<uint64_t> writes;
+        std::atomic<uint64_t> bytes;
+        std::atomic<uint64_t> splitLines;
+    };
+
+    // Счетчики одного layout в одном потоке; описание полей копируется при создании
+    struct Counters
+    {
+        explicit Counters(const StructLayout& layout)
+            : fieldCount(layout.fieldCount()), fields(new Counter[layout.fieldCount()])
+        {
+            info.name = layout.name();
+            info.recordSize = layout.size();
+            for (size_t f = 0; f < fieldCount; ++f)
+            {
+                const StructLayout::Field& field = layout.field(f);
+                FieldProfileEntry entry = { field.name, field.isBitField,
+                                            static_cast<size_t>(field.byteOffset) / CacheLine, 0, 0, 0, 0 };
+                info.fields.push_back(entry);
+                fields[f].reads = 0;
+                fields[f].writes = 0;
+                fields[f].bytes = 0;
+                fields[f].splitLines = 0;
+            }
+        }
+
+        size_t fieldCount;
+        std::unique_ptr<Counter[]> fields;
+        LayoutProfileEntry info;
+    };
+
+    // Счетчики одного потока по id layout. Пишет в них только владелец; структуру
+    // (новые layout) он меняет под mutex, который берет и сборщик снимка
+    struct Shard
+    {
+        Shard() : lastId(0), lastCounters(nullptr) {}
+
+        Counters* find(const StructLayout& layout)
+        {
+            auto it = layouts.find(layout.id());
+            Counters* counters;
+            if (it != layouts.end())
+            {
+                counters = it->second.get();
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::unique_ptr<Counters>& slot = layouts[layout.id()];
+                slot.reset(new Counters(layout));
+                counters = slot.get();
+            }
+            lastId = layout.id();
+            lastCounters = counters;
+            return counters;
+        }
+
+        std::mutex mutex;
+        std::unordered_map<uint64_t, std::unique_ptr<Counters> > layouts;
+        uint64_t lastId;        // id layout без полей - 0, обращений к нему не бывает
+        Counters* lastCounters;
+        std::unordered_map<std::string, const StructLayout*> texts;     // только для владельца
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Shard> > shards;
+        std::unordered_map<std::string, std::unique_ptr<StructLayout> > texts;     // для struct_read/struct_write
+    };
+
+    static void merge(const Counters& counters, std::vector<LayoutProfileEntry>& result)
+    {
+        size_t r = 0;
+        while (r < result.size() && (result[r].name != counters.info.name ||
+                                     result[r].recordSize != counters.info.recordSize ||
+                                     result[r].fields.size() != counters.fieldCount))
+        {
+            ++r;
+        }
+        if (r == result.size()) result.push_back(counters.info);
+        for (size_t f = 0; f < counters.fieldCount; ++f)
+        {
+            FieldProfileEntry& entry = result[r].fields[f];
+            const Counter& c = counters.fields[f];
+            entry.reads += c.reads.load(std::memory_order_relaxed);
+            entry.writes += c.writes.load(std::memory_order_relaxed);
+            entry.bytes += c.bytes.load(std::memory_order_relaxed);
+            entry.splitLines += c.splitLines.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Поток - единственный писатель своего счетчика, поэтому хватает load + store
+    static void bump(std::atomic<uint64_t>& counter, uint64_t delta)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    // Реестр не разрушается: потоки могут обращаться к полям при завершении программы
+    static Registry& registryInstance()
+    {
+        static Registry* registry = new Registry();
+        return *registry;
+    }
+
+    static Shard& localShard()
+    {
+        static thread_local Shard* shard = nullptr;
+        if (!shard)
+        {
+            Registry& registry = registryInstance();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.shards.push_back(std::unique_ptr<Shard>(new Shard()));
+            shard = registry.shards.back().get();
+        }
+        return *shard;
+    }
+};
+
+inline void ProfileFieldAccess(const StructLayout& layout, size_t index, const char* record, bool write)
+{
+    FieldProfile::touch(layout, index, record, write);
+}
+
+inline void ProfileTextAccess(const std::string& structText, size_t index, const char* record, bool write)
+{
+    FieldProfile::touchText(structText, index, record, write);
+}
+
+#endif // STRUCTPROFILE_H
@@ -0,0 +1,186 @@
+#ifndef STRUCTPROJECTION_H
+#define STRUCTPROJECTION_H
+
+#include "struct_columns.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Подсказка процессору заранее загрузить строку кэша (на других компиляторах ничего не делает)
+inline void StructPrefetch(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 0, 1);
+#else
+    (void)address;
+#endif
+}
+
+// Проекция: подмножество полей layout и минимальный набор байтовых диапазонов,
+// которые нужно прочитать из каждой записи, чтобы получить эти поля
+class Projection
+{
+public:
+    struct Range
+    {
+        size_t offset;
+        size_t length;
+    };
+
+    // prefetchDistance - на сколько записей вперед загружать нужные строки кэша в gather()
+    Projection(const StructLayout& layout, const std::vector<std::string>& fieldNames,
+               size_t prefetchDistance = 8)
+        : m_layout(layout), m_prefetchDistance(prefetchDistance), m_bytesPerRecord(0)
+    {
+        for (const auto& name : fieldNames)
+        {
+            m_fields.push_back(layout.fieldIndex(name));
+        }
+
+        // Диапазоны полей (для битовых полей - весь контейнер), отсортированные и слитые
+        std::vector<Range> ranges;
+        for (size_t index : m_fields)
+        {
+            const StructLayout::Field& field = layout.field(index);
+            Range range = { static_cast<size_t>(field.byteOffset), field.size };
+            ranges.push_back(range);
+        }
+        std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b)
+        {
+            return a.offset < b.offset;
+        });
+        for (const auto& range : ranges)
+        {
+            if (!m_ranges.empty() && range.offset <= m_ranges.back().offset + m_ranges.back().length)
+            {
+                Range& last = m_ranges.back();
+                last.length = std::max(last.offset + last.length, range.offset + range.length) - last.offset;
+            }
+            else
+            {
+                m_ranges.push_back(range);
+            }
+        }
+
+        // По одному адресу на каждые 64 байта диапазона плюс его последний байт:
+        // так покрываются все строки кэша диапазона при любом выравнивании записи
+        for (const auto& range : m_ranges)
+        {
+            m_bytesPerRecord += range.length;
+            for (size_t offset = range.offset; offset < range.offset + range.length; offset += 64)
+            {
+                m_prefetchOffsets.push_back(offset);
+            }
+            size_t last = range.offset + range.length - 1;
+            if ((last - range.offset) % 64 != 0)
+            {
+                m_prefetchOffsets.push_back(last);
+            }
+        }
+    }
+
+    const StructLayout& layout() const { return m_layout; }
+    const std::vector<size_t>& fieldIndices() const { return m_fields; }
+    const std::vector<Range>& ranges() const { return m_ranges; }
+
+    // Сколько байт записи реально читается (против layout().size() при полном декодировании)
+    size_t bytesPerRecord() const { return m_bytesPerRecord; }
+
+    // Layout плотной строки, которую пишет gather(): выбранные поля с пересчитанными смещениями
+    StructLayout compactLayout() const
+    {
+        std::vector<StructLayout::Field> fields;
+        for (size_t index : m_fields)
+        {
+            StructLayout::Field field = m_layout.field(index);
+            size_t base = 0;
+            for (const auto& range : m_ranges)
+            {
+                if (static_cast<size_t>(field.byteOffset) >= range.offset &&
+                    static_cast<size_t>(field.byteOffset) < range.offset + range.length)
+                {
+                    field.byteOffset = static_cast<int>(base + field.byteOffset - range.offset);
+                    break;
+                }
+                base += range.length;
+            }
+            fields.push_back(field);
+        }
+        return StructLayout(m_layout.name(), m_bytesPerRecord, fields);
+    }
+
+    // Декодирование только выбранных полей в колонки
+    void decode(const char* records, size_t count, ColumnSet& out) const
+    {
+        out.reset(m_layout, m_fields, count);
+        size_t recordSize = m_layout.size();
+        size_t block = ColumnBlockRecords(recordSize);
+        prefetch(records, 0, std::min(block, count));
+        for (size_t start = 0; start < count; start += block)
+        {
+            size_t n = std::min(block, count - start);
+            const char* src = records + start * recordSize;
+            // Пока разбирается текущий блок, загружаются нужные строки следующего
+            prefetch(records, start + n, std::min(count, start + n + block));
+            for (size_t c = 0; c < m_fields.size(); ++c)
+            {
+                Column& column = out.column(c);
+                ExtractField(m_layout.field(m_fields[c]), src, recordSize, n,
+                             column.bytes.data() + start * column.elementSize);
+            }
+        }
+    }
+
+    ColumnSet decode(const char* records, size_t count) const
+    {
+        ColumnSet result;
+        decode(records, count, result);
+        return result;
+    }
+
+    // Плотная копия нужных диапазонов: bytesPerRecord() байт на запись
+    void gather(const char* records, size_t count, char* out) const
+    {
+        size_t recordSize = m_layout.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (i + m_prefetchDistance < count)
+            {
+                prefetchRecord(records + (i + m_prefetchDistance) * recordSize);
+            }
+            const char* record = records + i * recordSize;
+            for (const auto& range : m_ranges)
+            {
+                std::memcpy(out, record + range.offset, range.length);
+                out += range.length;
+            }
+        }
+    }
+
+private:
+    void prefetchRecord(const char* record) const
+    {
+        for (size_t offset : m_prefetchOffsets)
+        {
+            StructPrefetch(record + offset);
+        }
+    }
+
+    void prefetch(const char* records, size_t from, size_t to) const
+    {
+        for (size_t i = from; i < to; ++i)
+        {
+            prefetchRecord(records + i * m_layout.size());
+        }
+    }
+
+    const StructLayout& m_layout;
+    std::vector<size_t> m_fields;
+    std::vector<Range> m_ranges;
+    std::vector<size_t> m_prefetchOffsets;
+    size_t m_prefetchDistance;
+    size_t m_bytesPerRecord;
+};
+
+#endif // STRUCTPROJECTION_H
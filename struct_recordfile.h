@@ -0,0 +1,498 @@
+#ifndef STRUCTRECORDFILE_H
+#define STRUCTRECORDFILE_H
+
+#include "struct_binary.h"
+#include "struct_zonemap.h"
+#include "struct_compress.h"
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+// Самоописывающий файл записей.
+//
+// Заголовок:  "SPRF" | u16 версия | u16 флаги | str текст структуры |
+//             str скомпилированный layout (SerializeLayout) |
+//             u32 число полей со статистикой | (str поле | u8 опции | u64 sentinel)* |
+//             u32 CRC-32 заголовка
+// Блоки:      "SPRB" | u32 число записей | u32 размер данных | u32 CRC-32 данных |
+//             u32 размер статистики | u32 CRC-32 статистики | статистика | записи
+//
+// Все числа в little-endian. Читателю не нужен текст структуры и parseStruct:
+// layout восстанавливается из заголовка. В версии 1 статистики блоков не было,
+// такие файлы по-прежнему читаются.
+//
+// Флаг RecordFileCompressed: записи блока хранятся в виде CompressBlock, размер
+// данных в заголовке блока - размер сжатого представления.
+const uint16_t RecordFileVersion = 2;
+const uint16_t RecordFileCompressed = 1;
+
+struct RecordFileOptions
+{
+    size_t recordsPerBlock;
+    std::vector<ZoneMapSpec> zoneMaps;
+    bool compress;
+
+    RecordFileOptions() : recordsPerBlock(4096), compress(false) {}
+};
+
+class RecordFileWriter
+{
+public:
+    RecordFileWriter(const std::string& path, const std::string& structText, size_t recordsPerBlock = 4096)
+        : m_file(nullptr), m_layout(structText), m_recordsPerBlock(recordsPerBlock), m_compress(false), m_pending(0)
+    {
+        open(path, structText);
+    }
+
+    // zoneMaps - поля, для которых в каждом блоке сохраняются min/max, число sentinel
+    // и (по желанию) фильтр Блума; по ним читатель пропускает неподходящие блоки
+    RecordFileWriter(const std::string& path, const std::string& structText,
+                     const std::vector<ZoneMapSpec>& zoneMaps, size_t recordsPerBlock = 4096)
+        : m_file(nullptr), m_layout(structText), m_zoneMaps(zoneMaps), m_recordsPerBlock(recordsPerBlock),
+          m_compress(false), m_pending(0)
+    {
+        open(path, structText);
+    }
+
+    RecordFileWriter(const std::string& path, const std::string& structText, const RecordFileOptions& options)
+        : m_file(nullptr), m_layout(structText), m_zoneMaps(options.zoneMaps),
+          m_recordsPerBlock(options.recordsPerBlock), m_compress(options.compress), m_pending(0)
+    {
+        open(path, structText);
+    }
+
+    ~RecordFileWriter()
+    {
+        try
+        {
+            close();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    const StructLayout& layout() const { return m_layout; }
+
+    void write(const char* records, size_t count)
+    {
+        size_t recordSize = m_layout.size();
+        while (count > 0)
+        {
+            size_t n = std::min(count, m_recordsPerBlock - m_pending);
+            std::memcpy(m_block.data() + m_pending * recordSize, records, n * recordSize);
+            m_pending += n;
+            records += n * recordSize;
+            count -= n;
+            if (m_pending == m_recordsPerBlock)
+            {
+                flush();
+            }
+        }
+    }
+
+    // Запись неполного блока
+    void flush()
+    {
+        if (m_pending == 0 || !m_file) return;
+        size_t payload = m_pending * m_layout.size();
+        const char* data = m_block.data();
+        std::string stats;
+        ComputeBlockStatistics(m_layout, m_zoneMaps, m_block.data(), m_pending, m_stats);
+        SerializeBlockStatistics(m_stats, stats);
+        if (m_compress)
+        {
+            m_compressed.clear();
+            CompressBlock(m_layout, m_block.data(), m_pending, m_compressed);
+            data = m_compressed.data();
+            payload = m_compressed.size();
+        }
+
+        std::string header;
+        BinaryWriter writer(header);
+        writer.bytes("SPRB", 4);
+        writer.u32(static_cast<uint32_t>(m_pending));
+        writer.u32(static_cast<uint32_t>(payload));
+        writer.u32(Crc32(data, payload));
+        writer.u32(static_cast<uint32_t>(stats.size()));
+        writer.u32(Crc32(stats.data(), stats.size()));
+        writer.bytes(stats.data(), stats.size());
+        writeRaw(header.data(), header.size());
+        writeRaw(data, payload);
+        m_pending = 0;
+    }
+
+    void close()
+    {
+        if (!m_file) return;
+        flush();
+        int result = std::fclose(m_file);
+        m_file = nullptr;
+        if (result != 0)
+        {
+            throw std::runtime_error("Unable to close record file");
+        }
+    }
+
+private:
+    RecordFileWriter(const RecordFileWriter&);
+    RecordFileWriter& operator=(const RecordFileWriter&);
+
+    void open(const std::string& path, const std::string& structText)
+    {
+        if (m_layout.size() == 0 || m_recordsPerBlock == 0)
+        {
+            throw std::invalid_argument("Invalid record file configuration");
+        }
+        for (const auto& spec : m_zoneMaps)
+        {
+            m_layout.fieldIndex(spec.field);
+        }
+        m_file = std::fopen(path.c_str(), "wb");
+        if (!m_file)
+        {
+            throw std::runtime_error("Unable to create record file: " + path);
+        }
+
+        std::string header;
+        BinaryWriter writer(header);
+        writer.bytes("SPRF", 4);
+        writer.u16(RecordFileVersion);
+        writer.u16(m_compress ? RecordFileCompressed : 0);
+        writer.str(structText);
+        std::string blob;
+        SerializeLayout(m_layout, blob);
+        writer.str(blob);
+        writer.u32(static_cast<uint32_t>(m_zoneMaps.size()));
+        for (const auto& spec : m_zoneMaps)
+        {
+            writer.str(spec.field);
+            writer.u8(static_cast<uint8_t>((spec.bloom ? 1 : 0) | (spec.hasSentinel ? 2 : 0)));
+            writer.u64(static_cast<uint64_t>(spec.sentinel));
+        }
+        writer.u32(Crc32(header.data(), header.size()));
+        writeRaw(header.data(), header.size());
+
+        m_block.resize(m_recordsPerBlock * m_layout.size());
+    }
+
+    void writeRaw(const void* data, size_t size)
+    {
+        if (std::fwrite(data, 1, size, m_file) != size)
+        {
+            throw std::runtime_error("Unable to write record file");
+        }
+    }
+
+    std::FILE* m_file;
+    StructLayout m_layout;
+    std::vector<ZoneMapSpec> m_zoneMaps;
+    size_t m_recordsPerBlock;
+    bool m_compress;
+    size_t m_pending;
+    std::vector<char> m_block;
+    std::string m_compressed;
+    std::vector<BlockStatistics> m_stats;
+};
+
+class RecordFileReader
+{
+public:
+    explicit RecordFileReader(const std::string& path)
+        : m_file(std::fopen(path.c_str(), "rb")), m_version(0), m_flags(0), m_count(0), m_payload(0), m_payloadCrc(0),
+          m_inBlock(false), m_skipped(0)
+    {
+        if (!m_file)
+        {
+            throw std::runtime_error("Unable to open record file: " + path);
+        }
+        try
+        {
+            readHeader();
+        }
+        catch (...)
+        {
+            std::fclose(m_file);
+            throw;
+        }
+    }
+
+    ~RecordFileReader()
+    {
+        std::fclose(m_file);
+    }
+
+    uint16_t version() const { return m_version; }
+    bool compressed() const { return (m_flags & RecordFileCompressed) != 0; }
+    const std::string& structText() const { return m_structText; }
+    const StructLayout& layout() const { return m_layout; }
+    const std::vector<ZoneMapSpec>& zoneMaps() const { return m_zoneMaps; }
+
+    // Переход к следующему блоку: читаются только заголовок и статистика блока,
+    // записи затем читаются readRecords() или пропускаются skipRecords()
+    bool nextBlock(size_t& count)
+    {
+        if (m_inBlock) skipRecords();
+        size_t headerSize = m_version >= 2 ? 24 : 16;
+        char header[24];
+        size_t got = std::fread(header, 1, headerSize, m_file);
+        if (got == 0) return false;
+        if (got != headerSize || std::memcmp(header, "SPRB", 4) != 0)
+        {
+            throw std::runtime_error("Corrupted record file block header");
+        }
+        BinaryReader reader(header + 4, headerSize - 4);
+        m_count = reader.u32();
+        m_payload = reader.u32();
+        m_payloadCrc = reader.u32();
+        if (compressed() ? m_payload > MaxCompressedBlock : m_payload != m_count * m_layout.size())
+        {
+            throw std::runtime_error("Corrupted record file block size");
+        }
+        m_stats.clear();
+        if (m_version >= 2)
+        {
+            uint32_t statsSize = reader.u32();
+            uint32_t statsCrc = reader.u32();
+            if (statsSize > std::min<uint64_t>(MaxCompressedBlock, MaxBlockStatisticsSize(m_zoneMaps.size(), m_count)))
+            {
+                throw std::runtime_error("Corrupted record file block statistics size");
+            }
+            std::vector<char> stats(statsSize);
+            if (statsSize && std::fread(stats.data(), 1, statsSize, m_file) != statsSize)
+            {
+                throw std::runtime_error("Truncated record file block");
+            }
+            if (Crc32(stats.data(), statsSize) != statsCrc)
+            {
+                throw std::runtime_error("Record file block statistics checksum mismatch");
+            }
+            BinaryReader statsReader(stats.data(), stats.size());
+            DeserializeBlockStatistics(statsReader, m_layout, m_zoneMaps, m_stats);
+        }
+        m_inBlock = true;
+        count = m_count;
+        return true;
+    }
+
+    // Статистика текущего блока (в порядке zoneMaps())
+    const std::vector<BlockStatistics>& blockStatistics() const { return m_stats; }
+
+    void readRecords(std::vector<char>& records)
+    {
+        if (!compressed())
+        {
+            readPayload(records);
+        }
+        else
+        {
+            readPayload(m_compressed);
+            CompressedBlock block(m_layout, m_compressed.data(), m_compressed.size());
+            checkCount(block);
+            records.resize(m_count * m_layout.size());
+            block.decodeRecords(records.data());
+        }
+        StructMetrics::instance().bytesDecoded.add(m_count * m_layout.size());
+    }
+
+    // Только выбранные поля текущего блока; в сжатом файле распаковываются только они
+    void readColumns(const std::vector<size_t>& fieldIndices, ColumnSet& columns)
+    {
+        readPayload(m_compressed);
+        if (!compressed())
+        {
+            transpose(m_layout, m_compressed.data(), m_count, fieldIndices, columns);
+        }
+        else
+        {
+            CompressedBlock block(m_layout, m_compressed.data(), m_compressed.size());
+            checkCount(block);
+            block.decode(fieldIndices, columns);
+        }
+        size_t bytes = 0;
+        for (size_t index : fieldIndices) bytes += m_layout.field(index).size;
+        StructMetrics::instance().bytesDecoded.add(m_count * bytes);
+    }
+
+    void skipRecords()
+    {
+        if (!m_inBlock) return;
+        m_inBlock = false;
+        if (std::fseek(m_file, static_cast<long>(m_payload), SEEK_CUR) != 0)
+        {
+            throw std::runtime_error("Unable to seek in record file");
+        }
+    }
+
+    // Следующий блок записей; false - конец файла. Испорченный блок - исключение
+    bool readBlock(std::vector<char>& records, size_t& count)
+    {
+        if (!nextBlock(count)) return false;
+        readRecords(records);
+        return true;
+    }
+
+    // Следующий блок, в котором могут быть записи, подходящие под predicate;
+    // блоки, исключенные статистикой, пропускаются без чтения записей
+    bool readBlock(std::vector<char>& records, size_t& count, const ZonePredicate& predicate)
+    {
+        while (nextBlock(count))
+        {
+            if (predicate.mayMatch(m_stats))
+            {
+                readRecords(records);
+                return true;
+            }
+            skipRecords();
+            ++m_skipped;
+        }
+        return false;
+    }
+
+    // Сколько блоков пропущено по статистике
+    size_t skippedBlocks() const { return m_skipped; }
+
+    // Все оставшиеся записи файла
+    std::vector<char> readAll()
+    {
+        std::vector<char> all, block;
+        size_t count;
+        while (readBlock(block, count))
+        {
+            all.insert(all.end(), block.begin(), block.end());
+        }
+        return all;
+    }
+
+private:
+    RecordFileReader(const RecordFileReader&);
+    RecordFileReader& operator=(const RecordFileReader&);
+
+    enum { MaxCompressedBlock = 1u << 30, MaxHeaderString = 1u << 20 };
+
+    void readPayload(std::vector<char>& payload)
+    {
+        if (!m_inBlock)
+        {
+            throw std::logic_error("No current record file block");
+        }
+        m_inBlock = false;
+        payload.resize(m_payload);
+        if (std::fread(payload.data(), 1, m_payload, m_file) != m_payload)
+        {
+            throw std::runtime_error("Truncated record file block");
+        }
+        if (Crc32(payload.data(), m_payload) != m_payloadCrc)
+        {
+            throw std::runtime_error("Record file block checksum mismatch");
+        }
+    }
+
+    void checkCount(const CompressedBlock& block) const
+    {
+        if (block.count() != m_count)
+        {
+            throw std::runtime_error("Corrupted record file block size");
+        }
+    }
+
+    void readHeader()
+    {
+        std::string header;
+        std::string fixed = readBytes(header, 8);
+        if (std::memcmp(fixed.data(), "SPRF", 4) != 0)
+        {
+            throw std::runtime_error("Not a record file");
+        }
+        BinaryReader fixedReader(fixed.data() + 4, 4);
+        m_version = fixedReader.u16();
+        m_flags = fixedReader.u16();
+        if (m_version < 1 || m_version > RecordFileVersion || (m_flags & ~RecordFileCompressed) != 0)
+        {
+            throw std::runtime_error("Unsupported record file version " + std::to_string(m_version));
+        }
+
+        std::string text = readString(header);
+        std::string blob = readString(header);
+        std::vector<ZoneMapSpec> zoneMaps;
+        if (m_version >= 2)
+        {
+            std::string countBytes = readBytes(header, 4);
+            uint32_t count = BinaryReader(countBytes.data(), 4).u32();
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                ZoneMapSpec spec(readString(header));
+                std::string options = readBytes(header, 9);
+                BinaryReader optionsReader(options.data(), options.size());
+                uint8_t flags = optionsReader.u8();
+                spec.bloom = (flags & 1) != 0;
+                spec.hasSentinel = (flags & 2) != 0;
+                spec.sentinel = static_cast<int64_t>(optionsReader.u64());
+                zoneMaps.push_back(spec);
+            }
+        }
+        std::string unused;
+        std::string crcBytes = readBytes(unused, 4);
+        if (BinaryReader(crcBytes.data(), 4).u32() != Crc32(header.data(), header.size()))
+        {
+            throw std::runtime_error("Record file header checksum mismatch");
+        }
+
+        m_structText = text;
+        BinaryReader layoutReader(blob.data(), blob.size());
+        m_layout = DeserializeLayout(layoutReader);
+        for (const auto& spec : zoneMaps)
+        {
+            if (m_layout.indexOf(spec.field) < 0)
+            {
+                throw std::runtime_error("Record file statistics refer to unknown field: " + spec.field);
+            }
+        }
+        m_zoneMaps = zoneMaps;
+    }
+
+    // Прочитанные байты заголовка добавляются к header для проверки CRC
+    std::string readBytes(std::string& header, size_t size)
+    {
+        std::string value(size, '\0');
+        if (size && std::fread(&value[0], 1, size, m_file) != size)
+        {
+            throw std::runtime_error("Truncated record file header");
+        }
+        header.append(value);
+        return value;
+    }
+
+    // Строка с префиксом длины
+    std::string readString(std::string& header)
+    {
+        std::string lengthBytes = readBytes(header, 4);
+        uint32_t length = BinaryReader(lengthBytes.data(), 4).u32();
+        if (length > MaxHeaderString)
+        {
+            throw std::runtime_error("Corrupted record file header");
+        }
+        return readBytes(header, length);
+    }
+
+    std::FILE* m_file;
+    uint16_t m_version;
+    uint16_t m_flags;
+    std::string m_structText;
+    StructLayout m_layout;
+    std::vector<ZoneMapSpec> m_zoneMaps;
+    std::vector<BlockStatistics> m_stats;
+    std::vector<char> m_compressed;
+    size_t m_count;
+    uint32_t m_payload;
+    uint32_t m_payloadCrc;
+    bool m_inBlock;
+    size_t m_skipped;
+};
+
+#endif // STRUCTRECORDFILE_H
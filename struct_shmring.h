@@ -0,0 +1,337 @@
+#ifndef STRUCTSHMRING_H
+#define STRUCTSHMRING_H
+
+#include "struct_binary.h"
+#include "struct_pipeline.h"
+
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#if !defined(__GNUC__) && !defined(__clang__)
+#error "struct_shmring.h requires GCC-compatible __atomic builtins"
+#endif
+
+// Кольцо записей фиксированного размера в разделяемой памяти: один писатель,
+// несколько читателей, каждый из которых видит все записи (как при чтении из сокета).
+//
+// Память: заголовок | индекс писателя | курсоры читателей | layout (SerializeLayout) | ячейки.
+// Индексы и курсоры лежат на отдельных кеш-линиях. Ячейка - u64 номер + запись;
+// номер n + 1 означает, что в ячейке опубликована запись с номером n.
+// Писатель не перезаписывает ячейку, пока ее не освободили все подключенные читатели,
+// поэтому читатели работают с записью прямо в разделяемой памяти, без копирования.
+// Читатель, завершившийся без detach(), остановит писателя.
+class SharedRecordRing
+{
+public:
+    enum { MaxConsumers = 16 };
+
+    // Новый именованный сегмент (shm_open); capacity округляется до степени двойки
+    static std::unique_ptr<SharedRecordRing> create(const std::string& name, const StructLayout& layout, size_t capacity)
+    {
+        int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Unable to create shared memory segment: " + name);
+        }
+        return initialize(fd, layout, capacity);
+    }
+
+    // Анонимный сегмент (memfd); дескриптор fd() передается другому процессу
+    static std::unique_ptr<SharedRecordRing> createAnonymous(const StructLayout& layout, size_t capacity)
+    {
+#ifdef __linux__
+        int fd = static_cast<int>(::syscall(SYS_memfd_create, "struct_record_ring", 0));
+#else
+        int fd = -1;
+#endif
+        if (fd < 0)
+        {
+            throw std::runtime_error("Unable to create anonymous shared memory");
+        }
+        return initialize(fd, layout, capacity);
+    }
+
+    static std::unique_ptr<SharedRecordRing> open(const std::string& name)
+    {
+        int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Unable to open shared memory segment: " + name);
+        }
+        return attachFd(fd);
+    }
+
+    // Подключение к сегменту по дескриптору (дескриптор переходит во владение кольца)
+    static std::unique_ptr<SharedRecordRing> attachFd(int fd)
+    {
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < HeaderBytes)
+        {
+            ::close(fd);
+            throw std::runtime_error("Not a shared record ring");
+        }
+        return std::unique_ptr<SharedRecordRing>(new SharedRecordRing(fd, static_cast<size_t>(info.st_size)));
+    }
+
+    static void unlink(const std::string& name)
+    {
+        ::shm_unlink(name.c_str());
+    }
+
+    ~SharedRecordRing()
+    {
+        ::munmap(m_base, m_size);
+        ::close(m_fd);
+    }
+
+    int fd() const { return m_fd; }
+    const StructLayout& layout() const { return m_layout; }
+    size_t capacity() const { return static_cast<size_t>(header()->capacity); }
+
+    // --- Писатель ---
+
+    // Место под следующую запись или nullptr, если кольцо заполнено
+    char* tryClaim()
+    {
+        uint64_t next = load(&header()->writeIndex);
+        uint64_t capacity = header()->capacity;
+        if (next >= m_gate + capacity)
+        {
+            m_gate = slowestConsumer(next);
+            if (next >= m_gate + capacity) return nullptr;
+        }
+        m_claimed = next;
+        return record(slot(next));
+    }
+
+    // Ожидание свободной ячейки
+    char* claim()
+    {
+        unsigned spins = 0;
+        char* result;
+        while (!(result = tryClaim())) PipelineBackoff(spins);
+        return result;
+    }
+
+    // Публикация записи, заполненной после claim()/tryClaim()
+    void publish()
+    {
+        __atomic_store_n(sequence(slot(m_claimed)), m_claimed + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&header()->writeIndex, m_claimed + 1, __ATOMIC_RELEASE);
+    }
+
+    void push(const char* source)
+    {
+        std::memcpy(claim(), source, m_layout.size());
+        publish();
+    }
+
+    // --- Читатели ---
+
+    // Номер читателя; чтение начинается со следующей опубликованной записи
+    int attach()
+    {
+        for (int c = 0; c < MaxConsumers; ++c)
+        {
+            ConsumerLine* line = consumer(c);
+            uint64_t expected = 0;
+            if (__atomic_compare_exchange_n(&line->active, &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                __atomic_store_n(&line->cursor, load(&header()->writeIndex), __ATOMIC_RELEASE);
+                return c;
+            }
+        }
+        throw std::runtime_error("Too many shared record ring consumers");
+    }
+
+    void detach(int consumerId)
+    {
+        __atomic_store_n(&consumer(consumerId)->active, 0, __ATOMIC_RELEASE);
+    }
+
+    // Текущая запись читателя прямо в разделяемой памяти или nullptr, если новых нет.
+    // Запись действительна до release()
+    const char* tryPeek(int consumerId) const
+    {
+        uint64_t cursor = __atomic_load_n(&consumer(consumerId)->cursor, __ATOMIC_RELAXED);
+        char* s = slot(cursor);
+        if (__atomic_load_n(sequence(s), __ATOMIC_ACQUIRE) != cursor + 1) return nullptr;
+        return record(s);
+    }
+
+    const char* peek(int consumerId) const
+    {
+        unsigned spins = 0;
+        const char* result;
+        while (!(result = tryPeek(consumerId))) PipelineBackoff(spins);
+        return result;
+    }
+
+    // Переход к следующей записи: ячейка возвращается писателю
+    void release(int consumerId)
+    {
+        ConsumerLine* line = consumer(consumerId);
+        __atomic_store_n(&line->cursor, line->cursor + 1, __ATOMIC_RELEASE);
+    }
+
+private:
+    enum
+    {
+        Magic = 0x52525053,     // "SPRR"
+        Version = 1,
+        CacheLine = PipelineCacheLine,
+        HeaderBytes = CacheLine * (2 + MaxConsumers)
+    };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t recordSize;
+        uint64_t capacity;
+        uint64_t slotStride;
+        uint64_t layoutOffset;
+        uint64_t layoutBytes;
+        uint64_t slotsOffset;
+        char pad[CacheLine - 7 * sizeof(uint64_t)];
+        uint64_t writeIndex;    // на отдельной кеш-линии
+    };
+
+    struct ConsumerLine
+    {
+        uint64_t cursor;
+        uint64_t active;
+        char pad[CacheLine - 2 * sizeof(uint64_t)];
+    };
+
+    static size_t roundUp(size_t value, size_t unit) { return (value + unit - 1) / unit * unit; }
+
+    static std::unique_ptr<SharedRecordRing> initialize(int fd, const StructLayout& layout, size_t capacity)
+    {
+        size_t rounded = 1;
+        while (rounded < capacity) rounded <<= 1;
+        std::string blob;
+        SerializeLayout(layout, blob);
+
+        size_t layoutOffset = HeaderBytes;
+        size_t slotsOffset = roundUp(layoutOffset + blob.size(), CacheLine);
+        size_t stride = roundUp(sizeof(uint64_t) + layout.size(), sizeof(uint64_t));
+        size_t total = slotsOffset + rounded * stride;
+        if (layout.size() == 0 || ::ftruncate(fd, static_cast<off_t>(total)) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Unable to size shared record ring");
+        }
+        void* base = ::mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("Unable to map shared record ring");
+        }
+
+        // Новый сегмент заполнен нулями: все номера ячеек 0, читателей нет
+        char* bytes = static_cast<char*>(base);
+        std::memcpy(bytes + layoutOffset, blob.data(), blob.size());
+        Header* h = reinterpret_cast<Header*>(bytes);
+        h->version = Version;
+        h->recordSize = layout.size();
+        h->capacity = rounded;
+        h->slotStride = stride;
+        h->layoutOffset = layoutOffset;
+        h->layoutBytes = blob.size();
+        h->slotsOffset = slotsOffset;
+        __atomic_store_n(&h->magic, static_cast<uint32_t>(Magic), __ATOMIC_RELEASE);
+        ::munmap(base, total);
+        return std::unique_ptr<SharedRecordRing>(new SharedRecordRing(fd, total));
+    }
+
+    SharedRecordRing(int fd, size_t size) : m_fd(fd), m_size(size), m_gate(0), m_claimed(0)
+    {
+        void* base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("Unable to map shared record ring");
+        }
+        m_base = static_cast<char*>(base);
+        const Header* h = header();
+        if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != Magic || h->version != Version ||
+            h->layoutOffset + h->layoutBytes > size || h->capacity == 0 || (h->capacity & (h->capacity - 1)) != 0 ||
+            h->slotStride < sizeof(uint64_t) + h->recordSize || h->slotStride % sizeof(uint64_t) != 0 || h->slotsOffset + h->capacity * h->slotStride > size)
+        {
+            ::munmap(m_base, m_size);
+            ::close(fd);
+            throw std::runtime_error("Not a shared record ring");
+        }
+        try
+        {
+            BinaryReader reader(m_base + h->layoutOffset, static_cast<size_t>(h->layoutBytes));
+            m_layout = DeserializeLayout(reader);
+        }
+        catch (...)
+        {
+            ::munmap(m_base, m_size);
+            ::close(fd);
+            throw;
+        }
+        m_mask = h->capacity - 1;
+    }
+
+    SharedRecordRing(const SharedRecordRing&);
+    SharedRecordRing& operator=(const SharedRecordRing&);
+
+    Header* header() const { return reinterpret_cast<Header*>(m_base); }
+
+    ConsumerLine* consumer(int id) const
+    {
+        if (id < 0 || id >= MaxConsumers)
+        {
+            throw std::invalid_argument("Invalid shared record ring consumer");
+        }
+        return reinterpret_cast<ConsumerLine*>(m_base + 2 * CacheLine) + id;
+    }
+
+    char* slot(uint64_t index) const
+    {
+        return m_base + header()->slotsOffset + (index & m_mask) * header()->slotStride;
+    }
+
+    static uint64_t* sequence(char* s) { return reinterpret_cast<uint64_t*>(s); }
+    static char* record(char* s) { return s + sizeof(uint64_t); }
+    static uint64_t load(const uint64_t* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+
+    // Курсор самого отстающего читателя (или next, если читателей нет)
+    uint64_t slowestConsumer(uint64_t next) const
+    {
+        uint64_t slowest = next;
+        for (int c = 0; c < MaxConsumers; ++c)
+        {
+            const ConsumerLine* line = consumer(c);
+            if (!load(&line->active)) continue;
+            uint64_t cursor = load(&line->cursor);
+            if (cursor < slowest) slowest = cursor;
+        }
+        return slowest;
+    }
+
+    int m_fd;
+    size_t m_size;
+    char* m_base;
+    uint64_t m_mask;
+    uint64_t m_gate;        // кешированный курсор самого медленного читателя
+    uint64_t m_claimed;
+    StructLayout m_layout;
+};
+
+#endif // STRUCTSHMRING_H
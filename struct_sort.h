@@ -0,0 +1,269 @@
+#ifndef STRUCTSORT_H
+#define STRUCTSORT_H
+
+#include "struct_layout.h"
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+
+// Перестановка байт значения размером size (1, 2, 4 или 8 байт)
+inline uint64_t SwapBytes(uint64_t value, size_t size)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    switch (size)
+    {
+    case 1: return value;
+    case 2: return __builtin_bswap16(static_cast<uint16_t>(value));
+    case 4: return __builtin_bswap32(static_cast<uint32_t>(value));
+    default: return __builtin_bswap64(value);
+    }
+#else
+    uint64_t result = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        result = (result << 8) | ((value >> (8 * i)) & 0xFF);
+    }
+    return result;
+#endif
+}
+
+// Поле, по которому сортируются записи
+struct SortKey
+{
+    std::string field;
+    bool bigEndian;     // значение хранится в сетевом порядке байт
+    bool descending;
+
+    SortKey(const std::string& fieldName, bool isBigEndian = false, bool isDescending = false)
+        : field(fieldName), bigEndian(isBigEndian), descending(isDescending) {}
+};
+
+// Сортировка записей по полю layout.
+// Ключ каждой записи приводится к беззнаковому виду с тем же порядком
+// (у знаковых инвертируется бит знака, у float/double - по правилам IEEE),
+// затем пары (ключ, номер записи) сортируются LSD radix sort по байтам ключа,
+// и записи целиком переставляются одним проходом
+class RecordSorter
+{
+public:
+    RecordSorter(const StructLayout& layout, const SortKey& key)
+        : m_layout(layout), m_key(key), m_field(layout.field(layout.fieldIndex(key.field)))
+    {
+    }
+
+    // Нормализованный ключ записи: сравнение ключей как uint64_t дает нужный порядок
+    uint64_t key(const char* record) const
+    {
+        const StructLayout::Field& f = m_field;
+        uint64_t raw = StructLayout::loadUnit(record + f.byteOffset, f.size);
+        if (m_key.bigEndian)
+        {
+            raw = SwapBytes(raw, f.size);
+        }
+        uint64_t bits = f.isBitField ? (raw >> f.bitOffset) & f.mask : raw;
+        uint64_t sign = 1ULL << (f.bitWidth - 1);
+        switch (f.kind)
+        {
+        case StructLayout::SignedValue:
+            bits ^= sign;
+            break;
+        case StructLayout::FloatValue:
+        case StructLayout::DoubleValue:
+            bits = (bits & sign) ? ~bits & f.mask : bits | sign;
+            break;
+        default:
+            break;
+        }
+        return m_key.descending ? ~bits & f.mask : bits;
+    }
+
+    // Отсортированная копия records в out (out не должен пересекаться с records)
+    void sort(const char* records, size_t count, char* out) const
+    {
+        std::vector<size_t> order;
+        sortedOrder(records, count, order);
+        size_t recordSize = m_layout.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::memcpy(out + i * recordSize, records + order[i] * recordSize, recordSize);
+        }
+    }
+
+    void sort(char* records, size_t count) const
+    {
+        std::vector<char> sorted(count * m_layout.size());
+        sort(records, count, sorted.data());
+        std::memcpy(records, sorted.data(), sorted.size());
+    }
+
+    // Порядок записей после сортировки (сортировка устойчивая)
+    void sortedOrder(const char* records, size_t count, std::vector<size_t>& order) const
+    {
+        std::vector<uint64_t> keys(count), keysTmp(count);
+        std::vector<size_t> orderTmp(count);
+        order.resize(count);
+        size_t recordSize = m_layout.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            keys[i] = key(records + i * recordSize);
+            order[i] = i;
+        }
+
+        // Гистограммы всех байтов ключа за один проход
+        size_t passes = (m_field.bitWidth + 7) / 8;
+        std::vector<size_t> counts(passes * 256, 0);
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (size_t p = 0; p < passes; ++p)
+            {
+                ++counts[p * 256 + ((keys[i] >> (8 * p)) & 0xFF)];
+            }
+        }
+
+        for (size_t p = 0; p < passes; ++p)
+        {
+            size_t* histogram = counts.data() + p * 256;
+            // Байт одинаков у всех записей - проход ничего не меняет
+            if (count == 0 || histogram[(keys[0] >> (8 * p)) & 0xFF] == count) continue;
+
+            size_t offset = 0;
+            for (size_t b = 0; b < 256; ++b)
+            {
+                size_t c = histogram[b];
+                histogram[b] = offset;
+                offset += c;
+            }
+            for (size_t i = 0; i < count; ++i)
+            {
+                size_t slot = histogram[(keys[i] >> (8 * p)) & 0xFF]++;
+                keysTmp[slot] = keys[i];
+                orderTmp[slot] = order[i];
+            }
+            keys.swap(keysTmp);
+            order.swap(orderTmp);
+        }
+    }
+
+    // Внешняя сортировка файла, не помещающегося в память: куски по memoryLimit
+    // байт сортируются и сбрасываются во временные файлы, затем сливаются k-way слиянием
+    void sortFile(std::FILE* in, std::FILE* out, size_t memoryLimit = 256u << 20) const
+    {
+        size_t recordSize = m_layout.size();
+        // На запись куска приходятся исходник, отсортированная копия, ключ и номера
+        size_t runRecords = std::max<size_t>(1, memoryLimit / (2 * recordSize + 3 * sizeof(uint64_t)));
+        std::vector<char> chunk(runRecords * recordSize), sorted(runRecords * recordSize);
+        std::vector<std::unique_ptr<std::FILE, int (*)(std::FILE*)> > runs;
+
+        size_t count;
+        while ((count = std::fread(chunk.data(), recordSize, runRecords, in)) > 0)
+        {
+            sort(chunk.data(), count, sorted.data());
+            if (runs.empty() && count < runRecords)
+            {
+                // Все поместилось в память - временные файлы не нужны
+                writeAll(sorted.data(), recordSize, count, out);
+                return;
+            }
+            std::unique_ptr<std::FILE, int (*)(std::FILE*)> run(std::tmpfile(), &std::fclose);
+            if (!run)
+            {
+                throw std::runtime_error("Unable to create temporary file for sort run");
+            }
+            writeAll(sorted.data(), recordSize, count, run.get());
+            std::rewind(run.get());
+            runs.push_back(std::move(run));
+        }
+        chunk.clear();
+        chunk.shrink_to_fit();
+        sorted.clear();
+        sorted.shrink_to_fit();
+
+        merge(runs, out, memoryLimit);
+    }
+
+private:
+    // Буферизованное чтение одного отсортированного куска
+    struct RunReader
+    {
+        std::FILE* file;
+        std::vector<char> buffer;
+        size_t recordSize;
+        size_t count;
+        size_t position;
+    };
+
+    static void writeAll(const char* data, size_t recordSize, size_t count, std::FILE* file)
+    {
+        if (std::fwrite(data, recordSize, count, file) != count)
+        {
+            throw std::runtime_error("Unable to write sorted records");
+        }
+    }
+
+    static bool refill(RunReader& reader)
+    {
+        reader.count = std::fread(reader.buffer.data(), reader.recordSize, reader.buffer.size() / reader.recordSize,
+                                  reader.file);
+        reader.position = 0;
+        return reader.count > 0;
+    }
+
+    void merge(std::vector<std::unique_ptr<std::FILE, int (*)(std::FILE*)> >& runs, std::FILE* out,
+               size_t memoryLimit) const
+    {
+        if (runs.empty()) return;     // пустой вход: нечего сливать
+        size_t recordSize = m_layout.size();
+        size_t perRun = std::max<size_t>(1, memoryLimit / ((runs.size() + 1) * recordSize));
+        std::vector<RunReader> readers(runs.size());
+
+        // Куча по (ключ, номер куска): при равных ключах раньше идет более ранний кусок,
+        // поэтому слияние сохраняет устойчивость сортировки
+        typedef std::pair<uint64_t, size_t> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > heap;
+        for (size_t r = 0; r < runs.size(); ++r)
+        {
+            readers[r].file = runs[r].get();
+            readers[r].recordSize = recordSize;
+            readers[r].buffer.resize(perRun * recordSize);
+            if (refill(readers[r]))
+            {
+                heap.push(Entry(key(readers[r].buffer.data()), r));
+            }
+        }
+
+        std::vector<char> output(perRun * recordSize);
+        size_t pending = 0;
+        while (!heap.empty())
+        {
+            size_t r = heap.top().second;
+            heap.pop();
+            RunReader& reader = readers[r];
+            std::memcpy(output.data() + pending * recordSize,
+                        reader.buffer.data() + reader.position * recordSize, recordSize);
+            if (++pending == perRun)
+            {
+                writeAll(output.data(), recordSize, pending, out);
+                pending = 0;
+            }
+            if (++reader.position < reader.count || refill(reader))
+            {
+                heap.push(Entry(key(reader.buffer.data() + reader.position * recordSize), r));
+            }
+        }
+        writeAll(output.data(), recordSize, pending, out);
+    }
+
+    const StructLayout& m_layout;
+    SortKey m_key;
+    StructLayout::Field m_field;
+};
+
+#endif // STRUCTSORT_H
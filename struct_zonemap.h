@@ -0,0 +1,404 @@
+#ifndef STRUCTZONEMAP_H
+#define STRUCTZONEMAP_H
+
+#include "struct_binary.h"
+#include "struct_aggregate.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+
+// Какую статистику блока собирать для поля
+struct ZoneMapSpec
+{
+    std::string field;
+    bool bloom;          // фильтр Блума по значениям (для полей-идентификаторов)
+    bool hasSentinel;    // значение sentinel считается "пустым" и не входит в min/max
+    int64_t sentinel;
+
+    ZoneMapSpec(const std::string& fieldName, bool withBloom = false)
+        : field(fieldName), bloom(withBloom), hasSentinel(false), sentinel(0) {}
+
+    ZoneMapSpec& withSentinel(int64_t value)
+    {
+        hasSentinel = true;
+        sentinel = value;
+        return *this;
+    }
+};
+
+// Статистика одного поля в одном блоке записей.
+// Если в блоке нет значений, кроме sentinel, min > max.
+// Беззнаковые поля сравниваются как беззнаковые (uintMin/uintMax), иначе
+// значения от 2^63 переворачивают диапазон
+struct BlockStatistics
+{
+    size_t fieldIndex;
+    bool isReal;
+    bool isUnsigned;
+    int64_t intMin, intMax;
+    uint64_t uintMin, uintMax;
+    double realMin, realMax;
+    bool hasSentinel;
+    int64_t sentinel;
+    uint64_t sentinelCount;
+    std::vector<uint64_t> bloom;    // пустой - фильтра нет
+
+    enum { BloomBitsPerValue = 10, BloomProbes = 3 };
+
+    bool isEmpty() const
+    {
+        return isReal ? !(realMin <= realMax) : isUnsigned ? uintMin > uintMax : intMin > intMax;
+    }
+
+    // false - значения в блоке точно нет, true - возможно есть
+    bool mayContain(uint64_t valueBits) const
+    {
+        if (bloom.empty()) return true;
+        uint64_t bits = bloom.size() * 64;
+        uint64_t h1 = MixBits(valueBits);
+        uint64_t h2 = MixBits(h1) | 1;
+        for (int k = 0; k < BloomProbes; ++k)
+        {
+            uint64_t bit = (h1 + k * h2) & (bits - 1);
+            if (!(bloom[bit >> 6] & (1ULL << (bit & 63)))) return false;
+        }
+        return true;
+    }
+
+    void addToBloom(uint64_t valueBits)
+    {
+        uint64_t bits = bloom.size() * 64;
+        uint64_t h1 = MixBits(valueBits);
+        uint64_t h2 = MixBits(h1) | 1;
+        for (int k = 0; k < BloomProbes; ++k)
+        {
+            uint64_t bit = (h1 + k * h2) & (bits - 1);
+            bloom[bit >> 6] |= 1ULL << (bit & 63);
+        }
+    }
+};
+
+// Биты вещественного значения для фильтра Блума: -0.0 приводится к +0.0,
+// иначе равные значения дают разные биты
+inline uint64_t ZoneRealBits(double value)
+{
+    if (value == 0) value = 0;
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Биты значения поля, по которым строится фильтр Блума
+inline uint64_t ZoneValueBits(const StructLayout& layout, size_t index, const char* record)
+{
+    StructLayout::ValueKind kind = layout.field(index).kind;
+    if (kind == StructLayout::FloatValue || kind == StructLayout::DoubleValue)
+    {
+        return ZoneRealBits(layout.readDouble(index, record));
+    }
+    return static_cast<uint64_t>(layout.readInt(index, record));
+}
+
+// Подсчет статистики по выбранным полям блока записей
+inline void ComputeBlockStatistics(const StructLayout& layout, const std::vector<ZoneMapSpec>& specs,
+                                   const char* records, size_t count, std::vector<BlockStatistics>& out)
+{
+    size_t recordSize = layout.size();
+    out.resize(specs.size());
+    for (size_t s = 0; s < specs.size(); ++s)
+    {
+        const ZoneMapSpec& spec = specs[s];
+        BlockStatistics& stats = out[s];
+        stats.fieldIndex = layout.fieldIndex(spec.field);
+        StructLayout::ValueKind kind = layout.field(stats.fieldIndex).kind;
+        stats.isReal = kind == StructLayout::FloatValue || kind == StructLayout::DoubleValue;
+        stats.isUnsigned = kind == StructLayout::UnsignedValue;
+        stats.intMin = std::numeric_limits<int64_t>::max();
+        stats.intMax = std::numeric_limits<int64_t>::min();
+        stats.uintMin = std::numeric_limits<uint64_t>::max();
+        stats.uintMax = 0;
+        stats.realMin = std::numeric_limits<double>::infinity();
+        stats.realMax = -std::numeric_limits<double>::infinity();
+        stats.hasSentinel = spec.hasSentinel;
+        stats.sentinel = spec.sentinel;
+        stats.sentinelCount = 0;
+        stats.bloom.clear();
+        if (spec.bloom)
+        {
+            size_t bits = 64;
+            while (bits < count * BlockStatistics::BloomBitsPerValue) bits <<= 1;
+            stats.bloom.assign(bits / 64, 0);
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const char* record = records + i * recordSize;
+            if (stats.isReal)
+            {
+                double value = layout.readDouble(stats.fieldIndex, record);
+                if (spec.hasSentinel && value == static_cast<double>(spec.sentinel))
+                {
+                    ++stats.sentinelCount;
+                }
+                else
+                {
+                    stats.realMin = std::min(stats.realMin, value);
+                    stats.realMax = std::max(stats.realMax, value);
+                }
+            }
+            else
+            {
+                int64_t value = layout.readInt(stats.fieldIndex, record);
+                if (spec.hasSentinel && value == spec.sentinel)
+                {
+                    ++stats.sentinelCount;
+                }
+                else if (stats.isUnsigned)
+                {
+                    stats.uintMin = std::min(stats.uintMin, static_cast<uint64_t>(value));
+                    stats.uintMax = std::max(stats.uintMax, static_cast<uint64_t>(value));
+                }
+                else
+                {
+                    stats.intMin = std::min(stats.intMin, value);
+                    stats.intMax = std::max(stats.intMax, value);
+                }
+            }
+            if (spec.bloom)
+            {
+                stats.addToBloom(ZoneValueBits(layout, stats.fieldIndex, record));
+            }
+        }
+    }
+}
+
+inline void SerializeBlockStatistics(const std::vector<BlockStatistics>& stats, std::string& out)
+{
+    BinaryWriter writer(out);
+    for (const auto& s : stats)
+    {
+        uint64_t low, high;
+        if (s.isReal)
+        {
+            std::memcpy(&low, &s.realMin, sizeof(low));
+            std::memcpy(&high, &s.realMax, sizeof(high));
+        }
+        else if (s.isUnsigned)
+        {
+            low = s.uintMin;
+            high = s.uintMax;
+        }
+        else
+        {
+            low = static_cast<uint64_t>(s.intMin);
+            high = static_cast<uint64_t>(s.intMax);
+        }
+        writer.u64(low);
+        writer.u64(high);
+        writer.u64(s.sentinelCount);
+        writer.u32(static_cast<uint32_t>(s.bloom.size()));
+        for (uint64_t word : s.bloom) writer.u64(word);
+    }
+}
+
+// Наибольший размер сериализованной статистики блока из count записей по specCount
+// описаниям (все с bloom-фильтром): для проверки размера, прочитанного из файла
+inline uint64_t MaxBlockStatisticsSize(size_t specCount, uint64_t count)
+{
+    uint64_t bits = 64;
+    while (bits < count * BlockStatistics::BloomBitsPerValue) bits <<= 1;
+    return specCount * (3 * 8 + 4 + bits / 8);
+}
+
+// Разбор статистики блока; индекс поля и sentinel берутся из описания статистики файла
+inline void DeserializeBlockStatistics(BinaryReader& reader, const StructLayout& layout,
+                                       const std::vector<ZoneMapSpec>& specs, std::vector<BlockStatistics>& out)
+{
+    out.resize(specs.size());
+    for (size_t s = 0; s < specs.size(); ++s)
+    {
+        BlockStatistics& stats = out[s];
+        stats.fieldIndex = layout.fieldIndex(specs[s].field);
+        StructLayout::ValueKind kind = layout.field(stats.fieldIndex).kind;
+        stats.isReal = kind == StructLayout::FloatValue || kind == StructLayout::DoubleValue;
+        stats.isUnsigned = kind == StructLayout::UnsignedValue;
+        stats.hasSentinel = specs[s].hasSentinel;
+        stats.sentinel = specs[s].sentinel;
+        uint64_t low = reader.u64();
+        uint64_t high = reader.u64();
+        if (stats.isReal)
+        {
+            std::memcpy(&stats.realMin, &low, sizeof(low));
+            std::memcpy(&stats.realMax, &high, sizeof(high));
+        }
+        else
+        {
+            stats.intMin = static_cast<int64_t>(low);
+            stats.intMax = static_cast<int64_t>(high);
+            stats.uintMin = low;
+            stats.uintMax = high;
+        }
+        stats.sentinelCount = reader.u64();
+        uint32_t words = reader.u32();
+        if (words > reader.remaining() / 8 || (words & (words - 1)) != 0)
+        {
+            throw std::runtime_error("Corrupted block statistics");
+        }
+        stats.bloom.resize(words);
+        for (auto& word : stats.bloom) word = reader.u64();
+    }
+}
+
+// Условие на блок: конъюнкция диапазонов и равенств по полям.
+// Блок пропускается, только если статистика доказывает, что подходящих записей в нем нет
+class ZonePredicate
+{
+public:
+    explicit ZonePredicate(const StructLayout& layout) : m_layout(layout) {}
+
+    // low <= поле <= high
+    ZonePredicate& between(const std::string& fieldName, int64_t low, int64_t high)
+    {
+        Condition c = makeCondition(fieldName, false);
+        c.intLow = low;
+        c.intHigh = high;
+        c.realLow = static_cast<double>(low);
+        c.realHigh = static_cast<double>(high);
+        // Отрицательные значения беззнаковому полю не подходят
+        c.uintLow = low < 0 ? 0 : static_cast<uint64_t>(low);
+        c.uintHigh = static_cast<uint64_t>(high);
+        if (high < 0) noUnsignedMatch(c);
+        m_conditions.push_back(c);
+        return *this;
+    }
+
+    // Границы во всем диапазоне uint64 (для беззнаковых полей от 2^63)
+    ZonePredicate& betweenUnsigned(const std::string& fieldName, uint64_t low, uint64_t high)
+    {
+        Condition c = makeCondition(fieldName, false);
+        c.uintLow = low;
+        c.uintHigh = high;
+        c.realLow = static_cast<double>(low);
+        c.realHigh = static_cast<double>(high);
+        c.intLow = low > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())
+            ? std::numeric_limits<int64_t>::max() : static_cast<int64_t>(low);
+        c.intHigh = high > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())
+            ? std::numeric_limits<int64_t>::max() : static_cast<int64_t>(high);
+        if (low > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) c.intHigh = c.intLow - 1;
+        m_conditions.push_back(c);
+        return *this;
+    }
+
+    ZonePredicate& betweenReal(const std::string& fieldName, double low, double high)
+    {
+        const double Two64 = 18446744073709551616.0;
+        Condition c = makeCondition(fieldName, false);
+        c.realLow = low;
+        c.realHigh = high;
+        c.intLow = low <= -9.2e18 ? std::numeric_limits<int64_t>::min() : static_cast<int64_t>(std::ceil(low));
+        c.intHigh = high >= 9.2e18 ? std::numeric_limits<int64_t>::max() : static_cast<int64_t>(std::floor(high));
+        c.uintLow = low <= 0 ? 0 : low >= Two64 ? std::numeric_limits<uint64_t>::max() : static_cast<uint64_t>(std::ceil(low));
+        c.uintHigh = high >= Two64 ? std::numeric_limits<uint64_t>::max() : high < 0 ? 0 : static_cast<uint64_t>(std::floor(high));
+        if (high < 0 || low >= Two64) noUnsignedMatch(c);
+        m_conditions.push_back(c);
+        return *this;
+    }
+
+    // поле == value (использует фильтр Блума, если он есть)
+    ZonePredicate& equals(const std::string& fieldName, int64_t value)
+    {
+        Condition c = makeCondition(fieldName, true);
+        c.intLow = c.intHigh = value;
+        c.realLow = c.realHigh = static_cast<double>(value);
+        c.uintLow = c.uintHigh = static_cast<uint64_t>(value);
+        if (value < 0) noUnsignedMatch(c);
+        m_conditions.push_back(c);
+        return *this;
+    }
+
+    ZonePredicate& equalsUnsigned(const std::string& fieldName, uint64_t value)
+    {
+        betweenUnsigned(fieldName, value, value);
+        m_conditions.back().equality = true;
+        return *this;
+    }
+
+    bool empty() const { return m_conditions.empty(); }
+
+    // Может ли в блоке с такой статистикой найтись подходящая запись
+    bool mayMatch(const std::vector<BlockStatistics>& stats) const
+    {
+        for (const auto& c : m_conditions)
+        {
+            bool possible = true;
+            for (size_t s = 0; s < stats.size() && possible; ++s)
+            {
+                if (stats[s].fieldIndex != c.fieldIndex) continue;
+                possible = mayMatch(c, stats[s]);
+            }
+            if (!possible) return false;
+        }
+        return true;
+    }
+
+private:
+    struct Condition
+    {
+        size_t fieldIndex;
+        bool equality;
+        int64_t intLow, intHigh;
+        uint64_t uintLow, uintHigh;     // для беззнаковых полей; low > high - ничего не подходит
+        double realLow, realHigh;
+    };
+
+    Condition makeCondition(const std::string& fieldName, bool equality) const
+    {
+        Condition c;
+        c.fieldIndex = m_layout.fieldIndex(fieldName);
+        c.equality = equality;
+        return c;
+    }
+
+    static void noUnsignedMatch(Condition& c)
+    {
+        c.uintLow = 1;
+        c.uintHigh = 0;
+    }
+
+    static bool mayMatch(const Condition& c, const BlockStatistics& stats)
+    {
+        bool sentinelMatches = false;
+        if (stats.hasSentinel && stats.sentinelCount > 0)
+        {
+            int64_t sentinel = stats.sentinel;
+            uint64_t usentinel = static_cast<uint64_t>(sentinel);
+            sentinelMatches = stats.isReal
+                ? c.realLow <= static_cast<double>(sentinel) && static_cast<double>(sentinel) <= c.realHigh
+                : stats.isUnsigned ? c.uintLow <= usentinel && usentinel <= c.uintHigh
+                                   : c.intLow <= sentinel && sentinel <= c.intHigh;
+        }
+        bool rangeMatches = !stats.isEmpty() &&
+            (stats.isReal ? c.realLow <= stats.realMax && stats.realMin <= c.realHigh
+             : stats.isUnsigned ? c.uintLow <= c.uintHigh && c.uintLow <= stats.uintMax && stats.uintMin <= c.uintHigh
+                                : c.intLow <= stats.intMax && stats.intMin <= c.intHigh);
+        if (!sentinelMatches && !rangeMatches) return false;
+        if (c.equality)
+        {
+            uint64_t bits = stats.isReal ? ZoneRealBits(c.realLow)
+                          : stats.isUnsigned ? c.uintLow : static_cast<uint64_t>(c.intLow);
+            return stats.mayContain(bits);
+        }
+        return true;
+    }
+
+    const StructLayout& m_layout;
+    std::vector<Condition> m_conditions;
+};
+
+#endif // STRUCTZONEMAP_H
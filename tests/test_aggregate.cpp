@@ -0,0 +1,128 @@
+#include "test_common.h"
+#include "../struct_aggregate.h"
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+
+namespace
+{
+
+const char* const RecordText =
+    "struct Reading { uint64_t serial; int16_t temp; uint8_t sensor : 4; uint8_t state : 4; double value; };";
+
+std::vector<std::string> AllFields()
+{
+    std::vector<std::string> names;
+    names.push_back("serial");
+    names.push_back("temp");
+    names.push_back("sensor");
+    names.push_back("value");
+    return names;
+}
+
+std::vector<char> MakeRecords(const StructLayout& layout, size_t count)
+{
+    std::vector<char> records(count * layout.size());
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        // Половина серийных номеров выше 2^63
+        layout.writeBits(0, (r % 2 ? 0x8000000000000000ULL : 0) + r + 10, record);
+        layout.writeInt(1, static_cast<int64_t>(r % 200) - 100, record);
+        layout.writeInt(2, static_cast<int64_t>(r % 10), record);
+        layout.writeDouble(4, static_cast<double>(r % 100) / 2, record);
+    }
+    return records;
+}
+
+} // namespace
+
+TEST(UnsignedMinMaxAboveInt64Max)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records = MakeRecords(layout, 1000);
+    Aggregation aggregation(layout, AllFields(), 1);
+    aggregation.add(records.data(), 1000);
+    const FieldAggregate& serial = aggregation.result("serial");
+    CHECK_EQ(10u, serial.uintMin);
+    CHECK_EQ(0x8000000000000000ULL + 999 + 10, serial.uintMax);
+    CHECK_EQ(10.0, serial.min());
+    CHECK(serial.max() > 9.2e18);
+}
+
+TEST(SignedRealAndDenseStatistics)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records = MakeRecords(layout, 1000);
+    Aggregation aggregation(layout, AllFields(), 1);
+    aggregation.setHistogram("value", 0, 25, 5);
+    aggregation.add(records.data(), 1000);
+
+    const FieldAggregate& temp = aggregation.result("temp");
+    CHECK_EQ(1000u, temp.count);
+    CHECK_EQ(-100, temp.intMin);
+    CHECK_EQ(99, temp.intMax);
+    CHECK_EQ(-500.0, temp.sum());
+
+    const FieldAggregate& sensor = aggregation.result("sensor");
+    CHECK(sensor.isDense());
+    CHECK_EQ(10u, sensor.distinct());
+    CHECK_EQ(100u, sensor.valueCount(3));
+    CHECK_EQ(0u, sensor.valueCount(12));
+
+    const FieldAggregate& value = aggregation.result("value");
+    CHECK_EQ(0.0, value.min());
+    CHECK_EQ(49.5, value.max());
+    CHECK_EQ(24.75, value.mean());
+    CHECK_EQ(5u, value.histogram.size());
+    CHECK_EQ(100u, value.histogram[0]);     // значения 0..4.5
+    CHECK_EQ(500u, value.overflow);
+    CHECK_EQ(0u, value.underflow);
+
+    // 1000 различных серийных номеров: оценка HyperLogLog с погрешностью в несколько процентов
+    uint64_t distinct = aggregation.result("serial").distinct();
+    CHECK(distinct > 950 && distinct < 1050);
+    CHECK_THROWS(std::invalid_argument, aggregation.result("state"));
+    CHECK_THROWS(std::invalid_argument, aggregation.setHistogram("value", 1, 1, 4));
+}
+
+TEST(ThreadedMatchesSingleThreaded)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 300000;    // несколько потоков по MinRecordsPerThread записей
+    std::vector<char> records = MakeRecords(layout, count);
+    Aggregation single(layout, AllFields(), 1);
+    Aggregation threaded(layout, AllFields(), 4);
+    single.add(records.data(), count);
+    threaded.add(records.data(), count);
+    for (size_t i = 0; i < single.results().size(); ++i)
+    {
+        const FieldAggregate& a = single.results()[i];
+        const FieldAggregate& b = threaded.results()[i];
+        CHECK_EQ(a.count, b.count);
+        CHECK_EQ(a.sum(), b.sum());
+        CHECK_EQ(a.min(), b.min());
+        CHECK_EQ(a.max(), b.max());
+        CHECK(a.valueCounts == b.valueCounts);
+    }
+}
+
+TEST(AddFileReadsInChunks)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records = MakeRecords(layout, 500);
+    std::FILE* file = std::tmpfile();
+    CHECK(file != nullptr);
+    if (!file) return;
+    std::fwrite(records.data(), 1, records.size(), file);
+    std::rewind(file);
+    Aggregation aggregation(layout, AllFields(), 1);
+    aggregation.addFile(file, 64);
+    std::fclose(file);
+    CHECK_EQ(500u, aggregation.result("temp").count);
+    CHECK_EQ(9.0, aggregation.result("sensor").max());
+}
+
+TEST_MAIN()
@@ -0,0 +1,127 @@
+#include "test_common.h"
+#include "../struct_atomic.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdint>
+
+namespace
+{
+
+const char* const CounterText =
+    "struct Counters { uint64_t total; uint32_t hits : 20; uint32_t state : 4; int32_t level : 8; uint16_t flags; };";
+
+const int Threads = 4;
+const int Iterations = 20000;
+
+// Запуск body(t) в Threads потоках
+template<typename Body>
+void RunThreads(Body body)
+{
+    std::vector<std::thread> threads;
+    for (int t = 0; t < Threads; ++t) threads.push_back(std::thread(body, t));
+    for (auto& thread : threads) thread.join();
+}
+
+} // namespace
+
+TEST(ConcurrentAddsToNeighbouringBitFields)
+{
+    StructLayout layout(CounterText);
+    uint64_t storage[4] = { 0, 0, 0, 0 };
+    char* record = reinterpret_cast<char*>(storage);
+    AtomicField total(layout, "total");
+    AtomicField hits(layout, "hits");
+    AtomicField level(layout, "level");
+    RunThreads([&](int t)
+    {
+        for (int i = 0; i < Iterations; ++i)
+        {
+            total.fetchAdd(record, 1);
+            hits.fetchAdd(record, 1);
+            level.fetchAdd(record, t % 2 ? 1 : -1);
+        }
+    });
+    CHECK_EQ(static_cast<uint64_t>(Threads * Iterations), total.load(record));
+    CHECK_EQ(static_cast<uint64_t>(Threads * Iterations) & 0xFFFFF, hits.load(record));
+    CHECK_EQ(static_cast<int64_t>(0), level.loadInt(record));
+    CHECK_EQ(static_cast<uint64_t>(0), AtomicField(layout, "state").load(record));
+}
+
+TEST(CompareExchangeLoopsLoseNoUpdates)
+{
+    StructLayout layout(CounterText);
+    uint64_t storage[4] = { 0, 0, 0, 0 };
+    char* record = reinterpret_cast<char*>(storage);
+    AtomicField hits(layout, "hits");
+    AtomicField state(layout, "state");
+    state.store(record, 9);
+    RunThreads([&](int)
+    {
+        for (int i = 0; i < Iterations; ++i)
+        {
+            uint64_t expected = hits.load(record);
+            while (!hits.compareExchange(record, expected, expected + 1))
+            {
+            }
+        }
+    });
+    CHECK_EQ(static_cast<uint64_t>(Threads * Iterations), hits.load(record));
+    CHECK_EQ(static_cast<uint64_t>(9), state.load(record));
+
+    uint64_t wrong = 1;
+    CHECK(!hits.compareExchange(record, wrong, 5));
+    CHECK_EQ(static_cast<uint64_t>(Threads * Iterations), wrong);
+}
+
+TEST(OrAndStoreAndSignExtension)
+{
+    StructLayout layout(CounterText);
+    uint64_t storage[4] = { 0, 0, 0, 0 };
+    char* record = reinterpret_cast<char*>(storage);
+    AtomicField flags(layout, "flags");
+    AtomicField state(layout, "state");
+    AtomicField level(layout, "level");
+    state.store(record, 0xF);
+    level.store(record, static_cast<uint64_t>(-100));
+    RunThreads([&](int t)
+    {
+        for (int i = t; i < 16; i += Threads) flags.fetchOr(record, 1ULL << i);
+    });
+    CHECK_EQ(static_cast<uint64_t>(0xFFFF), flags.load(record));
+    CHECK_EQ(static_cast<uint64_t>(0xFFFF), flags.fetchAnd(record, 0x00F0));
+    CHECK_EQ(static_cast<uint64_t>(0x00F0), flags.load(record));
+    CHECK_EQ(static_cast<uint64_t>(0xF), state.fetchAnd(record, 0x5));
+    CHECK_EQ(static_cast<uint64_t>(0x5), state.load(record));
+    CHECK_EQ(static_cast<int64_t>(-100), level.loadInt(record));
+    CHECK_EQ(static_cast<uint64_t>(0x5), state.fetchAdd(record, 12));
+    CHECK_EQ(static_cast<uint64_t>(1), state.load(record));       // перенос не выходит за поле
+    CHECK_EQ(static_cast<int64_t>(-100), level.loadInt(record));
+}
+
+TEST(UnalignedContainersUseTheEnclosingWord)
+{
+    StructLayout layout("struct Packed { uint8_t tag; uint16_t count; uint32_t big; uint16_t cross; };");
+    uint64_t storage[4] = { 0, 0, 0, 0 };
+    char* record = reinterpret_cast<char*>(storage);
+    AtomicField tag(layout, "tag");
+    AtomicField count(layout, "count");
+    AtomicField big(layout, "big");
+    tag.store(record, 0xAA);
+    RunThreads([&](int)
+    {
+        for (int i = 0; i < Iterations; ++i)
+        {
+            count.fetchAdd(record, 1);
+            big.fetchAdd(record, 3);
+        }
+    });
+    CHECK_EQ(static_cast<uint64_t>(Threads * Iterations) & 0xFFFF, count.load(record));
+    CHECK_EQ(static_cast<uint64_t>(3 * Threads * Iterations), big.load(record));
+    CHECK_EQ(static_cast<uint64_t>(0xAA), tag.load(record));
+    CHECK_EQ(static_cast<int64_t>(Threads * Iterations) & 0xFFFF, layout.readInt(layout.fieldIndex("count"), record));
+    CHECK_THROWS(std::invalid_argument, AtomicField(layout, "cross").load(record));
+}
+
+TEST_MAIN()
@@ -0,0 +1,112 @@
+#include "test_common.h"
+#include "../struct_builder.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace
+{
+
+const char* const RecordText =
+    "struct Order { uint32_t id; int8_t delta : 3; uint8_t code : 5; float ratio; uint16_t len; "
+    "uint32_t type : 4; uint32_t flags : 28; double price; };";
+
+StructLayout::Field BitField(const char* name, int byteOffset, size_t size, int bitOffset, int bitWidth)
+{
+    StructLayout::Field field;
+    field.type = size == 1 ? "uint8_t" : "uint32_t";
+    field.name = name;
+    field.byteOffset = byteOffset;
+    field.bitOffset = bitOffset;
+    field.bitWidth = bitWidth;
+    field.size = size;
+    field.isBitField = true;
+    field.kind = StructLayout::UnsignedValue;
+    field.mask = StructLayout::maskOf(bitWidth);
+    return field;
+}
+
+} // namespace
+
+TEST(BuildMatchesFieldByFieldWrites)
+{
+    StructLayout layout(RecordText);
+    RecordBuilder builder(layout);
+    std::vector<char> built(layout.size()), expected(layout.size());
+    uint64_t seed = 3;
+    bool same = true;
+    for (int i = 0; i < 1000; ++i)
+    {
+        builder.reset();
+        std::fill(expected.begin(), expected.end(), 0);
+        for (size_t f = 0; f < layout.fieldCount(); ++f)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            if ((seed >> 60) < 3) continue;     // часть полей не задается
+            int64_t value = static_cast<int64_t>(seed >> 17);
+            builder.set(f, value);
+            layout.writeInt(f, value, expected.data());
+        }
+        builder.build(built.data());
+        same = same && built == expected;
+    }
+    CHECK(same);
+}
+
+TEST(ApplyKeepsUnsetBits)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> record(layout.size(), '\x5A');
+    std::vector<char> expected = record;
+    RecordBuilder builder(layout);
+    builder.set("code", 17).set("flags", 12345).setDouble("price", 2.5);
+    builder.apply(record.data());
+    layout.writeInt(layout.fieldIndex("code"), 17, expected.data());
+    layout.writeInt(layout.fieldIndex("flags"), 12345, expected.data());
+    layout.writeDouble(layout.fieldIndex("price"), 2.5, expected.data());
+    CHECK(record == expected);
+}
+
+TEST(MixedWidthAdjacentBitFields)
+{
+    // a - контейнер uint8_t, b - uint32_t по тому же смещению, биты 3..6
+    StructLayout layout("struct Mixed { uint8_t a : 3; uint32_t b : 4; };");
+    CHECK_EQ(layout.field(0).byteOffset, layout.field(1).byteOffset);
+    CHECK(layout.field(0).size != layout.field(1).size);
+    std::vector<char> record(layout.size());
+    for (int order = 0; order < 2; ++order)
+    {
+        RecordBuilder builder(layout);
+        if (order == 0) builder.set("a", 3).set("b", 5);
+        else builder.set("b", 5).set("a", 3);
+        builder.build(record.data());
+        CHECK_EQ(static_cast<int64_t>(3), layout.readInt(0, record.data()));
+        CHECK_EQ(static_cast<int64_t>(5), layout.readInt(1, record.data()));
+
+        std::fill(record.begin(), record.end(), '\xFF');
+        builder.apply(record.data());
+        CHECK_EQ(static_cast<int64_t>(3), layout.readInt(0, record.data()));
+        CHECK_EQ(static_cast<int64_t>(5), layout.readInt(1, record.data()));
+        CHECK_EQ(static_cast<unsigned char>(0xFF), static_cast<unsigned char>(record[1]));
+    }
+}
+
+TEST(SpanningContainerMergesEarlierGroups)
+{
+    // a и b в разных байтах, c - контейнер uint32_t поверх обоих
+    std::vector<StructLayout::Field> fields;
+    fields.push_back(BitField("a", 0, 1, 0, 4));
+    fields.push_back(BitField("b", 1, 1, 0, 4));
+    fields.push_back(BitField("c", 0, 4, 16, 8));
+    StructLayout layout("Spanning", 4, fields);
+    RecordBuilder builder(layout);
+    builder.set("c", 0xAB).set("b", 9).set("a", 6);
+    std::vector<char> record(layout.size());
+    builder.build(record.data());
+    CHECK_EQ(static_cast<int64_t>(6), layout.readInt(0, record.data()));
+    CHECK_EQ(static_cast<int64_t>(9), layout.readInt(1, record.data()));
+    CHECK_EQ(static_cast<int64_t>(0xAB), layout.readInt(2, record.data()));
+}
+
+TEST_MAIN()
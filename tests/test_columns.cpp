@@ -0,0 +1,87 @@
+#include "test_common.h"
+#include "../struct_columns.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace
+{
+
+const char* const RecordText =
+    "struct Sample { uint16_t len; int8_t delta : 3; uint8_t code : 5; float ratio; uint32_t type : 4; uint32_t flags : 3; };";
+
+std::vector<char> MakeRecords(const StructLayout& layout, size_t count)
+{
+    std::vector<char> records(count * layout.size());
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        layout.writeInt(layout.fieldIndex("len"), static_cast<int64_t>(r * 7), record);
+        layout.writeInt(layout.fieldIndex("delta"), static_cast<int64_t>(r % 8) - 4, record);
+        layout.writeInt(layout.fieldIndex("code"), static_cast<int64_t>(r % 32), record);
+        layout.writeDouble(layout.fieldIndex("ratio"), static_cast<double>(r) / 4, record);
+        layout.writeInt(layout.fieldIndex("type"), static_cast<int64_t>(r % 16), record);
+        layout.writeInt(layout.fieldIndex("flags"), static_cast<int64_t>(r % 8), record);
+    }
+    return records;
+}
+
+} // namespace
+
+TEST(TransposeExtractsEveryField)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 5000;      // больше одного блока
+    std::vector<char> records = MakeRecords(layout, count);
+    ColumnSet columns = transpose(layout, records.data(), count);
+    CHECK_EQ(count, columns.count());
+    CHECK_EQ(layout.fieldCount(), columns.columnCount());
+    const Column& delta = columns.column("delta");
+    const Column& flags = columns.column("flags");
+    const Column& ratio = columns.column("ratio");
+    bool same = true;
+    for (size_t r = 0; r < count; ++r)
+    {
+        same = same && delta.intAt(r) == static_cast<int64_t>(r % 8) - 4;
+        same = same && flags.intAt(r) == static_cast<int64_t>(r % 8);
+        same = same && ratio.doubleAt(r) == static_cast<double>(r) / 4;
+    }
+    CHECK(same);
+    CHECK_EQ(static_cast<int8_t>(-4), delta.data<int8_t>()[0]);
+    CHECK_THROWS(std::invalid_argument, delta.data<int32_t>());
+    CHECK_THROWS(std::invalid_argument, columns.column("missing"));
+}
+
+TEST(PackRestoresRecordsAndZeroesTheRest)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 300;
+    std::vector<char> records = MakeRecords(layout, count);
+    ColumnSet columns = transpose(layout, records.data(), count);
+    CHECK(pack(layout, columns) == records);
+
+    // Поля, которых нет в наборе, получаются нулевыми
+    std::vector<size_t> some;
+    some.push_back(layout.fieldIndex("code"));
+    ColumnSet partial;
+    transpose(layout, records.data(), count, some, partial);
+    std::vector<char> packed = pack(layout, partial);
+    CHECK_EQ(0, layout.readInt(layout.fieldIndex("len"), packed.data() + layout.size()));
+    CHECK_EQ(1, layout.readInt(layout.fieldIndex("code"), packed.data() + layout.size()));
+}
+
+TEST(LoadColumnConvertsValues)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records = MakeRecords(layout, 10);
+    ColumnSet columns = transpose(layout, records.data(), 10);
+    int64_t deltas[10];
+    double ratios[10];
+    LoadColumn(columns.column("delta"), 0, 10, deltas);
+    LoadColumn(columns.column("ratio"), 0, 10, ratios);
+    CHECK_EQ(-4, deltas[0]);
+    CHECK_EQ(3, deltas[7]);
+    CHECK_EQ(2.25, ratios[9]);
+}
+
+TEST_MAIN()
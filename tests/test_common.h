@@ -0,0 +1,100 @@
+#ifndef TESTCOMMON_H
+#define TESTCOMMON_H
+
+// Минимальные проверки для тестов: каждая программа тестов - набор функций
+// TEST(...), main() запускает их по очереди и возвращает число провалов
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <exception>
+
+struct TestCase
+{
+    const char* name;
+    void (*function)();
+};
+
+inline std::vector<TestCase>& TestRegistry()
+{
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+inline int& TestFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+struct TestRegistrar
+{
+    TestRegistrar(const char* name, void (*function)())
+    {
+        TestCase test = { name, function };
+        TestRegistry().push_back(test);
+    }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistrar name##Registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++TestFailures(); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(expected, actual) \
+    do \
+    { \
+        if (!((expected) == (actual))) \
+        { \
+            std::fprintf(stderr, "%s:%d: CHECK_EQ failed: %s != %s\n", __FILE__, __LINE__, #expected, #actual); \
+            ++TestFailures(); \
+        } \
+    } while (0)
+
+#define CHECK_THROWS(exceptionType, statement) \
+    do \
+    { \
+        bool thrown = false; \
+        try { statement; } \
+        catch (const exceptionType&) { thrown = true; } \
+        if (!thrown) \
+        { \
+            std::fprintf(stderr, "%s:%d: %s did not throw %s\n", __FILE__, __LINE__, #statement, #exceptionType); \
+            ++TestFailures(); \
+        } \
+    } while (0)
+
+inline int RunTests()
+{
+    for (const auto& test : TestRegistry())
+    {
+        int before = TestFailures();
+        try
+        {
+            test.function();
+        }
+        catch (const std::exception& e)
+        {
+            std::fprintf(stderr, "%s: unexpected exception: %s\n", test.name, e.what());
+            ++TestFailures();
+        }
+        std::printf("%-40s %s\n", test.name, TestFailures() == before ? "ok" : "FAILED");
+    }
+    return TestFailures() ? 1 : 0;
+}
+
+#define TEST_MAIN() \
+    int main() { return RunTests(); }
+
+#endif // TESTCOMMON_H
@@ -0,0 +1,127 @@
+#include "test_common.h"
+#include "../struct_compress.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace
+{
+
+const char* const RecordText =
+    "struct Quote { uint64_t id; int32_t delta; uint32_t state; uint64_t symbol; double price; "
+    "uint16_t venue : 6; uint16_t side : 10; };";
+
+std::vector<char> MakeRecords(const StructLayout& layout, size_t count)
+{
+    static const uint64_t Symbols[] = { 0x1111222233334444ULL, 0x5555666677778888ULL, 0x9999AAAABBBBCCCCULL };
+    std::vector<char> records(count * layout.size(), 0);
+    uint64_t seed = 12345;
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        layout.writeBits(layout.fieldIndex("id"), 1000000 + r, record);                  // разности 1
+        layout.writeInt(layout.fieldIndex("delta"), static_cast<int64_t>(r % 50) - 25, record);
+        layout.writeInt(layout.fieldIndex("state"), static_cast<int64_t>(r / 500), record); // длинные серии
+        layout.writeBits(layout.fieldIndex("symbol"), Symbols[(seed >> 33) % 3], record);
+        layout.writeDouble(layout.fieldIndex("price"), static_cast<double>(seed >> 11) / 3.0, record);
+        layout.writeInt(layout.fieldIndex("venue"), static_cast<int64_t>(r % 64), record);
+        layout.writeInt(layout.fieldIndex("side"), static_cast<int64_t>(seed >> 54), record);
+    }
+    return records;
+}
+
+} // namespace
+
+TEST(BlockRoundTripAndEncodingChoice)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 4000;
+    std::vector<char> records = MakeRecords(layout, count);
+    std::string data;
+    CompressBlock(layout, records.data(), count, data);
+    CHECK(data.size() < records.size() / 2);
+
+    CompressedBlock block(layout, data.data(), data.size());
+    CHECK_EQ(count, block.count());
+    CHECK_EQ(DeltaEncoding, block.encoding(layout.fieldIndex("id")));
+    CHECK_EQ(RunLengthEncoding, block.encoding(layout.fieldIndex("state")));
+    CHECK_EQ(DictionaryEncoding, block.encoding(layout.fieldIndex("symbol")));
+    CHECK_EQ(PlainEncoding, block.encoding(layout.fieldIndex("price")));
+    CHECK_EQ(BitPackEncoding, block.encoding(layout.fieldIndex("delta")));
+
+    std::vector<char> restored(records.size());
+    block.decodeRecords(restored.data());
+    CHECK(restored == records);
+}
+
+TEST(DecodeSelectedFields)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 777;
+    std::vector<char> records = MakeRecords(layout, count);
+    std::string data;
+    CompressBlock(layout, records.data(), count, data);
+    CompressedBlock block(layout, data.data(), data.size());
+
+    std::vector<size_t> fields;
+    fields.push_back(layout.fieldIndex("side"));
+    fields.push_back(layout.fieldIndex("delta"));
+    ColumnSet columns;
+    block.decode(fields, columns);
+    CHECK_EQ(static_cast<size_t>(2), columns.columnCount());
+    bool same = true;
+    for (size_t r = 0; r < count; ++r)
+    {
+        const char* record = records.data() + r * layout.size();
+        same = same && columns.column("side").intAt(r) == layout.readInt(layout.fieldIndex("side"), record);
+        same = same && columns.column("delta").intAt(r) == static_cast<int64_t>(r % 50) - 25;
+    }
+    CHECK(same);
+}
+
+TEST(PaddingIsRestoredAsZero)
+{
+    StructLayout layout("struct Padded { uint8_t flag; uint32_t value : 20; uint32_t spare : 12; };");
+    const size_t count = 10;
+    std::vector<char> records(count * layout.size(), '\xFF');
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        layout.writeInt(0, static_cast<int64_t>(r), record);
+        layout.writeInt(1, static_cast<int64_t>(r * 1000), record);
+        layout.writeInt(2, 7, record);
+    }
+    std::string data;
+    CompressBlock(layout, records.data(), count, data);
+    std::vector<char> restored(records.size());
+    CompressedBlock(layout, data.data(), data.size()).decodeRecords(restored.data());
+    std::vector<unsigned char> mask = layout.valueMask();
+    bool same = true;
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        same = same && restored[i] == static_cast<char>(records[i] & mask[i % layout.size()]);
+    }
+    CHECK(same);
+}
+
+TEST(EmptyAndCorruptedBlocks)
+{
+    StructLayout layout(RecordText);
+    std::string empty;
+    CompressBlock(layout, nullptr, 0, empty);
+    CHECK_EQ(static_cast<size_t>(0), CompressedBlock(layout, empty.data(), empty.size()).count());
+
+    std::vector<char> records = MakeRecords(layout, 100);
+    std::string data;
+    CompressBlock(layout, records.data(), 100, data);
+    CHECK_THROWS(std::runtime_error, CompressedBlock(layout, data.data(), data.size() - 3));
+    std::string wrongEncoding = data;
+    wrongEncoding[8] = 9;
+    CHECK_THROWS(std::runtime_error, CompressedBlock(layout, wrongEncoding.data(), wrongEncoding.size()));
+    StructLayout other("struct Other { uint32_t a; };");
+    CHECK_THROWS(std::runtime_error, CompressedBlock(other, data.data(), data.size()));
+}
+
+TEST_MAIN()
@@ -0,0 +1,176 @@
+#include "test_common.h"
+#include "../struct_convert.h"
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+namespace
+{
+
+const char* const OldText =
+    "struct Order { uint64_t id; int16_t qty; uint8_t side : 2; uint8_t venue : 6; float price; "
+    "uint32_t kind : 4; uint32_t flags : 12; uint32_t legacy : 16; double fee; };";
+
+const char* const NewText =
+    "struct Order { uint64_t id; uint8_t side : 2; uint8_t venue : 6; double price; int32_t qty; "
+    "uint32_t kind : 8; uint32_t flags : 8; uint32_t region : 16; int16_t fee; uint16_t version; };";
+
+std::vector<char> RandomRecords(const StructLayout& layout, size_t count)
+{
+    std::vector<char> records(count * layout.size(), 0);
+    uint64_t seed = 11;
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        for (size_t f = 0; f < layout.fieldCount(); ++f)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            StructLayout::ValueKind kind = layout.field(f).kind;
+            if (kind == StructLayout::FloatValue || kind == StructLayout::DoubleValue)
+            {
+                layout.writeDouble(f, static_cast<double>(static_cast<int64_t>(seed) >> 40) / 16, record);
+            }
+            else
+            {
+                layout.writeBits(f, seed >> 7, record);
+            }
+        }
+    }
+    return records;
+}
+
+// Вещественное значение, приведенное к диапазону целого поля
+double Saturate(const StructLayout::Field& field, double value)
+{
+    if (field.kind == StructLayout::FloatValue || field.kind == StructLayout::DoubleValue) return value;
+    bool isSigned = field.kind == StructLayout::SignedValue;
+    double high = std::ldexp(1.0, field.bitWidth - (isSigned ? 1 : 0)) - 1;
+    double low = isSigned ? -high - 1 : 0;
+    return std::max(low, std::min(high, value));
+}
+
+// Ожидаемый результат: поле за полем через readInt/readDouble и writeInt/writeDouble
+void ConvertByFields(const StructLayout& from, const StructLayout& to, const char* source, char* target)
+{
+    for (size_t f = 0; f < to.fieldCount(); ++f)
+    {
+        int index = from.indexOf(to.field(f).name);
+        if (index < 0) continue;
+        size_t s = static_cast<size_t>(index);
+        bool real = from.field(s).kind == StructLayout::FloatValue || from.field(s).kind == StructLayout::DoubleValue ||
+                    to.field(f).kind == StructLayout::FloatValue || to.field(f).kind == StructLayout::DoubleValue;
+        if (real) to.writeDouble(f, Saturate(to.field(f), from.readDouble(s, source)), target);
+        else to.writeInt(f, from.readInt(s, source), target);
+    }
+}
+
+} // namespace
+
+TEST(IdenticalLayoutsAreCopied)
+{
+    StructLayout layout(OldText);
+    Converter converter(layout, layout);
+    CHECK_EQ(layout.size(), converter.copiedBytes());
+    CHECK_EQ(static_cast<size_t>(0), converter.convertedFields());
+    CHECK(converter.defaultedFields().empty());
+    std::vector<char> records = RandomRecords(layout, 100);
+    CHECK(converter.convertAll(records.data(), 100) == records);
+}
+
+TEST(NewVersionMatchesFieldByFieldConversion)
+{
+    StructLayout from(OldText);
+    StructLayout to(NewText);
+    Converter converter(from, to);
+    converter.setDefault("version", 2);
+    std::vector<std::string> defaulted = converter.defaultedFields();
+    CHECK_EQ(static_cast<size_t>(2), defaulted.size());
+    CHECK(converter.copiedBytes() >= 9);     // id и контейнер side/venue
+
+    const size_t count = 500;
+    std::vector<char> sources = RandomRecords(from, count);
+    std::vector<char> targets = converter.convertAll(sources.data(), count);
+    std::vector<char> expected(count * to.size(), 0);
+    bool same = true;
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = expected.data() + r * to.size();
+        to.writeInt(to.fieldIndex("version"), 2, record);
+        ConvertByFields(from, to, sources.data() + r * from.size(), record);
+        same = same && to.readInt(to.fieldIndex("region"), targets.data() + r * to.size()) == 0;
+    }
+    CHECK(same);
+    CHECK(targets == expected);
+}
+
+TEST(SignAndWidthRules)
+{
+    StructLayout from("struct V { int8_t small : 4; uint8_t code : 4; int32_t wide; double ratio; };");
+    StructLayout to("struct V { int64_t small; uint8_t code : 2; uint8_t spare : 6; int8_t wide; int32_t ratio; };");
+    std::vector<char> source(from.size(), 0);
+    from.writeInt(0, -3, source.data());
+    from.writeInt(1, 13, source.data());
+    from.writeInt(2, 300, source.data());
+    from.writeDouble(3, -7.9, source.data());
+    std::vector<char> target(to.size());
+    Converter(from, to).convert(source.data(), target.data());
+    CHECK_EQ(static_cast<int64_t>(-3), to.readInt(0, target.data()));
+    CHECK_EQ(static_cast<int64_t>(1), to.readInt(1, target.data()));        // 13 & 3
+    CHECK_EQ(static_cast<int64_t>(0), to.readInt(2, target.data()));
+    CHECK_EQ(static_cast<int64_t>(44), to.readInt(3, target.data()));       // 300 усекается до 8 бит
+    CHECK_EQ(static_cast<int64_t>(-7), to.readInt(4, target.data()));
+}
+
+TEST(RealValuesSaturateInIntegerFields)
+{
+    StructLayout from("struct R { double a; double b; double c; double d; float e; };");
+    StructLayout to("struct R { int8_t a : 5; uint8_t x : 3; uint16_t b : 10; uint16_t y : 6; int32_t c; uint64_t d; int64_t e; };");
+    Converter converter(from, to);
+    const double inf = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    struct Case { double value; int64_t a, b, c; uint64_t d; int64_t e; };
+    const Case cases[] = {
+        { nan, 0, 0, 0, 0, 0 },
+        { inf, 15, 1023, 2147483647, ~0ULL, INT64_MAX },
+        { -inf, -16, 0, -2147483647 - 1, 0, INT64_MIN },
+        { 1e30, 15, 1023, 2147483647, ~0ULL, INT64_MAX },
+        { -1e30, -16, 0, -2147483647 - 1, 0, INT64_MIN },
+        { 1.8e19, 15, 1023, 2147483647, 18000000000000000000ULL, INT64_MAX },
+        { -16.9, -16, 0, -16, 0, -16 },
+        { 15.9, 15, 15, 15, 15, 15 },
+        { 1023.5, 15, 1023, 1023, 1023, 1023 },
+    };
+    std::vector<char> source(from.size()), target(to.size());
+    bool same = true;
+    for (const Case& c : cases)
+    {
+        for (size_t f = 0; f < from.fieldCount(); ++f) from.writeDouble(f, c.value, source.data());
+        converter.convert(source.data(), target.data());
+        same = same && to.readInt(0, target.data()) == c.a && to.readInt(2, target.data()) == c.b &&
+               to.readInt(4, target.data()) == c.c && to.readBits(5, target.data()) == c.d &&
+               to.readInt(6, target.data()) == c.e;
+    }
+    CHECK(same);
+}
+
+TEST(DefaultsOnlyForNewFields)
+{
+    StructLayout from(OldText);
+    StructLayout to(NewText);
+    Converter converter(from, to);
+    CHECK_THROWS(std::invalid_argument, converter.setDefault("qty", 1));
+    CHECK_THROWS(std::invalid_argument, converter.setDefault("missing", 1));
+    converter.setDefault("region", 77).setDefault("version", 3);
+    std::vector<char> source(from.size(), 0);
+    std::vector<char> target(to.size());
+    converter.convert(source.data(), target.data());
+    CHECK_EQ(static_cast<int64_t>(77), to.readInt(to.fieldIndex("region"), target.data()));
+    CHECK_EQ(static_cast<int64_t>(3), to.readInt(to.fieldIndex("version"), target.data()));
+    CHECK_EQ(static_cast<int64_t>(0), to.readInt(to.fieldIndex("flags"), target.data()));
+}
+
+TEST_MAIN()
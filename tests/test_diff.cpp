@@ -0,0 +1,115 @@
+#include "test_common.h"
+#include "../struct_diff.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+
+// Последний байт - контейнер side/venue, из 8 бит заняты 5
+const char* const RecordText =
+    "struct Quote { uint64_t id; int32_t qty; double price; uint16_t flags; uint8_t side : 2; uint8_t venue : 3; };";
+
+std::vector<char> RandomRecords(const StructLayout& layout, size_t count, uint64_t seed)
+{
+    std::vector<char> records(count * layout.size());
+    for (char& byte : records)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        byte = static_cast<char>(seed >> 56);
+    }
+    return records;
+}
+
+bool SameSnapshot(const RecordDiff& diff, const std::vector<char>& a, const std::vector<char>& b)
+{
+    size_t recordSize = diff.layout().size();
+    if (a.size() != b.size()) return false;
+    for (size_t offset = 0; offset < a.size(); offset += recordSize)
+    {
+        if (!diff.equal(a.data() + offset, b.data() + offset)) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+TEST(UnusedBitsAreNotChanges)
+{
+    StructLayout layout(RecordText);
+    RecordDiff diff(layout);
+    std::vector<char> a = RandomRecords(layout, 1, 1);
+    std::vector<char> b = a;
+    b[22] = static_cast<char>(b[22] ^ 0xE0);     // только свободные биты
+    CHECK(diff.equal(a.data(), b.data()));
+    uint64_t bits[1];
+    CHECK_EQ(static_cast<size_t>(0), diff.changedFields(a.data(), b.data(), bits));
+
+    layout.writeInt(layout.fieldIndex("venue"), (layout.readInt(layout.fieldIndex("venue"), b.data()) + 1) % 8, b.data());
+    layout.writeInt(layout.fieldIndex("flags"), layout.readInt(layout.fieldIndex("flags"), b.data()) ^ 1, b.data());
+    CHECK(!diff.equal(a.data(), b.data()));
+    CHECK_EQ(static_cast<size_t>(2), diff.changedFields(a.data(), b.data(), bits));
+    CHECK_EQ((1ULL << layout.fieldIndex("venue")) | (1ULL << layout.fieldIndex("flags")), bits[0]);
+}
+
+TEST(DeltaRoundTripGrowAndShrink)
+{
+    StructLayout layout(RecordText);
+    RecordDiff diff(layout);
+    const size_t count = 1000;
+    std::vector<char> before = RandomRecords(layout, count, 2);
+    for (size_t grown = 0; grown < 2; ++grown)
+    {
+        size_t afterCount = grown ? count + 37 : count - 100;
+        std::vector<char> after(afterCount * layout.size());
+        for (size_t r = 0; r < afterCount; ++r)
+        {
+            char* record = after.data() + r * layout.size();
+            if (r < count) std::memcpy(record, before.data() + r * layout.size(), layout.size());
+            else std::memset(record, 0, layout.size());
+            if (r % 7 == 0) layout.writeInt(layout.fieldIndex("qty"), static_cast<int64_t>(r) - 500, record);
+            if (r % 11 == 0) layout.writeDouble(layout.fieldIndex("price"), static_cast<double>(r) / 3, record);
+            if (r % 13 == 0) layout.writeInt(layout.fieldIndex("side"), static_cast<int64_t>(r % 4), record);
+        }
+
+        std::vector<uint64_t> bits;
+        size_t changed = diff.compare(before.data(), after.data(), std::min(count, afterCount), bits);
+        CHECK(changed > 0);
+        CHECK(changed < std::min(count, afterCount) / 3);
+
+        std::string delta;
+        diff.encode(before.data(), count, after.data(), afterCount, delta);
+        CHECK(delta.size() < after.size() / 10);
+        std::vector<char> restored = before;
+        diff.apply(delta.data(), delta.size(), restored);
+        CHECK(SameSnapshot(diff, after, restored));
+    }
+}
+
+TEST(ForeignAndCorruptedDeltasThrow)
+{
+    StructLayout layout(RecordText);
+    RecordDiff diff(layout);
+    std::vector<char> before = RandomRecords(layout, 10, 3);
+    std::vector<char> after = before;
+    layout.writeInt(layout.fieldIndex("qty"), 1, after.data() + 5 * layout.size());
+    std::string delta;
+    diff.encode(before.data(), 10, after.data(), 10, delta);
+
+    StructLayout other("struct Quote { uint64_t id; int32_t qty; double price; int16_t flags; uint8_t side : 2; uint8_t venue : 3; };");
+    std::vector<char> records = before;
+    CHECK_THROWS(std::runtime_error, RecordDiff(other).apply(delta.data(), delta.size(), records));
+    CHECK_THROWS(std::runtime_error, diff.apply(delta.data(), delta.size() - 1, records));
+    std::string junk = delta;
+    junk[0] = 'X';
+    CHECK_THROWS(std::runtime_error, diff.apply(junk.data(), junk.size(), records));
+    std::string badIndex = delta;
+    badIndex[32] = 100;     // пропуск за концом снимка
+    CHECK_THROWS(std::runtime_error, diff.apply(badIndex.data(), badIndex.size(), records));
+}
+
+TEST_MAIN()
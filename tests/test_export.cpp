@@ -0,0 +1,127 @@
+#include "test_common.h"
+#include "../struct_export.h"
+
+#include <string>
+#include <vector>
+#include <limits>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+
+const char* const RecordText =
+    "struct Fill { uint64_t id; int32_t qty; float ratio; double price; int16_t delta : 5; uint16_t side : 11; };";
+
+std::vector<char> MakeRecord(const StructLayout& layout, uint64_t id, int64_t qty, double ratio, double price,
+                             int64_t delta, int64_t side)
+{
+    std::vector<char> record(layout.size(), 0);
+    layout.writeBits(layout.fieldIndex("id"), id, record.data());
+    layout.writeInt(layout.fieldIndex("qty"), qty, record.data());
+    layout.writeDouble(layout.fieldIndex("ratio"), ratio, record.data());
+    layout.writeDouble(layout.fieldIndex("price"), price, record.data());
+    layout.writeInt(layout.fieldIndex("delta"), delta, record.data());
+    layout.writeInt(layout.fieldIndex("side"), side, record.data());
+    return record;
+}
+
+} // namespace
+
+TEST(CsvHeaderAndValues)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records = MakeRecord(layout, ~0ULL, std::numeric_limits<int32_t>::min(), 0.1, -2.5, -16, 2047);
+    std::vector<char> second = MakeRecord(layout, 7, 42, 0, 1e300, 15, 0);
+    records.insert(records.end(), second.begin(), second.end());
+
+    RecordExporter exporter(layout, RecordExporter::Csv);
+    TextBuffer out;
+    exporter.header(out);
+    exporter.append(records.data(), 2, out);
+    CHECK_EQ(std::string("id,qty,ratio,price,delta,side\n"
+                         "18446744073709551615,-2147483648,0.1,-2.5,-16,2047\n"
+                         "7,42,0,1e+300,15,0\n"), out.str());
+}
+
+TEST(NdJsonSelectedFieldsAndNonFinite)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> record = MakeRecord(layout, 3, -1, std::numeric_limits<float>::infinity(),
+                                          std::numeric_limits<double>::quiet_NaN(), 0, 5);
+    std::vector<std::string> names;
+    names.push_back("price");
+    names.push_back("id");
+    names.push_back("ratio");
+    TextBuffer json;
+    RecordExporter(layout, RecordExporter::NdJson, names).append(record.data(), 1, json);
+    CHECK_EQ(std::string("{\"price\":null,\"id\":3,\"ratio\":null}\n"), json.str());
+
+    TextBuffer csv;
+    RecordExporter(layout, RecordExporter::Csv, names).append(record.data(), 1, csv);
+    CHECK_EQ(std::string("nan,3,inf\n"), csv.str());
+    CHECK_THROWS(std::invalid_argument, RecordExporter(layout, RecordExporter::Csv, std::vector<std::string>(1, "x")));
+}
+
+TEST(NumbersReadBackExactly)
+{
+    TextBuffer out;
+    uint64_t seed = 99;
+    bool same = true;
+    for (int i = 0; i < 20000; ++i)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t bits = seed;
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        if (!std::isfinite(value)) continue;
+        if (i % 2) value = static_cast<double>(static_cast<int64_t>(seed >> 20)) / 1000;   // цены с 3 знаками
+        out.clear();
+        out.appendDouble(value);
+        same = same && std::strtod(out.str().c_str(), nullptr) == value;
+
+        float narrow = static_cast<float>(value);
+        if (!std::isfinite(narrow)) continue;
+        out.clear();
+        out.appendFloat(narrow);
+        same = same && std::strtof(out.str().c_str(), nullptr) == narrow;
+    }
+    CHECK(same);
+
+    out.clear();
+    out.appendDouble(-0.0);
+    out.put(' ');
+    out.appendDouble(123.456);
+    out.put(' ');
+    out.appendSigned(std::numeric_limits<int64_t>::min());
+    out.put(' ');
+    out.appendFloat(0.3f);
+    CHECK_EQ(std::string("-0 123.456 -9223372036854775808 0.3"), out.str());
+}
+
+TEST(WriteFlushesInChunks)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records;
+    for (int i = 0; i < 100; ++i)
+    {
+        std::vector<char> record = MakeRecord(layout, i, i, 0.5, i * 0.25, 0, 1);
+        records.insert(records.end(), record.begin(), record.end());
+    }
+    RecordExporter exporter(layout, RecordExporter::Csv);
+    TextBuffer expected;
+    exporter.header(expected);
+    exporter.append(records.data(), 100, expected);
+
+    std::FILE* file = std::tmpfile();
+    exporter.write(records.data(), 100, file, true, 64);
+    std::string written(static_cast<size_t>(std::ftell(file)), '\0');
+    std::rewind(file);
+    CHECK_EQ(written.size(), std::fread(&written[0], 1, written.size(), file));
+    std::fclose(file);
+    CHECK_EQ(expected.str(), written);
+}
+
+TEST_MAIN()
@@ -0,0 +1,93 @@
+#include "test_common.h"
+#include "../struct_expr.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace
+{
+
+const char* const RecordText =
+    "struct Frame { uint16_t len; uint8_t flags : 4; int8_t level : 4; int32_t payload_off; float scale; };";
+
+std::vector<char> MakeRecords(const StructLayout& layout, size_t count)
+{
+    std::vector<char> records(count * layout.size());
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        layout.writeInt(0, static_cast<int64_t>(r % 1000), record);
+        layout.writeInt(1, static_cast<int64_t>(r % 16), record);
+        layout.writeInt(2, static_cast<int64_t>(r % 16) - 8, record);
+        layout.writeInt(3, -static_cast<int64_t>(r), record);
+        layout.writeDouble(4, 0.5, record);
+    }
+    return records;
+}
+
+} // namespace
+
+TEST(IntegerExpressionOverRecordsAndColumns)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 3000;      // несколько пакетов
+    std::vector<char> records = MakeRecords(layout, count);
+    Expression expression(layout, "total = len * 4 + payload_off - ((flags >> 2) & 3) + level % 3");
+    CHECK_EQ(std::string("total"), expression.name());
+    CHECK(!expression.isReal());
+    CHECK_EQ(4u, expression.fieldIndices().size());
+
+    std::vector<int64_t> fromRecords, fromColumns;
+    expression.evaluate(records.data(), count, fromRecords);
+    expression.evaluate(transpose(layout, records.data(), count), fromColumns);
+    CHECK(fromRecords == fromColumns);
+    bool same = true;
+    for (size_t r = 0; r < count; ++r)
+    {
+        int64_t level = static_cast<int64_t>(r % 16) - 8;
+        int64_t expected = static_cast<int64_t>(r % 1000) * 4 - static_cast<int64_t>(r) -
+                           ((static_cast<int64_t>(r % 16) >> 2) & 3) + level % 3;
+        same = same && fromRecords[r] == expected;
+    }
+    CHECK(same);
+}
+
+TEST(RealExpressionAndPromotion)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records = MakeRecords(layout, 10);
+    Expression expression(layout, "len * scale + 1.5e0");
+    CHECK(expression.isReal());
+    std::vector<double> values;
+    expression.evaluate(records.data(), 10, values);
+    CHECK_EQ(1.5, values[0]);
+    CHECK_EQ(6.0, values[9]);
+    std::vector<int64_t> ints;
+    CHECK_THROWS(std::invalid_argument, expression.evaluate(records.data(), 10, ints));
+}
+
+TEST(DivisionByZeroAndLiterals)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records = MakeRecords(layout, 3);
+    std::vector<int64_t> values;
+    Expression(layout, "100 / len + 7 % len").evaluate(records.data(), 3, values);
+    CHECK_EQ(0, values[0]);
+    CHECK_EQ(100, values[1]);
+    CHECK_EQ(51, values[2]);
+    Expression(layout, "010 + 0x10 + len").evaluate(records.data(), 3, values);
+    CHECK_EQ(26, values[0]);
+    CHECK_THROWS(std::invalid_argument, Expression(layout, "08a + len"));
+}
+
+TEST(RejectsInvalidExpressions)
+{
+    StructLayout layout(RecordText);
+    CHECK_THROWS(std::invalid_argument, Expression(layout, "scale << 1"));
+    CHECK_THROWS(std::invalid_argument, Expression(layout, "~scale"));
+    CHECK_THROWS(std::invalid_argument, Expression(layout, "missing + 1"));
+    CHECK_THROWS(std::invalid_argument, Expression(layout, "(len + 1"));
+    CHECK_THROWS(std::invalid_argument, Expression(layout, "1x = len"));
+}
+
+TEST_MAIN()
@@ -0,0 +1,101 @@
+#include "test_common.h"
+#include "../struct_filter.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace
+{
+
+const char* const RecordText =
+    "struct Packet { uint16_t len; int8_t delta : 4; uint8_t urgent : 1; uint8_t kind : 3; double score; int64_t offset; };";
+
+std::vector<char> MakeRecords(const StructLayout& layout, size_t count)
+{
+    std::vector<char> records(count * layout.size());
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        layout.writeInt(layout.fieldIndex("len"), static_cast<int64_t>(r), record);
+        layout.writeInt(layout.fieldIndex("delta"), static_cast<int64_t>(r % 16) - 8, record);
+        layout.writeInt(layout.fieldIndex("urgent"), static_cast<int64_t>(r % 3 == 0), record);
+        layout.writeInt(layout.fieldIndex("kind"), static_cast<int64_t>(r % 8), record);
+        layout.writeDouble(layout.fieldIndex("score"), static_cast<double>(r) / 10, record);
+        layout.writeInt(layout.fieldIndex("offset"), static_cast<int64_t>(r) - 5000, record);
+    }
+    return records;
+}
+
+// Эталон: то же условие, посчитанное по одной записи через StructLayout
+template<typename Predicate>
+size_t CountReference(const StructLayout& layout, const std::vector<char>& records, size_t count, Predicate predicate)
+{
+    size_t result = 0;
+    for (size_t r = 0; r < count; ++r)
+    {
+        if (predicate(records.data() + r * layout.size())) ++result;
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(MatchesReferenceAcrossBatches)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 10000;     // больше одного пакета
+    std::vector<char> records = MakeRecords(layout, count);
+    RecordFilter filter(layout, "urgent == 1 && (len > 512 || delta < -3) && !(kind == 2)");
+    size_t expected = CountReference(layout, records, count, [&](const char* record)
+    {
+        return layout.readInt(layout.fieldIndex("urgent"), record) == 1 &&
+               (layout.readInt(layout.fieldIndex("len"), record) > 512 ||
+                layout.readInt(layout.fieldIndex("delta"), record) < -3) &&
+               layout.readInt(layout.fieldIndex("kind"), record) != 2;
+    });
+    CHECK_EQ(expected, filter.countMatches(records.data(), count));
+
+    std::vector<size_t> indices;
+    filter.selectIndices(records.data(), count, indices);
+    CHECK_EQ(expected, indices.size());
+    CHECK(!indices.empty() && indices[0] % 3 == 0);
+}
+
+TEST(SignedFloatAndMirroredComparisons)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 10000;
+    std::vector<char> records = MakeRecords(layout, count);
+    CHECK_EQ(5000u, RecordFilter(layout, "offset < 0").countMatches(records.data(), count));
+    CHECK_EQ(5000u, RecordFilter(layout, "0 > offset").countMatches(records.data(), count));
+    CHECK_EQ(10u, RecordFilter(layout, "score < 1.0").countMatches(records.data(), count));
+    // Дробная граница у целого поля: len < 2.5 - то же, что len < 3
+    CHECK_EQ(3u, RecordFilter(layout, "len < 2.5").countMatches(records.data(), count));
+    CHECK_EQ(0u, RecordFilter(layout, "len == 2.5").countMatches(records.data(), count));
+    // Константа вне диапазона поля
+    CHECK_EQ(count, RecordFilter(layout, "delta > -100").countMatches(records.data(), count));
+    CHECK_EQ(0u, RecordFilter(layout, "kind >= 8").countMatches(records.data(), count));
+}
+
+TEST(IntegerLiteralsAreDecimal)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records = MakeRecords(layout, 100);
+    CHECK_EQ(1u, RecordFilter(layout, "len == 010").countMatches(records.data(), 100));
+    CHECK_EQ(1u, RecordFilter(layout, "len == 10").countMatches(records.data(), 100));
+    CHECK_EQ(8u, RecordFilter(layout, "len < 08").countMatches(records.data(), 100));
+    CHECK_EQ(16u, RecordFilter(layout, "len < 0x10").countMatches(records.data(), 100));
+    CHECK_THROWS(std::invalid_argument, RecordFilter(layout, "len == 12abc"));
+    CHECK_THROWS(std::invalid_argument, RecordFilter(layout, "len == 0x"));
+}
+
+TEST(RejectsMalformedExpressions)
+{
+    StructLayout layout(RecordText);
+    CHECK_THROWS(std::invalid_argument, RecordFilter(layout, "missing == 1"));
+    CHECK_THROWS(std::invalid_argument, RecordFilter(layout, "(len == 1"));
+    CHECK_THROWS(std::invalid_argument, RecordFilter(layout, "len = 1"));
+    CHECK_THROWS(std::invalid_argument, RecordFilter(layout, "len == 1 garbage"));
+}
+
+TEST_MAIN()
@@ -0,0 +1,137 @@
+#include "test_common.h"
+#include "../struct_groupby.h"
+
+#include <map>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace
+{
+
+const char* const RecordText =
+    "struct Order { uint32_t id; uint8_t region : 3; int8_t tier : 5; uint64_t amount; double price; uint32_t customer; };";
+
+std::vector<std::string> Keys(const char* a, const char* b = nullptr)
+{
+    std::vector<std::string> keys(1, a);
+    if (b) keys.push_back(b);
+    return keys;
+}
+
+std::vector<char> MakeRecords(const StructLayout& layout, size_t count)
+{
+    std::vector<char> records(count * layout.size());
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        layout.writeInt(0, static_cast<int64_t>(r), record);
+        layout.writeInt(1, static_cast<int64_t>(r % 8), record);
+        layout.writeInt(2, static_cast<int64_t>(r % 5) - 2, record);
+        layout.writeBits(3, (r % 2 ? 0x8000000000000000ULL : 0) + r, record);
+        layout.writeDouble(4, static_cast<double>(r % 10), record);
+        layout.writeInt(5, static_cast<int64_t>(r * 2654435761u % 100000), record);
+    }
+    return records;
+}
+
+} // namespace
+
+TEST(DenseCompositeKeyCountsAndSums)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 4000;
+    std::vector<char> records = MakeRecords(layout, count);
+    GroupBy groupBy(layout, Keys("region", "tier"), "price", 1);
+    groupBy.add(records.data(), count);
+    std::vector<GroupBy::Group> groups = groupBy.groups();
+    CHECK_EQ(40u, groups.size());   // 8 регионов x 5 уровней, все сочетания встречаются
+
+    std::map<std::pair<int64_t, int64_t>, uint64_t> expected;
+    for (size_t r = 0; r < count; ++r) ++expected[std::make_pair(static_cast<int64_t>(r % 8), static_cast<int64_t>(r % 5) - 2)];
+    bool same = true;
+    for (const auto& group : groups)
+    {
+        same = same && group.key.size() == 2 && expected[std::make_pair(group.key[0], group.key[1])] == group.count;
+        same = same && group.realMin >= 0 && group.realMax <= 9;
+    }
+    CHECK(same);
+}
+
+TEST(UnsignedValueAboveInt64Max)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records = MakeRecords(layout, 100);
+    GroupBy groupBy(layout, Keys("region"), "amount", 1);
+    groupBy.add(records.data(), 100);
+    bool found = false;
+    for (const auto& group : groupBy.groups())
+    {
+        if (group.key[0] != 1) continue;
+        found = true;
+        // Регион 1: записи 1, 9, 17, ... - все нечетные, то есть выше 2^63
+        CHECK_EQ(0x8000000000000000ULL + 1, group.uintMin);
+        CHECK_EQ(0x8000000000000000ULL + 97, group.uintMax);
+    }
+    CHECK(found);
+}
+
+TEST(SignedSumsWrapInsteadOfOverflowing)
+{
+    StructLayout layout("struct Chunk { uint8_t group; int64_t len; };");
+    const size_t count = 1000;
+    std::vector<char> records(count * layout.size());
+    for (size_t r = 0; r < count; ++r)
+    {
+        layout.writeInt(0, static_cast<int64_t>(r % 2), records.data() + r * layout.size());
+        layout.writeInt(1, r % 4 == 3 ? INT64_MIN : INT64_MAX - static_cast<int64_t>(r), records.data() + r * layout.size());
+    }
+    std::map<int64_t, uint64_t> expected;
+    for (size_t r = 0; r < count; ++r)
+    {
+        expected[static_cast<int64_t>(r % 2)] += static_cast<uint64_t>(layout.readInt(1, records.data() + r * layout.size()));
+    }
+    for (unsigned threads = 1; threads <= 3; threads += 2)
+    {
+        GroupBy groupBy(layout, Keys("group"), "len", threads);
+        groupBy.add(records.data(), count);
+        bool same = groupBy.groups().size() == 2;
+        for (const auto& group : groupBy.groups())
+        {
+            same = same && static_cast<uint64_t>(group.intSum) == expected[group.key[0]];
+        }
+        CHECK(same);
+    }
+}
+
+TEST(HashedKeyMatchesThreadedRun)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 200000;
+    std::vector<char> records = MakeRecords(layout, count);
+    GroupBy single(layout, Keys("customer"), "", 1);
+    GroupBy threaded(layout, Keys("customer"), "", 3);
+    single.add(records.data(), count);
+    threaded.add(records.data(), count);
+    std::map<int64_t, uint64_t> a, b;
+    uint64_t total = 0;
+    for (const auto& group : single.groups())
+    {
+        a[group.key[0]] = group.count;
+        total += group.count;
+    }
+    for (const auto& group : threaded.groups()) b[group.key[0]] = group.count;
+    CHECK_EQ(count, total);
+    CHECK(a == b);
+    CHECK(a.size() > 50000);
+}
+
+TEST(RejectsInvalidKeys)
+{
+    StructLayout layout(RecordText);
+    CHECK_THROWS(std::invalid_argument, GroupBy(layout, Keys("price"), ""));
+    CHECK_THROWS(std::invalid_argument, GroupBy(layout, Keys("amount", "id"), ""));
+    CHECK_THROWS(std::invalid_argument, GroupBy(layout, std::vector<std::string>(), ""));
+}
+
+TEST_MAIN()
@@ -0,0 +1,118 @@
+#include "test_common.h"
+#include "../struct_hash.h"
+
+#include <set>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace
+{
+
+// 23 байта: неполное последнее слово, в последнем байте свободны 3 бита
+const char* const RecordText =
+    "struct Key { uint64_t id; int32_t qty; double price; uint16_t flags; uint8_t side : 2; uint8_t venue : 3; };";
+
+// Запись с ключом key и мусором в свободных битах
+std::vector<char> MakeRecord(const StructLayout& layout, uint64_t key, uint64_t junk)
+{
+    std::vector<char> record(layout.size(), 0);
+    layout.writeBits(layout.fieldIndex("id"), key * 0x9E3779B97F4A7C15ULL, record.data());
+    layout.writeInt(layout.fieldIndex("qty"), static_cast<int64_t>(key % 1000) - 500, record.data());
+    layout.writeDouble(layout.fieldIndex("price"), static_cast<double>(key % 97) / 4, record.data());
+    layout.writeInt(layout.fieldIndex("venue"), static_cast<int64_t>(key % 8), record.data());
+    record[layout.size() - 1] = static_cast<char>(record[layout.size() - 1] | (junk % 8) << 5);
+    return record;
+}
+
+} // namespace
+
+TEST(UnusedBitsDoNotAffectHashOrEquality)
+{
+    StructLayout layout(RecordText);
+    RecordHasher hasher(layout);
+    std::vector<char> a = MakeRecord(layout, 7, 0);
+    std::vector<char> b = MakeRecord(layout, 7, 5);
+    CHECK(a != b);
+    CHECK(hasher.equals(a.data(), b.data()));
+    CHECK_EQ(hasher.hash(a.data()), hasher.hash(b.data()));
+
+    layout.writeInt(layout.fieldIndex("side"), 1, b.data());
+    CHECK(!hasher.equals(a.data(), b.data()));
+    CHECK(hasher.hash(a.data()) != hasher.hash(b.data()));
+    CHECK(RecordHasher(layout, 1).hash(a.data()) != hasher.hash(a.data()));
+}
+
+TEST(DistinctRecordsGetDistinctHashes)
+{
+    StructLayout layout(RecordText);
+    RecordHasher hasher(layout);
+    const size_t count = 20000;
+    std::vector<char> records;
+    for (uint64_t key = 0; key < count; ++key)
+    {
+        std::vector<char> record = MakeRecord(layout, key, key);
+        records.insert(records.end(), record.begin(), record.end());
+    }
+    std::vector<uint64_t> hashes(count);
+    hasher.hash(records.data(), count, hashes.data());
+    CHECK_EQ(count, std::set<uint64_t>(hashes.begin(), hashes.end()).size());
+    CHECK_EQ(hasher.hash(records.data() + 5 * layout.size()), hashes[5]);
+
+    // Младшие биты хеша (индекс ячейки) распределены равномерно
+    std::vector<size_t> slots(256, 0);
+    for (uint64_t hash : hashes) ++slots[hash & 255];
+    size_t fullest = 0;
+    for (size_t n : slots) fullest = std::max(fullest, n);
+    CHECK(fullest < 2 * count / 256);
+}
+
+TEST(SetGrowsAndKeepsInsertionOrder)
+{
+    StructLayout layout(RecordText);
+    RecordHashSet set(layout);
+    const uint64_t distinct = 3000;
+    for (uint64_t i = 0; i < 3 * distinct; ++i)
+    {
+        std::pair<size_t, bool> result = set.insert(MakeRecord(layout, i % distinct, i).data());
+        if (result.second != (i < distinct) || result.first != i % distinct)
+        {
+            CHECK(false);
+            break;
+        }
+    }
+    CHECK_EQ(static_cast<size_t>(distinct), set.size());
+    CHECK_EQ(static_cast<long long>(1234), set.find(MakeRecord(layout, 1234, 3).data()));
+    CHECK(!set.contains(MakeRecord(layout, distinct, 0).data()));
+    CHECK(std::vector<char>(set.record(2), set.record(2) + layout.size()) == MakeRecord(layout, 2, 2));
+    set.clear();
+    CHECK_EQ(static_cast<size_t>(0), set.size());
+    CHECK(!set.contains(MakeRecord(layout, 2, 2).data()));
+}
+
+TEST(MapCountsAndDeduplication)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records;
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        std::vector<char> record = MakeRecord(layout, (i * 7) % 50, i);
+        records.insert(records.end(), record.begin(), record.end());
+    }
+    RecordHashMap<int> counts(layout);
+    for (size_t i = 0; i < 1000; ++i) ++counts[records.data() + i * layout.size()];
+    CHECK_EQ(static_cast<size_t>(50), counts.size());
+    bool even = true;
+    for (size_t row = 0; row < counts.size(); ++row) even = even && counts.value(row) == 20;
+    CHECK(even);
+    CHECK(counts.find(MakeRecord(layout, 51, 0).data()) == nullptr);
+    CHECK_EQ(20, *counts.find(MakeRecord(layout, 49, 0).data()));
+
+    std::vector<char> unique;
+    CHECK_EQ(static_cast<size_t>(50), DeduplicateRecords(layout, records.data(), 1000, unique));
+    CHECK_EQ(50 * layout.size(), unique.size());
+    CHECK(std::equal(unique.begin(), unique.end(), records.begin()));
+}
+
+TEST_MAIN()
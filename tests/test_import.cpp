@@ -0,0 +1,200 @@
+#include "test_common.h"
+#include "../struct_import.h"
+#include "../struct_export.h"
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+
+const char* const RecordText =
+    "struct Fill { uint64_t id; int32_t qty; float ratio; double price; int16_t delta : 5; int16_t side : 11; };";
+
+std::vector<char> ParseAll(RecordImporter& importer, const StructLayout& layout, const std::string& text,
+                           size_t& count)
+{
+    std::vector<char> records(16 * layout.size());
+    size_t consumed = 0;
+    count = importer.parse(text.data(), text.size(), records.data(), 16, consumed);
+    records.resize(count * layout.size());
+    return records;
+}
+
+} // namespace
+
+TEST(CsvByHeader)
+{
+    StructLayout layout(RecordText);
+    RecordImporter importer(layout, RecordImporter::Csv);
+    size_t count = 0;
+    std::vector<char> records = ParseAll(importer, layout,
+        "price, unknown ,\"id\",qty,delta\r\n"
+        "2.5,xx,18446744073709551615,-7,-16\r\n"
+        "\r\n"
+        "1e-3,,\"5\",2147483647,15\n", count);
+    CHECK_EQ(static_cast<size_t>(2), count);
+    const char* first = records.data();
+    const char* second = records.data() + layout.size();
+    CHECK_EQ(2.5, layout.readDouble(layout.fieldIndex("price"), first));
+    CHECK_EQ(~0ULL, layout.readBits(layout.fieldIndex("id"), first));
+    CHECK_EQ(static_cast<int64_t>(-7), layout.readInt(layout.fieldIndex("qty"), first));
+    CHECK_EQ(static_cast<int64_t>(-16), layout.readInt(layout.fieldIndex("delta"), first));
+    CHECK_EQ(static_cast<int64_t>(0), layout.readInt(layout.fieldIndex("side"), first));
+    CHECK_EQ(1e-3, layout.readDouble(layout.fieldIndex("price"), second));
+    CHECK_EQ(static_cast<int64_t>(5), layout.readInt(layout.fieldIndex("id"), second));
+    CHECK_EQ(static_cast<int64_t>(2147483647), layout.readInt(layout.fieldIndex("qty"), second));
+}
+
+TEST(CsvWithExplicitColumns)
+{
+    StructLayout layout(RecordText);
+    std::vector<std::string> columns;
+    columns.push_back("qty");
+    columns.push_back("");
+    columns.push_back("side");
+    RecordImporter importer(layout, columns);
+    size_t count = 0;
+    std::vector<char> records = ParseAll(importer, layout, "3,skip,-1024\n4,skip,1023", count);
+    CHECK_EQ(static_cast<size_t>(2), count);
+    CHECK_EQ(static_cast<int64_t>(-1024), layout.readInt(layout.fieldIndex("side"), records.data()));
+    CHECK_EQ(static_cast<int64_t>(4), layout.readInt(layout.fieldIndex("qty"), records.data() + layout.size()));
+    CHECK_THROWS(std::invalid_argument, RecordImporter(layout, std::vector<std::string>(1, "missing")));
+}
+
+TEST(CsvQuotedCellsKeepCommas)
+{
+    StructLayout layout(RecordText);
+    RecordImporter importer(layout, RecordImporter::Csv);
+    size_t count = 0;
+    std::vector<char> records = ParseAll(importer, layout,
+        "\"note, with \"\"comma\"\"\",qty,\"id\",\"a,b\",price\n"
+        "\"x, y\",3,\"7\",\"\"\"q\"\", r\",2.5\n"
+        "\",\",-4,8,,0.5\n", count);
+    CHECK_EQ(static_cast<size_t>(2), count);
+    CHECK_EQ(static_cast<int64_t>(3), layout.readInt(layout.fieldIndex("qty"), records.data()));
+    CHECK_EQ(static_cast<int64_t>(7), layout.readInt(layout.fieldIndex("id"), records.data()));
+    CHECK_EQ(2.5, layout.readDouble(layout.fieldIndex("price"), records.data()));
+    const char* second = records.data() + layout.size();
+    CHECK_EQ(static_cast<int64_t>(-4), layout.readInt(layout.fieldIndex("qty"), second));
+    CHECK_EQ(static_cast<int64_t>(8), layout.readInt(layout.fieldIndex("id"), second));
+    CHECK_EQ(0.5, layout.readDouble(layout.fieldIndex("price"), second));
+
+    // Запятая в кавычках - часть ячейки, а не разделитель: число с ней не разбирается
+    RecordImporter strict(layout, std::vector<std::string>(1, "price"));
+    CHECK_THROWS(std::runtime_error, ParseAll(strict, layout, "\"1,5\"\n", count));
+}
+
+TEST(NdJsonKeysInAnyOrder)
+{
+    StructLayout layout(RecordText);
+    RecordImporter importer(layout, RecordImporter::NdJson);
+    size_t count = 0;
+    std::vector<char> records = ParseAll(importer, layout,
+        "{\"id\": 1, \"price\": 10.25, \"extra\": \"text\", \"qty\": null}\n"
+        "{ \"qty\" : -3 , \"id\" : \"2\" , \"ratio\" : true }\n"
+        "{}\n", count);
+    CHECK_EQ(static_cast<size_t>(3), count);
+    const char* first = records.data();
+    const char* second = records.data() + layout.size();
+    CHECK_EQ(static_cast<int64_t>(1), layout.readInt(layout.fieldIndex("id"), first));
+    CHECK_EQ(10.25, layout.readDouble(layout.fieldIndex("price"), first));
+    CHECK_EQ(static_cast<int64_t>(0), layout.readInt(layout.fieldIndex("qty"), first));
+    CHECK_EQ(static_cast<int64_t>(-3), layout.readInt(layout.fieldIndex("qty"), second));
+    CHECK_EQ(static_cast<int64_t>(2), layout.readInt(layout.fieldIndex("id"), second));
+    CHECK_EQ(1.0, layout.readDouble(layout.fieldIndex("ratio"), second));
+    CHECK_EQ(std::vector<char>(layout.size(), 0), std::vector<char>(records.begin() + 2 * layout.size(), records.end()));
+}
+
+TEST(ErrorsNameTheLine)
+{
+    StructLayout layout(RecordText);
+    RecordImporter json(layout, RecordImporter::NdJson);
+    std::vector<char> records(4 * layout.size());
+    size_t consumed = 0;
+    std::string text = "{\"id\": 1}\n{\"id\": [1]}\n";
+    bool named = false;
+    try
+    {
+        json.parse(text.data(), text.size(), records.data(), 4, consumed);
+    }
+    catch (const std::runtime_error& error)
+    {
+        named = std::strncmp(error.what(), "Line 2:", 7) == 0;
+    }
+    CHECK(named);
+
+    RecordImporter csv(layout, RecordImporter::Csv);
+    std::string bad = "qty\n12abc\n";
+    CHECK_THROWS(std::runtime_error, csv.parse(bad.data(), bad.size(), records.data(), 4, consumed));
+}
+
+TEST(PartialLinesWaitForMoreText)
+{
+    StructLayout layout(RecordText);
+    RecordImporter importer(layout, RecordImporter::Csv);
+    std::vector<char> records(4 * layout.size());
+    std::string text = "id,qty\n1,2\n3,";
+    size_t consumed = 0;
+    CHECK_EQ(static_cast<size_t>(1), importer.parse(text.data(), text.size(), records.data(), 4, consumed, false));
+    CHECK_EQ(text.size() - 2, consumed);
+    std::string rest = text.substr(consumed) + "4\n";
+    CHECK_EQ(static_cast<size_t>(1), importer.parse(rest.data(), rest.size(), records.data(), 4, consumed, false));
+    CHECK_EQ(rest.size(), consumed);
+    CHECK_EQ(static_cast<int64_t>(4), layout.readInt(layout.fieldIndex("qty"), records.data()));
+}
+
+TEST(ExportedFileImportsBack)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 3000;
+    std::vector<char> records(count * layout.size(), 0);
+    uint64_t seed = 7;
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        layout.writeBits(layout.fieldIndex("id"), seed, record);
+        layout.writeInt(layout.fieldIndex("qty"), static_cast<int32_t>(seed >> 32), record);
+        layout.writeDouble(layout.fieldIndex("ratio"), static_cast<double>(seed >> 40) / 7, record);
+        layout.writeDouble(layout.fieldIndex("price"), static_cast<double>(seed >> 11) * 1e-9, record);
+        layout.writeInt(layout.fieldIndex("delta"), static_cast<int64_t>(r % 32) - 16, record);
+        layout.writeInt(layout.fieldIndex("side"), static_cast<int64_t>(r % 2048) - 1024, record);
+    }
+    for (int format = 0; format < 2; ++format)
+    {
+        std::FILE* file = std::tmpfile();
+        RecordExporter(layout, format ? RecordExporter::NdJson : RecordExporter::Csv).write(records.data(), count, file);
+        std::rewind(file);
+        RecordImporter importer(layout, format ? RecordImporter::NdJson : RecordImporter::Csv);
+        std::vector<char> imported;
+        CHECK_EQ(count, importer.importFile(file, imported, 1000));
+        std::fclose(file);
+        CHECK(imported == records);
+    }
+}
+
+TEST(ParseRealMatchesStrtod)
+{
+    const char* const texts[] = { "0", "-0.5", "3.14159", "1e22", "1e23", "123456789012345678", "2.2250738585072014e-308",
+                                  "0.1", "-7.25E+3", "4.9e-324", "1.7976931348623157e308", "inf", "nan" };
+    bool same = true;
+    for (const char* text : texts)
+    {
+        double value = 0;
+        same = same && ParseReal(text, text + std::strlen(text), value);
+        double expected = std::strtod(text, nullptr);
+        same = same && (value == expected || (value != value && expected != expected));
+    }
+    CHECK(same);
+    double value;
+    const char* bad = "1.2.3";
+    CHECK(!ParseReal(bad, bad + 5, value));
+    CHECK(!ParseReal(bad, bad, value));
+}
+
+TEST_MAIN()
@@ -0,0 +1,206 @@
+#include "test_common.h"
+#include "../struct_join.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace
+{
+
+const char* const CustomerText = "struct Customer { uint32_t id; uint16_t region; double rating; uint8_t tier : 3; uint8_t spare : 5; };";
+const char* const OrderText = "struct Order { int64_t customer; float region; uint64_t total; };";
+
+std::vector<std::string> Names(const char* a, const char* b = nullptr)
+{
+    std::vector<std::string> names(1, a);
+    if (b) names.push_back(b);
+    return names;
+}
+
+std::vector<char> MakeCustomers(const StructLayout& layout, size_t count)
+{
+    std::vector<char> records(count * layout.size());
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        layout.writeInt(0, static_cast<int64_t>(r), record);
+        layout.writeInt(1, static_cast<int64_t>(r % 4), record);
+        layout.writeDouble(2, static_cast<double>(r % 50) / 10, record);
+        layout.writeInt(3, static_cast<int64_t>(r % 8), record);
+    }
+    return records;
+}
+
+std::vector<char> MakeOrders(const StructLayout& layout, size_t count)
+{
+    std::vector<char> records(count * layout.size());
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        layout.writeInt(0, static_cast<int64_t>(r * 7 % 1500), record);   // часть заказов без покупателя
+        layout.writeDouble(1, static_cast<double>(r * 7 % 1500 % 4), record);
+        layout.writeInt(2, static_cast<int64_t>(r), record);
+    }
+    return records;
+}
+
+} // namespace
+
+TEST(JoinsIntegerKeysOfDifferentWidth)
+{
+    StructLayout customers(CustomerText), orders(OrderText);
+    std::vector<char> build = MakeCustomers(customers, 1000);
+    std::vector<char> probe = MakeOrders(orders, 3000);
+    HashJoin join(customers, Names("id"), Names("rating", "tier"), orders, Names("customer"));
+    join.build(build.data(), 1000);
+    std::vector<JoinMatch> matches;
+    join.probe(probe.data(), 3000, matches);
+
+    size_t expected = 0;
+    for (size_t r = 0; r < 3000; ++r) expected += r * 7 % 1500 < 1000;
+    CHECK_EQ(expected, matches.size());
+    bool same = true;
+    for (const auto& match : matches)
+    {
+        int64_t customer = orders.readInt(0, probe.data() + match.probeIndex * orders.size());
+        same = same && join.rowLayout().read<int64_t>("id", join.buildRow(match.buildRow)) == customer;
+        same = same && join.rowLayout().read<int64_t>("tier", join.buildRow(match.buildRow)) == customer % 8;
+    }
+    CHECK(same);
+
+    ColumnSet columns = join.buildColumns(matches);
+    CHECK_EQ(matches.size(), columns.count());
+    std::vector<char> pairs(matches.size() * (orders.size() + join.rowLayout().size()));
+    join.writePairs(probe.data(), matches, pairs.data());
+    CHECK(std::memcmp(pairs.data(), probe.data() + matches[0].probeIndex * orders.size(), orders.size()) == 0);
+}
+
+// Целый ключ с одной стороны и float с другой сравниваются по значению
+TEST(JoinsIntegerWithFloatKey)
+{
+    StructLayout customers(CustomerText), orders(OrderText);
+    std::vector<char> build = MakeCustomers(customers, 1000);
+    std::vector<char> probe = MakeOrders(orders, 3000);
+    HashJoin join(customers, Names("id", "region"), Names("rating"), orders, Names("customer", "region"));
+    join.build(build.data(), 1000);
+    std::vector<JoinMatch> matches;
+    join.probe(probe.data(), 3000, matches);
+    size_t expected = 0;
+    for (size_t r = 0; r < 3000; ++r) expected += r * 7 % 1500 < 1000;
+    CHECK_EQ(expected, matches.size());
+
+    // -0.0 и 0.0 - один ключ
+    StructLayout a("struct A { double key; };"), b("struct B { int32_t key; };");
+    std::vector<char> left(a.size()), right(b.size());
+    a.writeDouble(0, -0.0, left.data());
+    b.writeInt(0, 0, right.data());
+    HashJoin zero(a, Names("key"), std::vector<std::string>(), b, Names("key"));
+    zero.build(left.data(), 1);
+    std::vector<JoinMatch> zeroMatches;
+    zero.probe(right.data(), 1, zeroMatches);
+    CHECK_EQ(1u, zeroMatches.size());
+}
+
+TEST(UnsignedAndNegativeKeysNeverMatch)
+{
+    StructLayout a("struct A { uint64_t key; };"), b("struct B { int64_t key; };"), c("struct C { int8_t key; };");
+    const uint64_t unsignedKeys[] = { ~0ULL, 1ULL << 63, 5 };
+    const int64_t signedKeys[] = { -1, INT64_MIN, 5, -5 };
+    std::vector<char> left(3 * a.size()), right(4 * b.size()), narrow(4 * c.size());
+    for (size_t i = 0; i < 3; ++i) a.writeBits(0, unsignedKeys[i], left.data() + i * a.size());
+    for (size_t i = 0; i < 4; ++i)
+    {
+        b.writeInt(0, signedKeys[i], right.data() + i * b.size());
+        c.writeInt(0, i == 1 ? -128 : signedKeys[i], narrow.data() + i * c.size());
+    }
+    for (int side = 0; side < 2; ++side)
+    {
+        // uint64_t на build- и на probe-стороне
+        std::vector<JoinMatch> matches;
+        if (side == 0)
+        {
+            HashJoin join(a, Names("key"), std::vector<std::string>(), b, Names("key"));
+            join.build(left.data(), 3);
+            join.probe(right.data(), 4, matches);
+        }
+        else
+        {
+            HashJoin join(b, Names("key"), std::vector<std::string>(), a, Names("key"));
+            join.build(right.data(), 4);
+            join.probe(left.data(), 3, matches);
+        }
+        CHECK_EQ(1u, matches.size());
+        CHECK_EQ(static_cast<size_t>(2), (side == 0 ? matches[0].probeIndex : matches[0].buildRow));
+    }
+    HashJoin narrowJoin(a, Names("key"), std::vector<std::string>(), c, Names("key"));
+    narrowJoin.build(left.data(), 3);
+    std::vector<JoinMatch> narrowMatches;
+    narrowJoin.probe(narrow.data(), 4, narrowMatches);
+    CHECK_EQ(1u, narrowMatches.size());
+}
+
+TEST(IncrementalBuildMatchesSingleBuild)
+{
+    StructLayout customers(CustomerText), orders(OrderText);
+    std::vector<char> build = MakeCustomers(customers, 1000);
+    std::vector<char> probe = MakeOrders(orders, 3000);
+    HashJoin once(customers, Names("region"), Names("id"), orders, Names("region"));
+    HashJoin incremental(customers, Names("region"), Names("id"), orders, Names("region"));
+    once.build(build.data(), 1000);
+    for (size_t r = 0; r < 1000; ++r) incremental.build(build.data() + r * customers.size(), 1);
+    std::vector<JoinMatch> a, b;
+    once.probe(probe.data(), 3000, a);
+    incremental.probe(probe.data(), 3000, b);
+    CHECK_EQ(a.size(), b.size());
+    bool same = a.size() == b.size();
+    for (size_t i = 0; same && i < a.size(); ++i)
+    {
+        same = a[i].probeIndex == b[i].probeIndex && a[i].buildRow == b[i].buildRow;
+    }
+    CHECK(same);
+    // Строки одной цепочки идут в исходном порядке
+    CHECK(a.size() > 1 && a[0].probeIndex == a[1].probeIndex && a[0].buildRow < a[1].buildRow);
+
+    // Много маленьких вызовов build не перестраивают таблицу каждый раз
+    HashJoin many(customers, Names("id"), std::vector<std::string>(), orders, Names("customer"));
+    std::vector<char> big = MakeCustomers(customers, 200000);
+    for (size_t r = 0; r < 200000; ++r) many.build(big.data() + r * customers.size(), 1);
+    CHECK_EQ(200000u, many.rowCount());
+}
+
+TEST(JoinRecordsBuildsOnTheSmallerSide)
+{
+    StructLayout customers(CustomerText), orders(OrderText);
+    std::vector<char> few = MakeCustomers(customers, 300);
+    std::vector<char> many = MakeOrders(orders, 2000);
+    std::vector<JoinPair> pairs = JoinRecords(orders, Names("customer"), many.data(), 2000,
+                                              customers, Names("id"), few.data(), 300);
+    std::vector<JoinPair> swapped = JoinRecords(customers, Names("id"), few.data(), 300,
+                                                orders, Names("customer"), many.data(), 2000);
+    size_t expected = 0;
+    for (size_t r = 0; r < 2000; ++r) expected += r * 7 % 1500 < 300;
+    CHECK_EQ(expected, pairs.size());
+    CHECK_EQ(expected, swapped.size());
+
+    bool ordered = true, matching = true;
+    for (size_t i = 0; i < pairs.size(); ++i)
+    {
+        const JoinPair& p = pairs[i];
+        ordered = ordered && (i == 0 || pairs[i - 1].leftIndex < p.leftIndex);
+        matching = matching && orders.readInt(0, many.data() + p.leftIndex * orders.size()) ==
+                               customers.readInt(0, few.data() + p.rightIndex * customers.size());
+    }
+    CHECK(ordered);
+    CHECK(matching);
+    CHECK(swapped.size() > 1 && swapped[0].leftIndex == 0 && swapped[0].rightIndex == 0);
+}
+
+TEST(RejectsMismatchedKeys)
+{
+    StructLayout customers(CustomerText), orders(OrderText);
+    CHECK_THROWS(std::invalid_argument, HashJoin(customers, Names("id", "region"), Names("id"), orders, Names("customer")));
+    CHECK_THROWS(std::invalid_argument, HashJoin(customers, Names("id"), Names("id"), orders, Names("missing")));
+}
+
+TEST_MAIN()
@@ -0,0 +1,77 @@
+#include "test_common.h"
+#include "../struct_layout.h"
+
+#include <vector>
+
+TEST(PlainFieldsRoundTrip)
+{
+    StructLayout layout("struct Point { int32_t x; uint16_t y; double z; };");
+    CHECK_EQ(std::string("Point"), layout.name());
+    CHECK_EQ(14u, layout.size());
+    std::vector<char> record(layout.size());
+    layout.writeInt(layout.fieldIndex("x"), -5, record.data());
+    layout.writeInt(layout.fieldIndex("y"), 65535, record.data());
+    layout.writeDouble(layout.fieldIndex("z"), 2.5, record.data());
+    CHECK_EQ(-5, layout.read<int>("x", record.data()));
+    CHECK_EQ(65535, layout.read<int>("y", record.data()));
+    CHECK_EQ(2.5, layout.read<double>("z", record.data()));
+}
+
+TEST(BitFieldsSignExtendAndKeepNeighbours)
+{
+    StructLayout layout("struct Flags { int8_t a : 3; uint8_t b : 5; };");
+    std::vector<char> record(layout.size());
+    layout.writeInt(0, -2, record.data());
+    layout.writeInt(1, 31, record.data());
+    CHECK_EQ(-2, layout.readInt(0, record.data()));
+    CHECK_EQ(31, layout.readInt(1, record.data()));
+    layout.writeInt(1, 0x3F, record.data());   // лишний старший бит отбрасывается
+    CHECK_EQ(31, layout.readInt(1, record.data()));
+    CHECK_EQ(-2, layout.readInt(0, record.data()));
+}
+
+TEST(UnknownFieldThrows)
+{
+    StructLayout layout("struct A { uint8_t a; };");
+    CHECK_EQ(-1, layout.indexOf("b"));
+    CHECK_THROWS(std::invalid_argument, layout.fieldIndex("b"));
+}
+
+// Неполный последний контейнер: парсер считает его за 1 байт,
+// а контейнер uint32_t по смещению 2 читается и пишется целиком
+TEST(PartialTrailingContainerFitsInRecord)
+{
+    const char* text = "struct Header { uint16_t len; uint32_t type : 4; uint32_t flags : 3; };";
+    CHECK_EQ(3, StructSizeOf(text));
+    StructLayout layout(text);
+    CHECK_EQ(6u, layout.size());
+
+    // Буфер ровно по размеру записи: под ASan выход за границу виден сразу
+    std::vector<char> records(2 * layout.size());
+    for (size_t r = 0; r < 2; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        layout.writeInt(0, 1000 + static_cast<int64_t>(r), record);
+        layout.writeInt(1, 9, record);
+        layout.writeInt(2, 5, record);
+    }
+    CHECK_EQ(1001, layout.readInt(0, records.data() + layout.size()));
+    CHECK_EQ(9, layout.readInt(1, records.data() + layout.size()));
+    CHECK_EQ(5, layout.readInt(2, records.data() + layout.size()));
+    CHECK_EQ(1000, layout.readInt(0, records.data()));
+
+    std::vector<unsigned char> mask = layout.valueMask();
+    CHECK_EQ(6u, mask.size());
+    CHECK_EQ(0x7F, mask[2]);
+    CHECK_EQ(0, mask[5]);
+}
+
+TEST(FieldTableMustFitInRecord)
+{
+    StructLayout parsed("struct Header { uint16_t len; uint32_t type : 4; };");
+    CHECK_THROWS(std::invalid_argument, StructLayout("Header", 3, parsed.fields()));
+    StructLayout table("Header", parsed.size(), parsed.fields());
+    CHECK_EQ(parsed.size(), table.size());
+}
+
+TEST_MAIN()
@@ -0,0 +1,162 @@
+#include "test_common.h"
+#include "../struct_layoutcache.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdio>
+#include <cstdint>
+
+namespace
+{
+
+const char* const TextA = "struct A { uint32_t id; uint16_t kind : 4; uint16_t level : 12; double price; };";
+const char* const TextB = "struct B { uint8_t flag; int64_t value; };";
+
+// Файл кеша в рабочем каталоге теста, удаляется при выходе из области
+struct TempPath
+{
+    std::string path;
+
+    explicit TempPath(const char* name) : path(std::string("test_layoutcache_") + name + ".splc") {}
+    ~TempPath() { std::remove(path.c_str()); }
+};
+
+void WriteFile(const std::string& path, const std::string& bytes)
+{
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    std::fwrite(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+}
+
+bool SameLayout(const StructLayout& a, const StructLayout& b)
+{
+    if (a.name() != b.name() || a.size() != b.size() || a.fieldCount() != b.fieldCount()) return false;
+    for (size_t i = 0; i < a.fieldCount(); ++i)
+    {
+        const StructLayout::Field& x = a.field(i);
+        const StructLayout::Field& y = b.field(i);
+        if (x.name != y.name || x.byteOffset != y.byteOffset || x.bitOffset != y.bitOffset ||
+            x.bitWidth != y.bitWidth || x.size != y.size || x.kind != y.kind)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST(SavedLayoutsAreReusedByTheNextCache)
+{
+    TempPath file("reuse");
+    {
+        LayoutCache cache(file.path);
+        cache.get(TextA);
+        cache.get(TextB);
+        CHECK_EQ(static_cast<size_t>(2), cache.misses());
+        CHECK(cache.dirty());
+        cache.save();
+        CHECK(!cache.dirty());
+    }
+    LayoutCache cache(file.path);
+    const StructLayout& a = cache.get(TextA);
+    CHECK_EQ(static_cast<size_t>(1), cache.hits());
+    CHECK_EQ(static_cast<size_t>(0), cache.misses());
+    CHECK(SameLayout(StructLayout(TextA), a));
+    CHECK(SameLayout(StructLayout(TextB), cache.get(TextB)));
+    CHECK(!cache.dirty());
+}
+
+TEST(HashCollisionDoesNotReturnAnotherLayout)
+{
+    // Запись с хешем текста B, но layout и текстом A: так выглядит коллизия хешей
+    TempPath file("collision");
+    std::string blob;
+    BinaryWriter(blob).str(TextA);
+    SerializeLayout(StructLayout(TextA), blob);
+    std::string bytes;
+    BinaryWriter writer(bytes);
+    writer.bytes("SPLC", 4);
+    writer.u16(2);
+    writer.u16(0);
+    writer.u32(1);
+    writer.u64(HashStructText(TextB));
+    writer.u32(12 + 20);
+    writer.u32(static_cast<uint32_t>(blob.size()));
+    writer.u32(Crc32(blob.data(), blob.size()));
+    writer.bytes(blob.data(), blob.size());
+    WriteFile(file.path, bytes);
+
+    LayoutCache cache(file.path);
+    const StructLayout& b = cache.get(TextB);
+    CHECK_EQ(std::string("B"), b.name());
+    CHECK_EQ(static_cast<size_t>(1), cache.misses());
+    CHECK(cache.dirty());
+}
+
+TEST(PublishedLayoutsStayInPlace)
+{
+    TempPath file("stable");
+    LayoutCache cache(file.path);
+    const StructLayout* first = &cache.get(TextA);
+    for (int i = 0; i < 200; ++i)
+    {
+        cache.get("struct S" + std::to_string(i) + " { uint32_t x; uint16_t y; };");
+    }
+    CHECK(first == &cache.get(TextA));
+    CHECK_EQ(std::string("A"), first->name());
+    CHECK_EQ(static_cast<size_t>(201), cache.misses());
+
+    std::vector<const StructLayout*> seen(8);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < seen.size(); ++t)
+    {
+        threads.push_back(std::thread([&cache, &seen, t]() { seen[t] = &cache.get(TextB); }));
+    }
+    for (auto& thread : threads) thread.join();
+    for (size_t t = 1; t < seen.size(); ++t) CHECK(seen[t] == seen[0]);
+    CHECK(first == &cache.get(TextA));
+}
+
+TEST(CountersAreReadWhileOtherThreadsLoad)
+{
+    TempPath file("counters");
+    LayoutCache cache(file.path);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.push_back(std::thread([&cache, t]()
+        {
+            for (int i = 0; i < 50; ++i) cache.get("struct T" + std::to_string(t * 50 + i) + " { uint32_t x; };");
+        }));
+    }
+    size_t observed = 0;
+    bool growing = true;
+    while (observed < 200)
+    {
+        size_t now = cache.hits() + cache.misses();
+        growing = growing && now >= observed && (now == 0 || cache.dirty());
+        observed = now;
+    }
+    for (auto& thread : threads) thread.join();
+    CHECK(growing);
+    CHECK_EQ(static_cast<size_t>(200), cache.misses());
+    CHECK_EQ(static_cast<size_t>(0), cache.hits());
+}
+
+TEST(CorruptedFileIsRebuilt)
+{
+    TempPath file("corrupt");
+    WriteFile(file.path, std::string("SPLC\x02\x00\x00\x00\xFF\xFF\xFF\x7F", 12));
+    LayoutCache cache(file.path);
+    CHECK(cache.dirty());
+    CHECK(SameLayout(StructLayout(TextA), cache.get(TextA)));
+    cache.save();
+
+    LayoutCache reread(file.path);
+    reread.get(TextA);
+    CHECK_EQ(static_cast<size_t>(1), reread.hits());
+}
+
+TEST_MAIN()
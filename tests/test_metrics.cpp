@@ -0,0 +1,70 @@
+#include "test_common.h"
+#include "../struct_metrics.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+namespace
+{
+
+// Значение строки "<name>{le="<le>"} <value>" из текста Prometheus; -1, если строки нет
+long long BucketValue(const std::string& text, const std::string& le)
+{
+    std::string key = "struct_parse_duration_seconds_bucket{le=\"" + le + "\"} ";
+    size_t at = text.find(key);
+    return at == std::string::npos ? -1 : std::atoll(text.c_str() + at + key.size());
+}
+
+} // namespace
+
+TEST(BucketBoundsAreExact)
+{
+    LatencyHistogram histogram;
+    histogram.record(1023);
+    histogram.record(1024);
+    histogram.record(1100);
+    histogram.record(2047);
+    histogram.record(2048);
+    CHECK_EQ(static_cast<uint64_t>(1), histogram.countAtMost(1023));
+    CHECK_EQ(static_cast<uint64_t>(4), histogram.countAtMost(2047));
+    CHECK_EQ(static_cast<uint64_t>(5), histogram.countAtMost(4095));
+    // Внутри корзины граница не точна: 1024..1087 - одна корзина
+    CHECK_EQ(static_cast<uint64_t>(2), histogram.countAtMost(1024));
+    CHECK_EQ(static_cast<uint64_t>(2), histogram.countAtMost(1087));
+}
+
+TEST(PrometheusBucketsMatchRecordedValues)
+{
+    StructMetrics& metrics = StructMetrics::instance();
+    std::vector<uint64_t> values = { 500, 1023, 1024, 2047, 2048, 1000000, (1ULL << 30) - 1, 1ULL << 30, 5000000000ULL };
+    for (uint64_t value : values) metrics.parseLatency.record(value);
+    std::string text = metrics.prometheusText();
+
+    CHECK_EQ(2LL, BucketValue(text, "1.023e-06"));
+    CHECK_EQ(4LL, BucketValue(text, "2.047e-06"));
+    CHECK_EQ(5LL, BucketValue(text, "4.095e-06"));
+    CHECK_EQ(6LL, BucketValue(text, "0.001048575"));
+    CHECK_EQ(7LL, BucketValue(text, "1.073741823"));
+    CHECK_EQ(static_cast<long long>(values.size()), BucketValue(text, "+Inf"));
+    CHECK_EQ(-1LL, BucketValue(text, "1e-06"));
+
+    // Значения le возрастают, счетчики не убывают
+    double previousLe = 0;
+    long long previousCount = 0;
+    bool monotonic = true;
+    for (size_t at = text.find("le=\""); at != std::string::npos; at = text.find("le=\"", at + 1))
+    {
+        if (text.compare(at + 4, 4, "+Inf") == 0) break;
+        double le = std::atof(text.c_str() + at + 4);
+        long long count = std::atoll(text.c_str() + text.find("} ", at) + 2);
+        monotonic = monotonic && le > previousLe && count >= previousCount;
+        previousLe = le;
+        previousCount = count;
+    }
+    CHECK(monotonic);
+    CHECK(text.find('\r') == std::string::npos);
+}
+
+TEST_MAIN()
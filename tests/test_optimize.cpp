@@ -0,0 +1,94 @@
+#include "test_common.h"
+#include "../struct_optimize.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace
+{
+
+std::vector<std::string> FieldNames(const StructLayout& layout)
+{
+    std::vector<std::string> names;
+    for (const auto& field : layout.fields()) names.push_back(field.name);
+    return names;
+}
+
+} // namespace
+
+TEST(NaturalAbiSortsByAlignment)
+{
+    StructLayout layout("struct S { uint8_t a; uint64_t b; uint8_t c; uint32_t d; uint16_t e; };");
+    LayoutOptimizer optimizer(layout);
+    LayoutFootprint before = optimizer.current();
+    CHECK_EQ(static_cast<size_t>(32), before.size);     // a@0 b@8 c@16 d@20 e@24, хвост до 32
+    CHECK_EQ(static_cast<size_t>(16), before.padding);
+    CHECK_EQ(static_cast<size_t>(1), before.cacheLines);
+    LayoutFootprint after = optimizer.proposed();
+    CHECK_EQ(static_cast<size_t>(16), after.size);
+    CHECK_EQ(static_cast<size_t>(0), after.padding);
+    CHECK_EQ(static_cast<size_t>(0), after.hotCacheLines);
+
+    StructLayout reparsed(optimizer.proposedText());
+    CHECK_EQ(layout.name(), reparsed.name());
+    std::vector<std::string> expected = { "b", "d", "e", "a", "c" };
+    CHECK(FieldNames(reparsed) == expected);
+    CHECK_EQ(static_cast<size_t>(16), reparsed.size());
+}
+
+TEST(PackedAbiHasNoPadding)
+{
+    StructLayout layout("struct S { uint8_t a; uint64_t b; uint8_t c; uint32_t d; uint16_t e; };");
+    LayoutOptimizer optimizer(layout, PackedAbi);
+    CHECK_EQ(layout.size(), optimizer.current().size);
+    CHECK_EQ(static_cast<size_t>(0), optimizer.current().padding);
+    CHECK_EQ(layout.size(), optimizer.proposed().size);
+}
+
+TEST(BitFieldsArePackedFirstFit)
+{
+    // Исходно: a | b c | d - три контейнера uint32_t и выравнивание перед x
+    StructLayout layout("struct B { uint32_t a : 20; uint32_t b : 20; uint32_t c : 12; uint32_t d : 12; uint64_t x; };");
+    LayoutOptimizer optimizer(layout);
+    CHECK_EQ(static_cast<size_t>(24), optimizer.current().size);
+    CHECK_EQ(static_cast<size_t>(4), optimizer.current().padding);
+    CHECK_EQ(static_cast<size_t>(16), optimizer.proposed().size);
+
+    StructLayout reparsed(optimizer.proposedText());
+    std::vector<std::string> expected = { "x", "a", "c", "b", "d" };
+    CHECK(FieldNames(reparsed) == expected);
+    CHECK_EQ(reparsed.field(1).byteOffset, reparsed.field(2).byteOffset);
+    CHECK_EQ(reparsed.field(3).byteOffset, reparsed.field(4).byteOffset);
+    CHECK_EQ(static_cast<size_t>(16), reparsed.size());
+}
+
+TEST(ProfileMovesHotFieldsToTheFirstLine)
+{
+    std::string text = "struct P { uint32_t hotA;";
+    for (int i = 0; i < 10; ++i) text += " uint64_t cold" + std::to_string(i) + ";";
+    text += " uint16_t spare; uint64_t hotB; };";
+    StructLayout layout(text);
+    LayoutOptimizer optimizer(layout);
+    std::map<std::string, uint64_t> profile;
+    profile["hotA"] = 1000;
+    profile["hotB"] = 500;
+    optimizer.setProfile(profile);
+
+    LayoutFootprint before = optimizer.current();
+    CHECK_EQ(static_cast<size_t>(2), before.cacheLines);
+    CHECK_EQ(static_cast<size_t>(2), before.hotCacheLines);
+    LayoutFootprint after = optimizer.proposed();
+    CHECK_EQ(static_cast<size_t>(1), after.hotCacheLines);
+    CHECK(after.size <= before.size);
+
+    // Горячие поля впереди (по выравниванию), spare закрывает дыру после hotA
+    std::vector<std::string> names = FieldNames(StructLayout(optimizer.proposedText()));
+    CHECK_EQ(std::string("hotB"), names[0]);
+    CHECK_EQ(std::string("hotA"), names[1]);
+    CHECK_EQ(std::string("spare"), names[2]);
+    CHECK_EQ(std::string("cold0"), names[3]);
+}
+
+TEST_MAIN()
@@ -0,0 +1,104 @@
+#include "test_common.h"
+#include "../struct_pipeline.h"
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+namespace
+{
+
+const char* const RecordText = "struct Event { uint32_t id; uint16_t kind : 4; uint16_t flags : 12; };";
+
+// Прогон, в котором вывод проверяет, что пакеты идут по порядку и без пропусков
+void RunOrdered(size_t decoders, size_t batchCount, size_t recordsPerBatch, size_t totalRecords)
+{
+    StructLayout layout(RecordText);
+    RecordPipeline<std::vector<uint32_t> > pipeline(layout, recordsPerBatch, batchCount, decoders);
+    size_t produced = 0;
+    auto read = [&](char* buffer, size_t maxRecords) -> size_t
+    {
+        size_t n = std::min(maxRecords, totalRecords - produced);
+        for (size_t r = 0; r < n; ++r)
+        {
+            layout.writeBits(0, produced + r, buffer + r * layout.size());
+            layout.writeBits(1, (produced + r) % 16, buffer + r * layout.size());
+        }
+        produced += n;
+        return n;
+    };
+    size_t decodedBatches = 0;
+    auto decode = [&](const StructLayout& l, const char* records, size_t count, std::vector<uint32_t>& out)
+    {
+        out.clear();
+        for (size_t r = 0; r < count; ++r) out.push_back(static_cast<uint32_t>(l.readBits(0, records + r * l.size())));
+        // Неравномерная длительность декодирования: декодеры обгоняют друг друга
+        if (out[0] % 3 == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+    };
+    uint32_t expected = 0;
+    bool ordered = true;
+    auto sink = [&](const std::vector<uint32_t>& out, size_t count)
+    {
+        ordered = ordered && out.size() == count;
+        for (uint32_t id : out) ordered = ordered && id == expected++;
+        ++decodedBatches;
+    };
+    pipeline.run(read, decode, sink);
+    CHECK(ordered);
+    CHECK_EQ(totalRecords, static_cast<size_t>(expected));
+    CHECK_EQ((totalRecords + recordsPerBatch - 1) / recordsPerBatch, decodedBatches);
+}
+
+} // namespace
+
+TEST(RingsKeepFifoOrderAndCapacity)
+{
+    SpscRing<int> spsc(3);
+    CHECK_EQ(4u, spsc.capacity());
+    MpmcRing<int> mpmc(4);
+    for (int i = 0; i < 4; ++i)
+    {
+        CHECK(spsc.tryPush(i));
+        CHECK(mpmc.tryPush(i));
+    }
+    CHECK(!spsc.tryPush(4));
+    CHECK(!mpmc.tryPush(4));
+    for (int i = 0; i < 4; ++i)
+    {
+        int a = -1, b = -1;
+        CHECK(spsc.tryPop(a) && a == i);
+        CHECK(mpmc.tryPop(b) && b == i);
+    }
+    int item;
+    CHECK(!spsc.tryPop(item));
+    CHECK(!mpmc.tryPop(item));
+}
+
+TEST(SingleDecoderKeepsOrder)
+{
+    RunOrdered(1, 4, 64, 10000);
+}
+
+// Три декодера на шесть пакетов: раньше декодеры, ушедшие вперед, занимали
+// все результаты, и конвейер зависал
+TEST(ManyDecodersDoNotDeadlock)
+{
+    for (int run = 0; run < 5; ++run)
+    {
+        RunOrdered(3, 6, 16, 3000);
+        RunOrdered(4, 8, 7, 2000);
+    }
+}
+
+TEST(DecoderErrorIsRethrown)
+{
+    StructLayout layout(RecordText);
+    RecordPipeline<int> pipeline(layout, 8, 4, 2);
+    auto read = [](char*, size_t maxRecords) -> size_t { return maxRecords; };
+    auto decode = [](const StructLayout&, const char*, size_t, int&) { throw std::runtime_error("decode failed"); };
+    auto sink = [](const int&, size_t) {};
+    CHECK_THROWS(std::runtime_error, pipeline.run(read, decode, sink));
+}
+
+TEST_MAIN()
@@ -0,0 +1,125 @@
+// Собирается с -DSTRUCT_LAYOUT_PROFILE (CMakeLists.txt)
+#include "test_common.h"
+#include "../struct_layout.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdint>
+
+namespace
+{
+
+const char* const RecordText = "struct Tick { uint64_t seq; uint32_t venue : 8; uint32_t qty : 24; double price; };";
+
+// Счетчики поля из снимка; нулевая запись, если layout или поля нет
+FieldProfileEntry Counts(const std::string& layoutName, size_t fieldCount, const std::string& fieldName)
+{
+    for (const auto& layout : FieldProfile::snapshot())
+    {
+        if (layout.name != layoutName || layout.fields.size() != fieldCount) continue;
+        for (const auto& field : layout.fields)
+        {
+            if (field.name == fieldName) return field;
+        }
+    }
+    FieldProfileEntry none = { fieldName, false, 0, 0, 0, 0, 0 };
+    return none;
+}
+
+} // namespace
+
+TEST(LayoutAccessesAreCounted)
+{
+    FieldProfile::reset();
+    StructLayout layout(RecordText);
+    std::vector<char> record(layout.size(), 0);
+    for (int i = 0; i < 10; ++i) layout.writeInt(layout.fieldIndex("qty"), i, record.data());
+    for (int i = 0; i < 3; ++i) layout.readDouble(layout.fieldIndex("price"), record.data());
+
+    FieldProfileEntry qty = Counts("Tick", 4, "qty");
+    CHECK_EQ(static_cast<uint64_t>(0), qty.reads);
+    CHECK_EQ(static_cast<uint64_t>(10), qty.writes);
+    CHECK_EQ(static_cast<uint64_t>(40), qty.bytes);
+    CHECK(qty.isBitField);
+    FieldProfileEntry price = Counts("Tick", 4, "price");
+    CHECK_EQ(static_cast<uint64_t>(3), price.reads);
+    CHECK_EQ(static_cast<uint64_t>(0), Counts("Tick", 4, "seq").accesses());
+
+    // Копия layout делит счетчики с оригиналом
+    StructLayout copy = layout;
+    copy.readBits(0, record.data());
+    CHECK_EQ(static_cast<uint64_t>(1), Counts("Tick", 4, "seq").reads);
+}
+
+TEST(LayoutRebuiltAtTheSameAddress)
+{
+    FieldProfile::reset();
+    StructLayout layout("struct Small { uint32_t a; };");
+    std::vector<char> record(64, 0);
+    layout.readBits(0, record.data());
+    // Тот же объект, но таблица на 4 поля: счетчики старой таблицы не годятся
+    layout = StructLayout("struct Small { uint32_t a; uint32_t b; uint32_t c; uint32_t d; };");
+    for (size_t f = 0; f < layout.fieldCount(); ++f) layout.readBits(f, record.data());
+    layout.readBits(3, record.data());
+
+    CHECK_EQ(static_cast<uint64_t>(1), Counts("Small", 1, "a").reads);
+    CHECK_EQ(static_cast<uint64_t>(1), Counts("Small", 4, "a").reads);
+    CHECK_EQ(static_cast<uint64_t>(2), Counts("Small", 4, "d").reads);
+}
+
+TEST(ParserAccessorsAreCounted)
+{
+    FieldProfile::reset();
+    std::vector<char> record(64, 0);
+    CHECK_EQ(0, StructWrite(RecordText, "venue", static_cast<int64_t>(7), record.data()));
+    CHECK_EQ(0, StructWrite(RecordText, "venue", static_cast<int64_t>(9), record.data()));
+    CHECK_EQ(static_cast<uint32_t>(9), BitFieldStructParser::struct_read<uint32_t>(RecordText, "venue", record.data()));
+    CHECK_EQ(-1, StructWrite(RecordText, "missing", static_cast<int64_t>(1), record.data()));
+
+    FieldProfileEntry venue = Counts("Tick", 4, "venue");
+    CHECK_EQ(static_cast<uint64_t>(1), venue.reads);
+    CHECK_EQ(static_cast<uint64_t>(2), venue.writes);
+    CHECK_EQ(static_cast<uint64_t>(0), Counts("Tick", 4, "qty").accesses());
+}
+
+TEST(FinishedThreadsAreSummed)
+{
+    FieldProfile::reset();
+    StructLayout layout(RecordText);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.push_back(std::thread([&layout]()
+        {
+            std::vector<char> record(layout.size(), 0);
+            for (int i = 0; i < 1000; ++i) layout.writeInt(0, i, record.data());
+        }));
+    }
+    for (auto& thread : threads) thread.join();
+    CHECK_EQ(static_cast<uint64_t>(4000), Counts("Tick", 4, "seq").writes);
+}
+
+TEST(ParserAccessorsFromThreads)
+{
+    FieldProfile::reset();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.push_back(std::thread([]()
+        {
+            std::vector<char> record(64, 0);
+            for (int i = 0; i < 50; ++i)
+            {
+                StructWrite(RecordText, "qty", static_cast<int64_t>(i), record.data());
+                BitFieldStructParser::struct_read<uint32_t>(RecordText, "qty", record.data());
+            }
+        }));
+    }
+    for (auto& thread : threads) thread.join();
+    FieldProfileEntry qty = Counts("Tick", 4, "qty");
+    CHECK_EQ(static_cast<uint64_t>(200), qty.reads);
+    CHECK_EQ(static_cast<uint64_t>(200), qty.writes);
+}
+
+TEST_MAIN()
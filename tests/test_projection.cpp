@@ -0,0 +1,93 @@
+#include "test_common.h"
+#include "../struct_projection.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const char* const RecordText =
+    "struct Trade { uint64_t id; double price; uint32_t qty; uint16_t side : 1; uint16_t venue : 15; uint64_t ts; };";
+
+std::vector<char> MakeRecords(const StructLayout& layout, size_t count)
+{
+    std::vector<char> records(count * layout.size());
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        layout.writeInt(0, static_cast<int64_t>(r), record);
+        layout.writeDouble(1, 100.0 + static_cast<double>(r), record);
+        layout.writeInt(2, static_cast<int64_t>(r * 3), record);
+        layout.writeInt(3, static_cast<int64_t>(r & 1), record);
+        layout.writeInt(4, static_cast<int64_t>(r % 100), record);
+        layout.writeInt(5, static_cast<int64_t>(r * 1000), record);
+    }
+    return records;
+}
+
+std::vector<std::string> Names(const char* a, const char* b, const char* c = nullptr)
+{
+    std::vector<std::string> names;
+    names.push_back(a);
+    names.push_back(b);
+    if (c) names.push_back(c);
+    return names;
+}
+
+} // namespace
+
+TEST(RangesCoverOnlySelectedFields)
+{
+    StructLayout layout(RecordText);
+    Projection projection(layout, Names("price", "venue", "qty"));
+    // price [8, 16) и qty [16, 20) сливаются, контейнер venue [20, 22) примыкает к ним
+    CHECK_EQ(1u, projection.ranges().size());
+    CHECK_EQ(8u, projection.ranges()[0].offset);
+    CHECK_EQ(14u, projection.bytesPerRecord());
+
+    Projection split(layout, Names("id", "ts"));
+    CHECK_EQ(2u, split.ranges().size());
+    CHECK_EQ(16u, split.bytesPerRecord());
+    CHECK_THROWS(std::invalid_argument, Projection(layout, Names("id", "missing")));
+}
+
+TEST(DecodeMatchesFullTranspose)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 2000;
+    std::vector<char> records = MakeRecords(layout, count);
+    Projection projection(layout, Names("venue", "price"));
+    ColumnSet columns = projection.decode(records.data(), count);
+    CHECK_EQ(2u, columns.columnCount());
+    bool same = true;
+    for (size_t r = 0; r < count; ++r)
+    {
+        same = same && columns.column("venue").intAt(r) == static_cast<int64_t>(r % 100);
+        same = same && columns.column("price").doubleAt(r) == 100.0 + static_cast<double>(r);
+    }
+    CHECK(same);
+}
+
+TEST(GatherWritesCompactRows)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 50;
+    std::vector<char> records = MakeRecords(layout, count);
+    Projection projection(layout, Names("id", "side", "ts"));
+    StructLayout compact = projection.compactLayout();
+    CHECK_EQ(projection.bytesPerRecord(), compact.size());
+    std::vector<char> rows(count * compact.size());
+    projection.gather(records.data(), count, rows.data());
+    bool same = true;
+    for (size_t r = 0; r < count; ++r)
+    {
+        const char* row = rows.data() + r * compact.size();
+        same = same && compact.read<int64_t>("id", row) == static_cast<int64_t>(r);
+        same = same && compact.read<int64_t>("side", row) == static_cast<int64_t>(r & 1);
+        same = same && compact.read<int64_t>("ts", row) == static_cast<int64_t>(r * 1000);
+    }
+    CHECK(same);
+}
+
+TEST_MAIN()
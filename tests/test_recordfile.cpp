@@ -0,0 +1,222 @@
+#include "test_common.h"
+#include "../struct_recordfile.h"
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+namespace
+{
+
+const char* const RecordText =
+    "struct Tick { uint32_t id; int16_t delta; uint16_t venue : 6; uint16_t side : 10; double price; };";
+
+std::vector<char> MakeRecords(const StructLayout& layout, size_t count)
+{
+    std::vector<char> records(count * layout.size());
+    for (size_t r = 0; r < count; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        layout.writeInt(layout.fieldIndex("id"), static_cast<int64_t>(r), record);
+        layout.writeInt(layout.fieldIndex("delta"), static_cast<int64_t>(r % 100) - 50, record);
+        layout.writeInt(layout.fieldIndex("venue"), static_cast<int64_t>(r % 64), record);
+        layout.writeInt(layout.fieldIndex("side"), static_cast<int64_t>(r % 3), record);
+        layout.writeDouble(layout.fieldIndex("price"), 100 + static_cast<double>(r) / 8, record);
+    }
+    return records;
+}
+
+// Временный файл в рабочем каталоге теста, удаляется при выходе из области
+struct TempPath
+{
+    std::string path;
+
+    explicit TempPath(const char* name) : path(std::string("test_recordfile_") + name + ".sprf") {}
+    ~TempPath() { std::remove(path.c_str()); }
+};
+
+void WriteFile(const std::string& path, const std::vector<char>& records, size_t count, const RecordFileOptions& options)
+{
+    RecordFileWriter writer(path, RecordText, options);
+    // Порциями, не кратными размеру блока
+    const size_t chunk = 70;
+    for (size_t r = 0; r < count; r += chunk)
+    {
+        writer.write(records.data() + r * writer.layout().size(), std::min(chunk, count - r));
+    }
+    writer.close();
+}
+
+// Побитово испортить байт файла по смещению from конца
+void CorruptByteFromEnd(const std::string& path, long fromEnd)
+{
+    std::FILE* file = std::fopen(path.c_str(), "r+b");
+    std::fseek(file, -fromEnd, SEEK_END);
+    int byte = std::fgetc(file);
+    std::fseek(file, -fromEnd, SEEK_END);
+    std::fputc(byte ^ 0x5A, file);
+    std::fclose(file);
+}
+
+// Записать 4 байта value по смещению offset
+void PatchU32(const std::string& path, long offset, uint32_t value)
+{
+    std::FILE* file = std::fopen(path.c_str(), "r+b");
+    std::fseek(file, offset, SEEK_SET);
+    for (int k = 0; k < 4; ++k) std::fputc(static_cast<int>((value >> (8 * k)) & 0xFF), file);
+    std::fclose(file);
+}
+
+// Смещение первого заголовка блока ("SPRB")
+long FirstBlockOffset(const std::string& path)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    std::string bytes;
+    for (int c = std::fgetc(file); c != EOF; c = std::fgetc(file)) bytes.push_back(static_cast<char>(c));
+    std::fclose(file);
+    return static_cast<long>(bytes.find("SPRB"));
+}
+
+} // namespace
+
+TEST(RoundTripRestoresRecordsAndLayout)
+{
+    TempPath file("plain");
+    StructLayout layout(RecordText);
+    const size_t count = 1000;
+    std::vector<char> records = MakeRecords(layout, count);
+    RecordFileOptions options;
+    options.recordsPerBlock = 256;
+    WriteFile(file.path, records, count, options);
+
+    RecordFileReader reader(file.path);
+    CHECK_EQ(RecordFileVersion, reader.version());
+    CHECK(!reader.compressed());
+    CHECK_EQ(std::string(RecordText), reader.structText());
+    CHECK_EQ(layout.size(), reader.layout().size());
+    CHECK_EQ(layout.fieldCount(), reader.layout().fieldCount());
+    CHECK_EQ(layout.field(3).bitOffset, reader.layout().field(3).bitOffset);
+
+    std::vector<char> block;
+    size_t blockCount = 0, blocks = 0, total = 0;
+    while (reader.readBlock(block, blockCount))
+    {
+        ++blocks;
+        total += blockCount;
+    }
+    CHECK_EQ(static_cast<size_t>(4), blocks);
+    CHECK_EQ(count, total);
+
+    RecordFileReader again(file.path);
+    CHECK(again.readAll() == records);
+}
+
+TEST(CompressedRoundTripAndColumns)
+{
+    TempPath file("compressed");
+    StructLayout layout(RecordText);
+    const size_t count = 700;
+    std::vector<char> records = MakeRecords(layout, count);
+    RecordFileOptions options;
+    options.recordsPerBlock = 300;
+    options.compress = true;
+    WriteFile(file.path, records, count, options);
+
+    RecordFileReader reader(file.path);
+    CHECK(reader.compressed());
+    CHECK(reader.readAll() == records);
+
+    RecordFileReader columnsReader(file.path);
+    std::vector<size_t> fields(1, layout.fieldIndex("side"));
+    size_t blockCount = 0, offset = 0;
+    bool same = true;
+    while (columnsReader.nextBlock(blockCount))
+    {
+        ColumnSet columns;
+        columnsReader.readColumns(fields, columns);
+        const Column& side = columns.column("side");
+        for (size_t r = 0; r < blockCount; ++r)
+        {
+            same = same && side.intAt(r) == static_cast<int64_t>((offset + r) % 3);
+        }
+        offset += blockCount;
+    }
+    CHECK(same);
+    CHECK_EQ(count, offset);
+}
+
+TEST(ZoneMapsSkipBlocks)
+{
+    TempPath file("zones");
+    StructLayout layout(RecordText);
+    const size_t count = 1024;
+    std::vector<char> records = MakeRecords(layout, count);
+    RecordFileOptions options;
+    options.recordsPerBlock = 128;
+    options.zoneMaps.push_back(ZoneMapSpec("id", true));
+    WriteFile(file.path, records, count, options);
+
+    RecordFileReader reader(file.path);
+    CHECK_EQ(static_cast<size_t>(1), reader.zoneMaps().size());
+    ZonePredicate predicate(reader.layout());
+    predicate.between("id", 300, 400);
+    std::vector<char> block;
+    size_t blockCount = 0, blocks = 0;
+    while (reader.readBlock(block, blockCount, predicate)) ++blocks;
+    CHECK_EQ(static_cast<size_t>(2), blocks);
+    CHECK_EQ(static_cast<size_t>(6), reader.skippedBlocks());
+}
+
+TEST(CorruptedPayloadThrows)
+{
+    TempPath file("corrupt");
+    StructLayout layout(RecordText);
+    const size_t count = 100;
+    std::vector<char> records = MakeRecords(layout, count);
+    WriteFile(file.path, records, count, RecordFileOptions());
+    CorruptByteFromEnd(file.path, 5);
+
+    RecordFileReader reader(file.path);
+    std::vector<char> block;
+    size_t blockCount = 0;
+    CHECK_THROWS(std::runtime_error, reader.readBlock(block, blockCount));
+}
+
+TEST(CorruptedHeaderThrows)
+{
+    TempPath file("header");
+    std::vector<char> records = MakeRecords(StructLayout(RecordText), 10);
+    WriteFile(file.path, records, 10, RecordFileOptions());
+    {
+        std::FILE* f = std::fopen(file.path.c_str(), "r+b");
+        std::fseek(f, 12, SEEK_SET);
+        std::fputc('#', f);
+        std::fclose(f);
+    }
+    CHECK_THROWS(std::runtime_error, RecordFileReader reader(file.path));
+    CHECK_THROWS(std::runtime_error, RecordFileReader reader("test_recordfile_missing.sprf"));
+}
+
+TEST(OversizedLengthsThrowBeforeAllocation)
+{
+    TempPath file("lengths");
+    std::vector<char> records = MakeRecords(StructLayout(RecordText), 10);
+    RecordFileOptions options;
+    options.zoneMaps.push_back(ZoneMapSpec("id", true));
+    WriteFile(file.path, records, 10, options);
+    long block = FirstBlockOffset(file.path);
+    CHECK(block > 0);
+
+    // Размер статистики блока: 4 ГиБ при 10 записях
+    PatchU32(file.path, block + 16, 0xFFFFFFF0u);
+    RecordFileReader reader(file.path);
+    size_t blockCount = 0;
+    CHECK_THROWS(std::runtime_error, reader.nextBlock(blockCount));
+
+    // Длина текста структуры в заголовке файла
+    PatchU32(file.path, 8, 0x7FFFFFFFu);
+    CHECK_THROWS(std::runtime_error, RecordFileReader reader(file.path));
+}
+
+TEST_MAIN()
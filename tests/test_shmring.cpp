@@ -0,0 +1,138 @@
+#include "test_common.h"
+#include "../struct_shmring.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace
+{
+
+const char* const RecordText = "struct Tick { uint64_t seq; uint32_t venue : 8; uint32_t qty : 24; double price; };";
+
+std::vector<char> MakeRecord(const StructLayout& layout, uint64_t seq)
+{
+    std::vector<char> record(layout.size(), 0);
+    layout.writeBits(layout.fieldIndex("seq"), seq, record.data());
+    layout.writeInt(layout.fieldIndex("venue"), static_cast<int64_t>(seq % 256), record.data());
+    layout.writeInt(layout.fieldIndex("qty"), static_cast<int64_t>(seq * 3), record.data());
+    layout.writeDouble(layout.fieldIndex("price"), static_cast<double>(seq) / 2, record.data());
+    return record;
+}
+
+} // namespace
+
+TEST(AttachedRingSeesTheSameLayout)
+{
+    StructLayout layout(RecordText);
+    std::unique_ptr<SharedRecordRing> ring = SharedRecordRing::createAnonymous(layout, 100);
+    CHECK_EQ(static_cast<size_t>(128), ring->capacity());
+    std::unique_ptr<SharedRecordRing> other = SharedRecordRing::attachFd(::dup(ring->fd()));
+    CHECK_EQ(ring->capacity(), other->capacity());
+    CHECK_EQ(layout.size(), other->layout().size());
+    CHECK_EQ(layout.fieldCount(), other->layout().fieldCount());
+    CHECK_EQ(std::string("qty"), other->layout().field(2).name);
+    CHECK_EQ(8, other->layout().field(2).bitOffset);
+}
+
+TEST(EveryConsumerReadsEveryRecordInOrder)
+{
+    StructLayout layout(RecordText);
+    std::unique_ptr<SharedRecordRing> ring = SharedRecordRing::createAnonymous(layout, 64);
+    std::unique_ptr<SharedRecordRing> reader = SharedRecordRing::attachFd(::dup(ring->fd()));
+    const uint64_t count = 50000;
+    const int consumers = 3;
+    std::vector<int> ids;
+    for (int c = 0; c < consumers; ++c) ids.push_back(reader->attach());
+
+    std::vector<uint64_t> errors(consumers, 0);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < consumers; ++c)
+    {
+        threads.push_back(std::thread([&, c]()
+        {
+            const StructLayout& view = reader->layout();
+            for (uint64_t i = 0; i < count; ++i)
+            {
+                const char* record = reader->peek(ids[c]);
+                if (view.readBits(0, record) != i || view.readInt(2, record) != static_cast<int64_t>((i * 3) & 0xFFFFFF) ||
+                    view.readDouble(3, record) != static_cast<double>(i) / 2)
+                {
+                    ++errors[c];
+                }
+                reader->release(ids[c]);
+            }
+        }));
+    }
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        // Половина записей - через claim/publish прямо в кольце
+        if (i % 2)
+        {
+            std::vector<char> record = MakeRecord(layout, i);
+            ring->push(record.data());
+        }
+        else
+        {
+            char* slot = ring->claim();
+            std::vector<char> record = MakeRecord(layout, i);
+            std::memcpy(slot, record.data(), record.size());
+            ring->publish();
+        }
+    }
+    for (auto& thread : threads) thread.join();
+    for (int c = 0; c < consumers; ++c) CHECK_EQ(static_cast<uint64_t>(0), errors[c]);
+}
+
+TEST(SlowConsumerHoldsTheWriterUntilDetached)
+{
+    StructLayout layout(RecordText);
+    std::unique_ptr<SharedRecordRing> ring = SharedRecordRing::createAnonymous(layout, 4);
+    CHECK(ring->tryPeek(ring->attach()) == nullptr);
+    for (uint64_t i = 0; i < 4; ++i) ring->push(MakeRecord(layout, i).data());
+    CHECK(ring->tryClaim() == nullptr);
+
+    const char* first = ring->tryPeek(0);
+    CHECK(first != nullptr);
+    CHECK_EQ(static_cast<uint64_t>(0), layout.readBits(0, first));
+    ring->release(0);
+    CHECK(ring->tryClaim() != nullptr);
+    ring->publish();
+    CHECK(ring->tryClaim() == nullptr);
+
+    ring->detach(0);
+    CHECK(ring->tryClaim() != nullptr);
+    CHECK_THROWS(std::invalid_argument, ring->release(SharedRecordRing::MaxConsumers));
+    for (int c = 0; c < SharedRecordRing::MaxConsumers; ++c) ring->attach();
+    CHECK_THROWS(std::runtime_error, ring->attach());
+}
+
+TEST(NamedSegmentsAndForeignFiles)
+{
+    StructLayout layout(RecordText);
+    std::string name = "/struct_ring_test_" + std::to_string(::getpid());
+    {
+        std::unique_ptr<SharedRecordRing> ring = SharedRecordRing::create(name, layout, 8);
+        std::unique_ptr<SharedRecordRing> opened = SharedRecordRing::open(name);
+        int id = opened->attach();
+        ring->push(MakeRecord(layout, 42).data());
+        CHECK_EQ(static_cast<uint64_t>(42), layout.readBits(0, opened->peek(id)));
+        CHECK_THROWS(std::runtime_error, SharedRecordRing::create(name, layout, 8));
+    }
+    SharedRecordRing::unlink(name);
+    CHECK_THROWS(std::runtime_error, SharedRecordRing::open(name));
+
+    std::FILE* file = std::tmpfile();
+    std::vector<char> junk(8192, 'x');
+    std::fwrite(junk.data(), 1, junk.size(), file);
+    std::fflush(file);
+    CHECK_THROWS(std::runtime_error, SharedRecordRing::attachFd(::dup(::fileno(file))));
+    std::fclose(file);
+}
+
+TEST_MAIN()
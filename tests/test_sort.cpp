@@ -0,0 +1,124 @@
+#include "test_common.h"
+#include "../struct_sort.h"
+
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+
+namespace
+{
+
+const char* const RecordText =
+    "struct Row { uint32_t id; int32_t delta; double score; uint16_t port; int8_t level : 5; uint8_t spare : 3; };";
+
+std::vector<char> MakeRecords(const StructLayout& layout, size_t count)
+{
+    std::vector<char> records(count * layout.size());
+    uint64_t state = 12345;
+    for (size_t r = 0; r < count; ++r)
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        char* record = records.data() + r * layout.size();
+        layout.writeInt(0, static_cast<int64_t>(r), record);
+        layout.writeInt(1, static_cast<int64_t>(state >> 40) - (1 << 23), record);
+        layout.writeDouble(2, static_cast<double>(static_cast<int64_t>(state >> 44) - 500000) / 7, record);
+        layout.writeBits(3, SwapBytes(static_cast<uint16_t>(state >> 20), 2), record);   // сетевой порядок
+        layout.writeInt(4, static_cast<int64_t>(state >> 59) - 16, record);
+    }
+    return records;
+}
+
+// Записи упорядочены по значению поля, равные - по исходному номеру (устойчивость)
+template<typename Value>
+bool IsSorted(const StructLayout& layout, const std::vector<char>& records, size_t count, Value value, bool descending)
+{
+    for (size_t r = 1; r < count; ++r)
+    {
+        const char* a = records.data() + (r - 1) * layout.size();
+        const char* b = records.data() + r * layout.size();
+        if (value(a) == value(b))
+        {
+            if (layout.readInt(0, a) > layout.readInt(0, b)) return false;
+        }
+        else if ((value(a) < value(b)) == descending)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST(SortsSignedFloatAndBitFieldKeys)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 5000;
+    std::vector<char> records = MakeRecords(layout, count);
+
+    RecordSorter(layout, SortKey("delta")).sort(records.data(), count);
+    CHECK(IsSorted(layout, records, count, [&](const char* r) { return layout.readInt(1, r); }, false));
+
+    RecordSorter(layout, SortKey("id")).sort(records.data(), count);
+    RecordSorter(layout, SortKey("score")).sort(records.data(), count);
+    CHECK(IsSorted(layout, records, count, [&](const char* r) { return layout.readDouble(2, r); }, false));
+
+    // Устойчивость проверяется по id: сначала вернуть исходный порядок
+    RecordSorter(layout, SortKey("id")).sort(records.data(), count);
+    RecordSorter(layout, SortKey("level", false, true)).sort(records.data(), count);
+    CHECK(IsSorted(layout, records, count, [&](const char* r) { return layout.readInt(4, r); }, true));
+}
+
+TEST(BigEndianKey)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 1000;
+    std::vector<char> records = MakeRecords(layout, count);
+    RecordSorter sorter(layout, SortKey("port", true));
+    std::vector<char> sorted(records.size());
+    sorter.sort(records.data(), count, sorted.data());
+    CHECK(IsSorted(layout, sorted, count, [&](const char* r) { return SwapBytes(layout.readBits(3, r), 2); }, false));
+}
+
+TEST(ExternalSortMatchesInMemory)
+{
+    StructLayout layout(RecordText);
+    const size_t count = 20000;
+    std::vector<char> records = MakeRecords(layout, count);
+    RecordSorter sorter(layout, SortKey("delta"));
+    std::vector<char> expected(records.size());
+    sorter.sort(records.data(), count, expected.data());
+
+    std::FILE* in = std::tmpfile();
+    std::FILE* out = std::tmpfile();
+    CHECK(in && out);
+    if (!in || !out) return;
+    std::fwrite(records.data(), 1, records.size(), in);
+    std::rewind(in);
+    sorter.sortFile(in, out, 64 * 1024);    // несколько временных кусков
+    std::rewind(out);
+    std::vector<char> actual(records.size() + 1);
+    size_t read = std::fread(actual.data(), 1, actual.size(), out);
+    std::fclose(in);
+    std::fclose(out);
+    CHECK_EQ(records.size(), read);
+    actual.resize(read);
+    CHECK(actual == expected);
+}
+
+TEST(ExternalSortOfEmptyFile)
+{
+    StructLayout layout(RecordText);
+    RecordSorter sorter(layout, SortKey("delta"));
+    std::FILE* in = std::tmpfile();
+    std::FILE* out = std::tmpfile();
+    CHECK(in && out);
+    if (!in || !out) return;
+    sorter.sortFile(in, out, 64 * 1024);
+    CHECK_EQ(0L, std::ftell(out));
+    std::fclose(in);
+    std::fclose(out);
+}
+
+TEST_MAIN()
@@ -0,0 +1,139 @@
+#include "test_common.h"
+#include "../struct_zonemap.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace
+{
+
+const char* const RecordText = "struct Row { uint64_t id; int32_t delta; float ratio; double price; };";
+
+std::vector<BlockStatistics> Statistics(const StructLayout& layout, const std::vector<ZoneMapSpec>& specs,
+                                        const std::vector<char>& records)
+{
+    std::vector<BlockStatistics> stats;
+    ComputeBlockStatistics(layout, specs, records.data(), records.size() / layout.size(), stats);
+    return stats;
+}
+
+} // namespace
+
+TEST(NegativeZeroMatchesZeroInBloom)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records(4 * layout.size(), 0);
+    for (size_t r = 0; r < 4; ++r)
+    {
+        char* record = records.data() + r * layout.size();
+        layout.writeDouble(layout.fieldIndex("price"), r == 2 ? -0.0 : 10.0 + static_cast<double>(r), record);
+        layout.writeDouble(layout.fieldIndex("ratio"), r == 1 ? -0.0 : 0.5, record);
+    }
+    std::vector<ZoneMapSpec> specs;
+    specs.push_back(ZoneMapSpec("price", true));
+    specs.push_back(ZoneMapSpec("ratio", true));
+    std::vector<BlockStatistics> stats = Statistics(layout, specs, records);
+
+    ZonePredicate price(layout);
+    price.equals("price", 0);
+    CHECK(price.mayMatch(stats));
+    ZonePredicate ratio(layout);
+    ratio.equals("ratio", 0);
+    CHECK(ratio.mayMatch(stats));
+    ZonePredicate absent(layout);
+    absent.equals("price", 5);
+    CHECK(!absent.mayMatch(stats));
+}
+
+TEST(UnsignedRangeAboveTwoToThe63)
+{
+    StructLayout layout(RecordText);
+    const uint64_t high = 1ULL << 63;
+    std::vector<char> records(3 * layout.size(), 0);
+    for (size_t r = 0; r < 3; ++r)
+    {
+        layout.writeBits(layout.fieldIndex("id"), high + 5 * r, records.data() + r * layout.size());
+    }
+    std::vector<ZoneMapSpec> specs(1, ZoneMapSpec("id", true));
+    std::vector<BlockStatistics> stats = Statistics(layout, specs, records);
+    CHECK(stats[0].isUnsigned);
+    CHECK(!stats[0].isEmpty());
+    CHECK_EQ(high, stats[0].uintMin);
+    CHECK_EQ(high + 10, stats[0].uintMax);
+
+    ZonePredicate wide(layout);
+    wide.betweenReal("id", 0, 1.9e19);
+    CHECK(wide.mayMatch(stats));
+    ZonePredicate exact(layout);
+    exact.betweenUnsigned("id", high + 1, high + 7);
+    CHECK(exact.mayMatch(stats));
+    ZonePredicate equal(layout);
+    equal.equalsUnsigned("id", high + 10);
+    CHECK(equal.mayMatch(stats));
+
+    ZonePredicate low(layout);
+    low.between("id", 0, 1000);
+    CHECK(!low.mayMatch(stats));
+    ZonePredicate above(layout);
+    above.betweenUnsigned("id", high + 11, ~0ULL);
+    CHECK(!above.mayMatch(stats));
+    ZonePredicate negative(layout);
+    negative.equals("id", -1);
+    CHECK(!negative.mayMatch(stats));
+}
+
+TEST(SignedRangeAndSentinel)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records(5 * layout.size(), 0);
+    const int32_t values[] = { -20, 7, -1, 3, -1 };
+    for (size_t r = 0; r < 5; ++r)
+    {
+        layout.writeInt(layout.fieldIndex("delta"), values[r], records.data() + r * layout.size());
+    }
+    std::vector<ZoneMapSpec> specs(1, ZoneMapSpec("delta").withSentinel(-1));
+    std::vector<BlockStatistics> stats = Statistics(layout, specs, records);
+    CHECK_EQ(static_cast<int64_t>(-20), stats[0].intMin);
+    CHECK_EQ(static_cast<int64_t>(7), stats[0].intMax);
+    CHECK_EQ(static_cast<uint64_t>(2), stats[0].sentinelCount);
+
+    ZonePredicate inside(layout);
+    inside.between("delta", -5, -2);
+    CHECK(inside.mayMatch(stats));
+    ZonePredicate sentinel(layout);
+    sentinel.equals("delta", -1);
+    CHECK(sentinel.mayMatch(stats));
+    ZonePredicate outside(layout);
+    outside.between("delta", 8, 100);
+    CHECK(!outside.mayMatch(stats));
+}
+
+TEST(SerializationKeepsUnsignedRange)
+{
+    StructLayout layout(RecordText);
+    std::vector<char> records(2 * layout.size(), 0);
+    layout.writeBits(layout.fieldIndex("id"), 3, records.data());
+    layout.writeBits(layout.fieldIndex("id"), ~0ULL - 1, records.data() + layout.size());
+    std::vector<ZoneMapSpec> specs;
+    specs.push_back(ZoneMapSpec("id"));
+    specs.push_back(ZoneMapSpec("price", true));
+    std::vector<BlockStatistics> stats = Statistics(layout, specs, records);
+
+    std::string bytes;
+    SerializeBlockStatistics(stats, bytes);
+    BinaryReader reader(bytes.data(), bytes.size());
+    std::vector<BlockStatistics> restored;
+    DeserializeBlockStatistics(reader, layout, specs, restored);
+    CHECK_EQ(static_cast<size_t>(2), restored.size());
+    CHECK(restored[0].isUnsigned);
+    CHECK_EQ(static_cast<uint64_t>(3), restored[0].uintMin);
+    CHECK_EQ(~0ULL - 1, restored[0].uintMax);
+    CHECK(restored[1].bloom == stats[1].bloom);
+
+    ZonePredicate top(layout);
+    top.equalsUnsigned("id", ~0ULL - 1);
+    CHECK(top.mayMatch(restored));
+}
+
+TEST_MAIN()